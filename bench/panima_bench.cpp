@@ -0,0 +1,324 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+// Microbenchmarks for the channel and player hot paths. All data is generated synthetically, so no assets are required.
+// Results are written to stdout as one JSON object per line:
+// {"benchmark":"<name>","keys":<n>,"iterations":<i>,"ns_per_op":<t>}
+// Usage: panima_bench [--filter <substring>] [--max-keys <n>] [--min-time-ms <t>]
+
+#include <udm.hpp>
+#include <mathutil/umath.h>
+#include <sharedutils/magic_enum.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+
+import panima;
+
+namespace {
+	struct Settings {
+		std::string filter;
+		uint32_t maxKeys = 1'000'000;
+		double minTimeMs = 200.0;
+	};
+	Settings g_settings;
+
+	// Prevents the compiler from optimizing away the benchmarked code
+	template<typename T>
+	void do_not_optimize(const T &value)
+	{
+		static volatile char sink;
+		sink = reinterpret_cast<const volatile char &>(value);
+	}
+
+	// Runs fn in batches until the minimum time has elapsed. setup is called before every batch and is not timed.
+	// Returns false if the benchmark was skipped by the filter.
+	bool run(const std::string &name, uint32_t numKeys, const std::function<void()> &fn, const std::function<void()> &setup = nullptr, uint64_t batchSize = 1)
+	{
+		if(!g_settings.filter.empty() && name.find(g_settings.filter) == std::string::npos)
+			return false;
+		using Clock = std::chrono::steady_clock;
+		uint64_t iterations = 0;
+		Clock::duration elapsed {};
+		do {
+			if(setup)
+				setup();
+			auto t0 = Clock::now();
+			for(uint64_t i = 0; i < batchSize; ++i)
+				fn();
+			elapsed += Clock::now() - t0;
+			iterations += batchSize;
+			// Batches without a setup step are grown, to keep the timer overhead low for fast operations
+			if(!setup && batchSize < (1ull << 20))
+				batchSize *= 2;
+		} while(std::chrono::duration<double, std::milli>(elapsed).count() < g_settings.minTimeMs);
+		auto nsPerOp = std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(iterations);
+		std::printf("{\"benchmark\":\"%s\",\"keys\":%u,\"iterations\":%llu,\"ns_per_op\":%.3f}\n", name.c_str(), numKeys, static_cast<unsigned long long>(iterations), nsPerOp);
+		std::fflush(stdout);
+		return true;
+	}
+
+	std::vector<uint32_t> get_key_counts()
+	{
+		std::vector<uint32_t> counts;
+		for(uint32_t n = 10; n <= g_settings.maxKeys; n *= 10)
+			counts.push_back(n);
+		return counts;
+	}
+
+	template<typename T>
+	T make_key_value(uint32_t i)
+	{
+		auto f = static_cast<float>(i);
+		if constexpr(std::is_same_v<T, bool>)
+			return (i % 2) == 0;
+		else if constexpr(std::is_same_v<T, udm::Quaternion>)
+			return uquat::create(EulerAngles {f, f * 0.5f, 0.f});
+		else if constexpr(std::is_same_v<T, udm::EulerAngles>)
+			return udm::EulerAngles {f, f * 0.5f, 0.f};
+		else if constexpr(std::is_arithmetic_v<T>)
+			return static_cast<T>(i);
+		else
+			return T(f);
+	}
+
+	template<typename T>
+	std::shared_ptr<panima::Channel> create_channel(uint32_t numKeys, float interval = 1.f / 30.f)
+	{
+		auto channel = std::make_shared<panima::Channel>();
+		channel->SetValueType(udm::type_to_enum<T>());
+		// std::vector<bool> has no contiguous storage, boolean keys are stored as bytes
+		using TStorage = std::conditional_t<std::is_same_v<T, bool>, uint8_t, T>;
+		std::vector<float> times(numKeys);
+		std::vector<TStorage> values(numKeys);
+		for(uint32_t i = 0; i < numKeys; ++i) {
+			times[i] = i * interval;
+			values[i] = make_key_value<T>(i);
+		}
+		channel->InsertValues<TStorage>(numKeys, times.data(), values.data(), 0.f, panima::Channel::InsertFlags::None);
+		return channel;
+	}
+
+	// Random sample times within the time range of the channel
+	std::vector<float> get_random_times(uint32_t numKeys, uint32_t count, float interval = 1.f / 30.f)
+	{
+		std::mt19937 rng {12345};
+		std::uniform_real_distribution<float> dist {0.f, (numKeys - 1) * interval};
+		std::vector<float> times(count);
+		for(auto &t : times)
+			t = dist(rng);
+		return times;
+	}
+
+	void bench_find_interpolation_indices()
+	{
+		constexpr float interval = 1.f / 30.f;
+		for(auto n : get_key_counts()) {
+			auto channel = create_channel<float>(n, interval);
+			// Pivot hit: time advances by less than one key per call, as during regular playback
+			{
+				float t = 0.f;
+				uint32_t pivot = 0;
+				auto tMax = (n - 1) * interval;
+				run("find_interpolation_indices/pivot_hit", n, [&]() {
+					float f;
+					auto indices = channel->FindInterpolationIndices(t, f, pivot);
+					pivot = indices.first;
+					t += interval * 0.25f;
+					if(t > tMax)
+						t = 0.f;
+					do_not_optimize(indices);
+				});
+			}
+			// Pivot miss: random access with a stale pivot
+			{
+				auto times = get_random_times(n, 4096, interval);
+				size_t idx = 0;
+				run("find_interpolation_indices/pivot_miss", n, [&]() {
+					float f;
+					auto indices = channel->FindInterpolationIndices(times[idx++ % times.size()], f, 0);
+					do_not_optimize(indices);
+				});
+			}
+			// Cold: no pivot
+			{
+				auto times = get_random_times(n, 4096, interval);
+				size_t idx = 0;
+				run("find_interpolation_indices/cold", n, [&]() {
+					float f;
+					auto indices = channel->FindInterpolationIndices(times[idx++ % times.size()], f);
+					do_not_optimize(indices);
+				});
+			}
+		}
+	}
+
+	template<typename T>
+	void bench_get_interpolated_value(std::string_view typeName)
+	{
+		for(auto n : get_key_counts()) {
+			auto channel = create_channel<T>(n);
+			auto times = get_random_times(n, 4096);
+			std::sort(times.begin(), times.end());
+			size_t idx = 0;
+			uint32_t pivot = 0;
+			run("get_interpolated_value/" + std::string {typeName}, n, [&]() {
+				auto i = idx++ % times.size();
+				if(i == 0)
+					pivot = 0;
+				auto value = channel->GetInterpolatedValue<T>(times[i], pivot);
+				do_not_optimize(value);
+			});
+		}
+	}
+
+	// Covers every type a channel can hold, so that no specialization of the interpolation is left unmeasured
+	void bench_get_interpolated_values()
+	{
+		for(uint32_t i = 0; i < umath::to_integral(udm::Type::Count); ++i) {
+			auto type = static_cast<udm::Type>(i);
+			if(!panima::is_animatable_type(type))
+				continue;
+			udm::visit_ng(type, [type](auto tag) {
+				using T = typename decltype(tag)::type;
+				if constexpr(panima::is_animatable_type(udm::type_to_enum<T>()))
+					bench_get_interpolated_value<T>(magic_enum::enum_name(type));
+			});
+		}
+	}
+
+	void bench_insertion()
+	{
+		for(auto n : get_key_counts()) {
+			std::vector<float> times(n);
+			std::vector<udm::Vector3> values(n);
+			for(uint32_t i = 0; i < n; ++i) {
+				times[i] = i / 30.f;
+				values[i] = make_key_value<udm::Vector3>(i);
+			}
+			std::shared_ptr<panima::Channel> channel;
+			auto reset = [&]() {
+				channel = std::make_shared<panima::Channel>();
+				channel->SetValueType(udm::Type::Vector3);
+			};
+			run(
+			  "add_value", n,
+			  [&]() {
+				  for(uint32_t i = 0; i < n; ++i)
+					  channel->AddValue(times[i], values[i]);
+			  },
+			  reset);
+			run("insert_values", n, [&]() { channel->InsertValues<udm::Vector3>(n, times.data(), values.data(), 0.f, panima::Channel::InsertFlags::None); }, reset);
+		}
+	}
+
+	void bench_modification()
+	{
+		for(auto n : get_key_counts()) {
+			auto source = create_channel<udm::Vector3>(n);
+			std::shared_ptr<panima::Channel> channel;
+			auto reset = [&]() { channel = std::make_shared<panima::Channel>(*source); };
+			auto tEnd = (n - 1) / 30.f;
+			run("clear_range", n, [&]() { channel->ClearRange(tEnd * 0.25f, tEnd * 0.75f); }, reset);
+			run("decimate", n, [&]() { channel->Decimate(); }, reset);
+			run("optimize", n, [&]() { channel->Optimize(); }, reset);
+
+			// Merges a channel with interleaved keys
+			auto otherShifted = std::make_shared<panima::Channel>();
+			otherShifted->SetValueType(udm::Type::Vector3);
+			{
+				std::vector<float> times(n);
+				std::vector<udm::Vector3> values(n);
+				for(uint32_t i = 0; i < n; ++i) {
+					times[i] = (i + 0.5f) / 30.f;
+					values[i] = make_key_value<udm::Vector3>(i);
+				}
+				otherShifted->InsertValues<udm::Vector3>(n, times.data(), values.data(), 0.f, panima::Channel::InsertFlags::None);
+			}
+			run("merge_values", n, [&]() { channel->MergeValues(*otherShifted); }, reset);
+		}
+	}
+
+	void bench_serialization()
+	{
+		// The channel is written to and read back from a binary udm file, so that the (compressed) arrays are actually serialized
+		auto fileName = (std::filesystem::temp_directory_path() / "panima_bench.udm").string();
+		for(auto n : get_key_counts()) {
+			auto channel = create_channel<udm::Vector3>(n);
+			run("save_load_roundtrip", n, [&]() {
+				auto data = udm::Data::Create();
+				auto udmChannel = data->GetAssetData().GetData()["channel"];
+				channel->Save(udmChannel);
+				data->Save(fileName);
+
+				auto loadedData = udm::Data::Load(fileName);
+				auto udmLoaded = loadedData->GetAssetData().GetData()["channel"];
+				auto loadedChannel = std::make_shared<panima::Channel>();
+				loadedChannel->Load(udmLoaded);
+				do_not_optimize(loadedChannel->GetValueCount());
+			});
+		}
+		std::error_code ec;
+		std::filesystem::remove(fileName, ec);
+	}
+
+	void bench_player_advance()
+	{
+		// One channel per bone property, with a fixed number of keys per channel
+		constexpr uint32_t numBones = 64;
+		for(auto n : get_key_counts()) {
+			if(static_cast<uint64_t>(n) * numBones > 10'000'000)
+				break;
+			auto anim = std::make_shared<panima::Animation>();
+			auto pos = create_channel<udm::Vector3>(n);
+			auto rot = create_channel<udm::Quaternion>(n);
+			for(uint32_t i = 0; i < numBones; ++i) {
+				auto *posChannel = anim->AddChannel("bone" + std::to_string(i) + "/position", udm::Type::Vector3);
+				*posChannel = *pos;
+				posChannel->targetPath = "bone" + std::to_string(i) + "/position";
+				auto *rotChannel = anim->AddChannel("bone" + std::to_string(i) + "/rotation", udm::Type::Quaternion);
+				*rotChannel = *rot;
+				rotChannel->targetPath = "bone" + std::to_string(i) + "/rotation";
+			}
+			anim->SetDuration((n - 1) / 30.f);
+			auto player = panima::Player::Create();
+			player->SetLooping(true);
+			player->SetAnimation(*anim);
+			run("player_advance/" + std::to_string(numBones * 2) + "_channels", n, [&]() { player->Advance(1.f / 60.f); });
+		}
+	}
+
+	void parse_args(int argc, char *argv[])
+	{
+		for(int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			auto hasValue = (i + 1 < argc);
+			if(arg == "--filter" && hasValue)
+				g_settings.filter = argv[++i];
+			else if(arg == "--max-keys" && hasValue)
+				g_settings.maxKeys = static_cast<uint32_t>(std::stoul(argv[++i]));
+			else if(arg == "--min-time-ms" && hasValue)
+				g_settings.minTimeMs = std::stod(argv[++i]);
+		}
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	parse_args(argc, argv);
+	bench_find_interpolation_indices();
+	bench_get_interpolated_values();
+	bench_insertion();
+	bench_modification();
+	bench_serialization();
+	bench_player_advance();
+	return 0;
+}
@@ -5,31 +5,67 @@ module;
 
 #include <udm.hpp>
 #include <mathutil/umath.h>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <optional>
+#include <unordered_set>
+#include <array>
+#include <future>
 
 module panima;
 
 import :animation;
 import :channel;
+import :expression;
+import :trace;
 
-panima::Channel *panima::Animation::AddChannel(std::string path, udm::Type valueType)
+void panima::Animation::IncrementChannelLayoutRevision()
 {
-	ChannelPath channelPath {std::move(path)};
-	auto *channel = FindChannel(path);
+	// Functions that update the index incrementally keep it marked as up to date
+	auto indexUpToDate = IsChannelIndexUpToDate();
+	m_revisions->channelLayoutRevision.store(Channel::AnimationRevisions::NextChannelLayoutRevision(), std::memory_order_relaxed);
+	if(indexUpToDate)
+		m_indexedChannelLayoutRevision = GetChannelLayoutRevision();
+}
+
+bool panima::Animation::IsChannelIndexUpToDate() const { return m_indexedChannelLayoutRevision == GetChannelLayoutRevision(); }
+
+void panima::Animation::EnsureChannelIndex()
+{
+	if(!IsChannelIndexUpToDate())
+		UpdateChannelIndex();
+}
+
+panima::Channel *panima::Animation::AddChannel(std::string path, udm::Type valueType) { return AddChannel(ChannelPath {std::move(path)}, valueType); }
+panima::Channel *panima::Animation::AddChannel(const ChannelPath &channelPath, udm::Type valueType)
+{
+	EnsureChannelIndex();
+	auto *channel = FindChannel(channelPath);
 	if(channel)
-		return (channel->targetPath == channelPath && channel->GetValueType() == valueType) ? channel : nullptr;
+		return (channel->GetValueType() == valueType) ? channel : nullptr;
 	m_channels.push_back(std::make_shared<Channel>());
 	channel = m_channels.back().get();
 	channel->SetValueType(valueType);
-	channel->targetPath = path;
+	channel->targetPath = channelPath;
+	channel->AddAnimationRevisions(m_revisions);
+	m_channelIndex.insert_or_assign(channelPath.GetId(), static_cast<uint32_t>(m_channels.size() - 1));
+	IncrementChannelLayoutRevision();
+	IncrementRevision();
 	return channel;
 }
 
 void panima::Animation::RemoveChannel(std::string path)
 {
-	auto it = FindChannelIt(std::move(path));
-	if(it == m_channels.end())
+	EnsureChannelIndex();
+	auto idx = FindChannelIndex(ChannelPathRegistry::Get().Find(path));
+	if(!idx)
 		return;
-	m_channels.erase(it);
+	m_channels[*idx]->RemoveAnimationRevisions(m_revisions);
+	m_channels.erase(m_channels.begin() + *idx);
+	UpdateChannelIndex();
+	IncrementChannelLayoutRevision();
+	IncrementRevision();
 }
 
 void panima::Animation::RemoveChannel(const Channel &channel)
@@ -37,31 +73,73 @@ void panima::Animation::RemoveChannel(const Channel &channel)
 	auto it = std::find_if(m_channels.begin(), m_channels.end(), [&channel](const std::shared_ptr<Channel> &channelOther) { return &channel == channelOther.get(); });
 	if(it == m_channels.end())
 		return;
+	(*it)->RemoveAnimationRevisions(m_revisions);
 	m_channels.erase(it);
+	UpdateChannelIndex();
+	IncrementChannelLayoutRevision();
+	IncrementRevision();
 }
 
 void panima::Animation::AddChannel(Channel &channel)
 {
-	auto it = std::find_if(m_channels.begin(), m_channels.end(), [&channel](const std::shared_ptr<Channel> &channelOther) { return channelOther->targetPath == channel.targetPath; });
-	if(it != m_channels.end()) {
-		*it = channel.shared_from_this();
-		return;
+	EnsureChannelIndex();
+	auto idx = FindChannelIndex(channel.targetPath.GetId());
+	IncrementChannelLayoutRevision();
+	IncrementRevision();
+	channel.AddAnimationRevisions(m_revisions);
+	if(idx) {
+		if(m_channels[*idx].get() != &channel)
+			m_channels[*idx]->RemoveAnimationRevisions(m_revisions);
+		m_channels[*idx] = channel.shared_from_this();
+	}
+	else {
+		m_channels.push_back(channel.shared_from_this());
+		m_channelIndex.insert_or_assign(channel.targetPath.GetId(), static_cast<uint32_t>(m_channels.size() - 1));
 	}
-	m_channels.push_back(channel.shared_from_this());
 }
 
-std::vector<std::shared_ptr<panima::Channel>>::iterator panima::Animation::FindChannelIt(std::string path)
+void panima::Animation::UpdateChannelIndex()
 {
-	ChannelPath channelPath {std::move(path)};
-	return std::find_if(m_channels.begin(), m_channels.end(), [&channelPath](const std::shared_ptr<Channel> &channel) { return channel->targetPath == channelPath; });
+	m_channelIndex.clear();
+	m_channelIndex.reserve(m_channels.size());
+	// If multiple channels share the same path, the first one takes precedence
+	for(auto i = decltype(m_channels.size()) {0u}; i < m_channels.size(); ++i)
+		m_channelIndex.emplace(m_channels[i]->targetPath.GetId(), static_cast<uint32_t>(i));
+	m_indexedChannelLayoutRevision = GetChannelLayoutRevision();
 }
 
-panima::Channel *panima::Animation::FindChannel(std::string path)
+std::optional<uint32_t> panima::Animation::FindChannelIndex(ChannelPathId pathId) const
 {
-	auto it = FindChannelIt(std::move(path));
-	if(it == m_channels.end())
-		return nullptr;
-	return it->get();
+	if(pathId == INVALID_CHANNEL_PATH_ID)
+		return {};
+	auto it = m_channelIndex.find(pathId);
+	if(it != m_channelIndex.end() && it->second < m_channels.size() && m_channels[it->second]->targetPath.GetId() == pathId)
+		return it->second;
+	if(it == m_channelIndex.end() && IsChannelIndexUpToDate())
+		return {};
+	// The index is rebuilt lazily by the next function that modifies the channels, until then (or if the target path of an
+	// indexed channel has been assigned directly) the channel is looked up the same way it is without the index.
+	auto itChannel = std::find_if(m_channels.begin(), m_channels.end(), [pathId](const std::shared_ptr<Channel> &channel) { return channel->targetPath.GetId() == pathId; });
+	if(itChannel == m_channels.end())
+		return {};
+	return static_cast<uint32_t>(itChannel - m_channels.begin());
+}
+
+panima::Channel *panima::Animation::FindChannel(ChannelPathId pathId)
+{
+	auto idx = FindChannelIndex(pathId);
+	return idx ? m_channels[*idx].get() : nullptr;
+}
+
+void panima::Animation::InvalidateChannelIndex()
+{
+	UpdateChannelIndex();
+	// Channels that have been removed through the vector directly keep incrementing the revision
+	// of the animation when modified, until they're destroyed
+	for(auto &channel : m_channels)
+		channel->AddAnimationRevisions(m_revisions);
+	IncrementChannelLayoutRevision();
+	IncrementRevision();
 }
 
 void panima::Animation::Merge(const Animation &other)
@@ -78,6 +156,7 @@ void panima::Animation::Merge(const Animation &other)
 
 bool panima::Animation::Save(udm::LinkedPropertyWrapper &prop) const
 {
+	trace::Zone zone {"panima::Animation::Save"};
 	auto udmChannels = prop.AddArray("channels", m_channels.size());
 	for(auto i = decltype(m_channels.size()) {0u}; i < m_channels.size(); ++i) {
 		auto udmChannel = udmChannels[i];
@@ -89,22 +168,398 @@ bool panima::Animation::Save(udm::LinkedPropertyWrapper &prop) const
 	prop["flags"] = udm::flags_to_string(m_flags);
 	return true;
 }
+// Accessing the compressed blob of an array compresses any pending changes, which Save would otherwise do on the saving thread
+static void compress_array(const udm::Array &a)
+{
+	if(a.GetArrayType() == udm::ArrayType::Compressed)
+		static_cast<const udm::ArrayLz4 &>(a).GetCompressedBlob();
+}
+
+bool panima::Animation::Save(udm::LinkedPropertyWrapper &prop, const TaskExecutor &executor, const SaveProgressCallback &progressCallback) const
+{
+	auto numChannels = static_cast<uint32_t>(m_channels.size());
+	if(executor) {
+		trace::Zone zone {"panima::Animation::CompressChannels"};
+		// Arrays can be shared between channels, so each one has to be assigned to a single task
+		std::unordered_set<const udm::Array *> scheduledArrays;
+		std::vector<std::shared_future<void>> tasks;
+		tasks.reserve(numChannels);
+		for(auto &channel : m_channels) {
+			std::array<const udm::Array *, 2> arrays {&channel->GetTimesArray(), &channel->GetValueArray()};
+			for(auto *&a : arrays) {
+				if(a->GetArrayType() != udm::ArrayType::Compressed || !scheduledArrays.insert(a).second)
+					a = nullptr;
+			}
+			if(!arrays[0] && !arrays[1]) {
+				tasks.push_back({});
+				continue;
+			}
+			auto promise = std::make_shared<std::promise<void>>();
+			tasks.push_back(promise->get_future().share());
+			executor([channel, arrays, promise]() {
+				// Failures are ignored here, the arrays are compressed again (and the error is reported) by the serial save below
+				try {
+					trace::Zone zone {"panima::Channel::Compress"};
+					for(auto *a : arrays) {
+						if(a)
+							compress_array(*a);
+					}
+				}
+				catch(...) {
+				}
+				promise->set_value();
+			});
+		}
+		for(uint32_t i = 0; i < numChannels; ++i) {
+			if(tasks[i].valid())
+				tasks[i].wait();
+			if(progressCallback)
+				progressCallback(i + 1, numChannels);
+		}
+	}
+	else if(progressCallback) {
+		// Without an executor, the compression happens as part of the serial save
+		for(uint32_t i = 0; i < numChannels; ++i) {
+			compress_array(m_channels[i]->GetTimesArray());
+			compress_array(m_channels[i]->GetValueArray());
+			progressCallback(i + 1, numChannels);
+		}
+	}
+	return Save(prop);
+}
+
 bool panima::Animation::Load(udm::LinkedPropertyWrapper &prop)
 {
+	trace::Zone zone {"panima::Animation::Load"};
 	auto udmChannels = prop["channels"];
 	auto numChannels = udmChannels.GetSize();
 	m_channels.reserve(numChannels);
 	for(auto udmChannel : udmChannels) {
 		m_channels.push_back(std::make_shared<Channel>());
 		m_channels.back()->Load(udmChannel);
+		m_channels.back()->AddAnimationRevisions(m_revisions);
+	}
+	UpdateChannelIndex();
+	IncrementChannelLayoutRevision();
+	IncrementRevision();
+
+	prop["speedFactor"](m_speedFactor);
+	prop["duration"](m_duration);
+	udm::to_flags<Flags>(prop["flags"], m_flags);
+	UpdateExpressionGraph();
+	return true;
+}
+
+bool panima::AnimationSnapshot::ChannelState::IsModified(const Channel &channel) const
+{
+	if(channel.GetRevision() != revision || channel.interpolation != interpolation || channel.targetPath.GetId() != targetPathId)
+		return true;
+	auto *expr = channel.GetValueExpression();
+	if(!expr || !expression)
+		return static_cast<bool>(expr) != expression.has_value();
+	return *expr != *expression;
+}
+
+std::unordered_map<const panima::Channel *, uint32_t> panima::AnimationSnapshot::GetChannelIndices() const
+{
+	std::unordered_map<const Channel *, uint32_t> indices;
+	indices.reserve(m_channels.size());
+	for(auto i = decltype(m_channels.size()) {0u}; i < m_channels.size(); ++i) {
+		auto channel = m_channels[i].channel.lock();
+		if(channel)
+			indices.emplace(channel.get(), static_cast<uint32_t>(i));
+	}
+	return indices;
+}
+
+panima::AnimationSnapshot panima::Animation::CreateSnapshot() const
+{
+	AnimationSnapshot snapshot {};
+	snapshot.m_channels.reserve(m_channels.size());
+	for(auto &channel : m_channels) {
+		AnimationSnapshot::ChannelState state {};
+		state.channel = channel;
+		state.revision = channel->GetRevision();
+		state.interpolation = channel->interpolation;
+		state.targetPathId = channel->targetPath.GetId();
+		if(auto *expr = channel->GetValueExpression())
+			state.expression = *expr;
+		snapshot.m_channels.push_back(std::move(state));
+	}
+	snapshot.m_speedFactor = m_speedFactor;
+	snapshot.m_duration = m_duration;
+	snapshot.m_flags = m_flags;
+	return snapshot;
+}
+
+uint32_t panima::Animation::GetModifiedChannelCount(const AnimationSnapshot &baseline) const
+{
+	auto baselineIndices = baseline.GetChannelIndices();
+	uint32_t n = 0;
+	for(auto &channel : m_channels) {
+		auto it = baselineIndices.find(channel.get());
+		if(it == baselineIndices.end() || baseline.m_channels[it->second].IsModified(*channel))
+			++n;
+	}
+	return n;
+}
+
+bool panima::Animation::HasUnsavedChanges(const AnimationSnapshot &baseline) const
+{
+	if(m_speedFactor != baseline.m_speedFactor || m_duration != baseline.m_duration || m_flags != baseline.m_flags || m_channels.size() != baseline.m_channels.size())
+		return true;
+	for(auto i = decltype(m_channels.size()) {0u}; i < m_channels.size(); ++i) {
+		auto &state = baseline.m_channels[i];
+		if(state.channel.lock() != m_channels[i] || state.IsModified(*m_channels[i]))
+			return true;
+	}
+	return false;
+}
+
+bool panima::Animation::SaveChanges(udm::LinkedPropertyWrapper &prop, const AnimationSnapshot &baseline) const
+{
+	trace::Zone zone {"panima::Animation::SaveChanges"};
+	auto baselineIndices = baseline.GetChannelIndices();
+	auto udmChannels = prop.AddArray("channels", m_channels.size());
+	for(auto i = decltype(m_channels.size()) {0u}; i < m_channels.size(); ++i) {
+		auto &channel = *m_channels[i];
+		auto udmChannel = udmChannels[i];
+		auto it = baselineIndices.find(&channel);
+		if(it != baselineIndices.end() && !baseline.m_channels[it->second].IsModified(channel)) {
+			udmChannel["savedIndex"] = it->second;
+			continue;
+		}
+		auto udmData = udmChannel["channel"];
+		channel.Save(udmData);
 	}
 
+	prop["speedFactor"] = m_speedFactor;
+	prop["duration"] = m_duration;
+	prop["flags"] = udm::flags_to_string(m_flags);
+	return true;
+}
+
+bool panima::Animation::ApplyChanges(udm::LinkedPropertyWrapper &prop, const AnimationSnapshot &baseline)
+{
+	trace::Zone zone {"panima::Animation::ApplyChanges"};
+	auto udmChannels = prop["channels"];
+	// Everything is loaded before anything is applied, so that the animation remains unchanged if the entry doesn't match
+	std::vector<std::shared_ptr<Channel>> channels;
+	channels.reserve(udmChannels.GetSize());
+	for(auto udmChannel : udmChannels) {
+		// Written channels are always loaded into new channel objects, the channels of the animation may be shared
+		auto udmData = udmChannel["channel"];
+		if(udmData) {
+			auto channel = std::make_shared<Channel>();
+			if(!channel->Load(udmData))
+				return false;
+			channels.push_back(std::move(channel));
+			continue;
+		}
+		auto udmSavedIndex = udmChannel["savedIndex"];
+		if(!udmSavedIndex)
+			return false;
+		uint32_t idx = 0;
+		udmSavedIndex(idx);
+		auto channel = (idx < baseline.m_channels.size()) ? baseline.m_channels[idx].channel.lock() : nullptr;
+		if(!channel)
+			return false;
+		channels.push_back(std::move(channel));
+	}
+	for(auto &channel : m_channels)
+		channel->RemoveAnimationRevisions(m_revisions);
+	m_channels = std::move(channels);
+	for(auto &channel : m_channels)
+		channel->AddAnimationRevisions(m_revisions);
+	UpdateChannelIndex();
+	IncrementChannelLayoutRevision();
+	IncrementRevision();
+
 	prop["speedFactor"](m_speedFactor);
 	prop["duration"](m_duration);
 	udm::to_flags<Flags>(prop["flags"], m_flags);
+	UpdateExpressionGraph();
 	return true;
 }
 
+bool panima::Animation::IsExpressionGraphDirty() const
+{
+	if(m_graphExpressionIds.size() != m_channels.size())
+		return true;
+	for(auto i = decltype(m_channels.size()) {0u}; i < m_channels.size(); ++i) {
+		auto *expr = m_channels[i]->GetValueExpressionObject();
+		if((expr ? expr->GetId() : 0) != m_graphExpressionIds[i])
+			return true;
+	}
+	return false;
+}
+
+bool panima::Animation::UpdateExpressionGraph(std::vector<uint32_t> *optOutCyclicChannels)
+{
+	m_expressionEvaluationOrder.clear();
+	auto numChannels = m_channels.size();
+	m_graphExpressionIds.assign(numChannels, 0);
+	std::vector<uint32_t> exprChannels;
+	std::vector<uint32_t> numDependencies(numChannels, 0);
+	std::vector<std::vector<uint32_t>> dependents(numChannels);
+	for(auto i = decltype(numChannels) {0u}; i < numChannels; ++i) {
+		auto *expr = m_channels[i]->GetValueExpressionObject();
+		if(!expr)
+			continue;
+		exprChannels.push_back(i);
+		m_graphExpressionIds[i] = expr->GetId();
+		std::vector<expression::ValueExpression::ChannelReference> refs;
+		for(auto &path : expr->FindChannelReferencePaths()) {
+			auto optIdx = FindChannelIndex(ChannelPathRegistry::Get().Find(path));
+			if(!optIdx)
+				continue; // Unresolved references evaluate to 0
+			auto idx = *optIdx;
+			auto it = m_channels.begin() + idx;
+			refs.push_back({path, *it});
+			// A channel referencing itself will read its value before the expression was applied,
+			// and channels without expressions are always sampled first, so neither is a dependency
+			if(idx == i || !(*it)->GetValueExpressionObject())
+				continue;
+			dependents[idx].push_back(i);
+			++numDependencies[i];
+		}
+		expr->SetChannelReferences(std::move(refs));
+	}
+
+	// Topological sort (Kahn's algorithm), the evaluation order doubles as the work queue
+	m_expressionEvaluationOrder.reserve(exprChannels.size());
+	for(auto idx : exprChannels) {
+		if(numDependencies[idx] == 0)
+			m_expressionEvaluationOrder.push_back(idx);
+	}
+	for(size_t i = 0; i < m_expressionEvaluationOrder.size(); ++i) {
+		for(auto idxDependent : dependents[m_expressionEvaluationOrder[i]]) {
+			if(--numDependencies[idxDependent] == 0)
+				m_expressionEvaluationOrder.push_back(idxDependent);
+		}
+	}
+	if(m_expressionEvaluationOrder.size() == exprChannels.size())
+		return true;
+
+	// Remaining channels are part of (or depend on) a cycle
+	for(auto idx : exprChannels) {
+		if(numDependencies[idx] == 0)
+			continue;
+		m_expressionEvaluationOrder.push_back(idx);
+		if(optOutCyclicChannels)
+			optOutCyclicChannels->push_back(idx);
+	}
+	return false;
+}
+
+void panima::Animation::Evaluate(double t, Slice &inOutSlice, std::vector<uint32_t> &inOutPivotTimeIndices, expression::EvaluationContext &context, const std::vector<uint8_t> *optChannelMask,
+  std::vector<uint32_t> *optOutChangedChannels) const
+{
+	auto numChannels = m_channels.size();
+	inOutSlice.channelValues.resize(numChannels);
+	inOutPivotTimeIndices.resize(numChannels, std::numeric_limits<uint32_t>::max());
+	auto isMasked = [optChannelMask](size_t idx) { return optChannelMask && idx < optChannelMask->size() && (*optChannelMask)[idx] == 0; };
+	for(auto i = decltype(numChannels) {0u}; i < numChannels; ++i) {
+		auto &channel = *m_channels[i];
+		auto &prop = inOutSlice.channelValues[i];
+		auto isNewProperty = false;
+		if(!prop || prop->type != channel.GetValueType()) {
+			prop = udm::Property::Create(channel.GetValueType());
+			isNewProperty = true;
+		}
+		if(isMasked(i))
+			continue;
+		auto &pivotTimeIndex = inOutPivotTimeIndices[i];
+		if(!optOutChangedChannels) {
+			udm::visit_ng(channel.GetValueType(), [&channel, &prop, &pivotTimeIndex, t](auto tag) {
+				using T = typename decltype(tag)::type;
+				if constexpr(is_animatable_type(udm::type_to_enum<T>()))
+					prop->GetValue<T>() = channel.GetInterpolatedValue<T>(t, pivotTimeIndex);
+			});
+			continue;
+		}
+		// A valid pivot index means the channel has been sampled into this slice before
+		if(!isNewProperty && pivotTimeIndex != std::numeric_limits<uint32_t>::max() && (channel.IsConstant() || channel.IsInConstantSpan(t, pivotTimeIndex)))
+			continue;
+		// Channels with value expressions are reported after the expressions have been applied
+		auto trackChanges = (channel.GetValueExpressionObject() == nullptr);
+		udm::visit_ng(channel.GetValueType(), [&channel, &prop, &pivotTimeIndex, t, i, isNewProperty, trackChanges, optOutChangedChannels](auto tag) {
+			using T = typename decltype(tag)::type;
+			if constexpr(is_animatable_type(udm::type_to_enum<T>())) {
+				auto value = channel.GetInterpolatedValue<T>(t, pivotTimeIndex);
+				auto &curValue = prop->GetValue<T>();
+				if(trackChanges && !isNewProperty && std::memcmp(&curValue, &value, sizeof(T)) == 0)
+					return;
+				curValue = value;
+				if(trackChanges)
+					optOutChangedChannels->push_back(static_cast<uint32_t>(i));
+			}
+		});
+	}
+	auto applyExpression = [this, &inOutSlice, &inOutPivotTimeIndices, &context, &isMasked, t, optOutChangedChannels](uint32_t idx) {
+		if(isMasked(idx))
+			return;
+		auto &channel = *m_channels[idx];
+		auto &prop = inOutSlice.channelValues[idx];
+		udm::visit_ng(channel.GetValueType(), [&channel, &prop, &context, pivotTimeIndex = inOutPivotTimeIndices[idx], t](auto tag) {
+			using T = typename decltype(tag)::type;
+			if constexpr(is_supported_expression_type_v<T> && is_animatable_type(udm::type_to_enum<T>()))
+				channel.ApplyValueExpression<T>(context, t, pivotTimeIndex, prop->GetValue<T>());
+		});
+		if(optOutChangedChannels)
+			optOutChangedChannels->push_back(idx);
+	};
+	// Expression ids are unique, so this also detects channels that have been added, removed or moved since the last graph update
+	auto isInGraph = [this](size_t idx) {
+		auto *expr = m_channels[idx]->GetValueExpressionObject();
+		return expr && idx < m_graphExpressionIds.size() && m_graphExpressionIds[idx] == expr->GetId();
+	};
+	context.SetSlice(&inOutSlice);
+	context.SetAnimation(this);
+	for(auto idx : m_expressionEvaluationOrder) {
+		if(idx < numChannels && isInGraph(idx))
+			applyExpression(idx);
+	}
+	// Expressions that aren't part of the graph (yet) are applied afterwards, in channel order
+	for(auto i = decltype(numChannels) {0u}; i < numChannels; ++i) {
+		if(m_channels[i]->GetValueExpressionObject() && !isInGraph(i))
+			applyExpression(static_cast<uint32_t>(i));
+	}
+	context.SetAnimation(nullptr);
+	context.SetSlice(nullptr);
+}
+
+uint32_t panima::Animation::PrecompileExpressions(const TaskExecutor &executor)
+{
+	uint32_t numScheduled = 0;
+	for(auto &channel : m_channels) {
+		if(!channel->HasPendingValueExpression())
+			continue;
+		++numScheduled;
+		if(!executor) {
+			channel->CompileValueExpression();
+			continue;
+		}
+		executor([channel]() { channel->CompileValueExpression(); });
+	}
+	return numScheduled;
+}
+
+void panima::Animation::Prefetch()
+{
+	for(auto &channel : m_channels)
+		channel->Prefetch();
+	if(IsExpressionGraphDirty())
+		UpdateExpressionGraph();
+}
+
+bool panima::Animation::IsReady() const
+{
+	if(IsExpressionGraphDirty())
+		return false;
+	return std::all_of(m_channels.begin(), m_channels.end(), [](const std::shared_ptr<Channel> &channel) { return channel->IsReady(); });
+}
+
 std::ostream &operator<<(std::ostream &out, const panima::Animation &o)
 {
 	out << "Animation";
@@ -113,3 +568,20 @@ std::ostream &operator<<(std::ostream &out, const panima::Animation &o)
 	out << "[AnimSpeedFactor:" << o.GetAnimationSpeedFactor() << "]";
 	return out;
 }
+
+panima::MemoryUsage panima::Animation::GetMemoryUsage() const
+{
+	MemoryUsage usage {};
+	usage.objectBytes = sizeof(*this) + m_channels.capacity() * sizeof(m_channels.front());
+	usage.stringBytes = m_name.capacity();
+	// Approximation of the node and bucket overhead of the hash map
+	usage.derivedBytes = m_channelIndex.size() * (sizeof(decltype(m_channelIndex)::value_type) + sizeof(void *) * 2) + m_channelIndex.bucket_count() * sizeof(void *);
+	usage.derivedBytes += m_expressionEvaluationOrder.capacity() * sizeof(uint32_t) + m_graphExpressionIds.capacity() * sizeof(uint64_t);
+	for(auto &channel : m_channels) {
+		auto channelUsage = channel->GetMemoryUsage();
+		if(channel.use_count() > 1)
+			channelUsage.MarkShared();
+		usage += channelUsage;
+	}
+	return usage;
+}
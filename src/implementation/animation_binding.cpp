@@ -0,0 +1,114 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <udm.hpp>
+#include <memory>
+#include <mutex>
+
+module panima;
+
+import :animation_binding;
+import :animation;
+import :channel;
+import :expression;
+
+std::shared_ptr<panima::AnimationBinding> panima::AnimationBinding::Create(const Animation &animation, const AnimationTargetSchema &schema)
+{
+	auto binding = std::shared_ptr<AnimationBinding> {new AnimationBinding {}};
+	binding->m_animation = &animation;
+	binding->m_animationRef = animation.weak_from_this();
+	binding->m_hasAnimationRef = !binding->m_animationRef.expired();
+	binding->m_animationRevision = animation.GetChannelLayoutRevision();
+	auto &channels = animation.GetChannels();
+	auto numChannels = static_cast<uint32_t>(channels.size());
+	binding->m_channelToSlot.resize(numChannels, INVALID_INDEX);
+	binding->m_slotToChannel.resize(schema.GetSlotCount(), INVALID_INDEX);
+	binding->m_channelMask.resize(numChannels, 0);
+	std::vector<uint32_t> queue;
+	queue.reserve(numChannels);
+	for(auto i = decltype(numChannels) {0u}; i < numChannels; ++i) {
+		auto slot = schema.FindSlot(channels[i]->targetPath.GetId());
+		// If multiple channels share the same path, the first one takes precedence (see Animation::FindChannel)
+		if(!slot || binding->m_slotToChannel[*slot] != INVALID_INDEX)
+			continue;
+		binding->m_channelToSlot[i] = *slot;
+		binding->m_slotToChannel[*slot] = i;
+		binding->m_channelMask[i] = 1;
+		queue.push_back(i);
+	}
+	// Channels referenced by the expressions of bound channels have to be evaluated as well
+	for(size_t i = 0; i < queue.size(); ++i) {
+		auto *expr = channels[queue[i]]->GetValueExpressionObject();
+		if(!expr)
+			continue;
+		for(auto &path : expr->FindChannelReferencePaths()) {
+			auto idx = animation.FindChannelIndex(ChannelPathRegistry::Get().Find(path));
+			if(!idx || binding->m_channelMask[*idx])
+				continue;
+			binding->m_channelMask[*idx] = 1;
+			queue.push_back(*idx);
+		}
+	}
+	return binding;
+}
+
+std::shared_ptr<panima::AnimationTargetSchema> panima::AnimationTargetSchema::Create(const std::vector<std::string> &targetPaths)
+{
+	auto schema = std::shared_ptr<AnimationTargetSchema> {new AnimationTargetSchema {}};
+	auto &registry = ChannelPathRegistry::Get();
+	schema->m_slotPaths.reserve(targetPaths.size());
+	schema->m_pathToSlot.reserve(targetPaths.size());
+	for(auto &path : targetPaths) {
+		auto id = registry.Intern(path);
+		// Duplicate paths are ignored
+		if(!schema->m_pathToSlot.emplace(id, static_cast<uint32_t>(schema->m_slotPaths.size())).second)
+			continue;
+		schema->m_slotPaths.push_back(id);
+	}
+	return schema;
+}
+
+std::optional<uint32_t> panima::AnimationTargetSchema::FindSlot(ChannelPathId pathId) const
+{
+	auto it = m_pathToSlot.find(pathId);
+	if(it == m_pathToSlot.end())
+		return {};
+	return it->second;
+}
+
+std::shared_ptr<const panima::AnimationBinding> panima::AnimationTargetSchema::GetBinding(const Animation &animation) const
+{
+	auto isCurrent = [&animation](const AnimationBinding &binding) {
+		// The animation may have been destroyed and another one allocated at the same address
+		if(binding.m_hasAnimationRef && binding.m_animationRef.lock().get() != &animation)
+			return false;
+		return binding.IsValid(animation);
+	};
+	{
+		std::scoped_lock lock {m_bindingMutex};
+		auto it = m_bindings.find(&animation);
+		if(it != m_bindings.end() && isCurrent(*it->second))
+			return it->second;
+	}
+	// Bindings are created without holding the lock, so other lookups aren't blocked
+	std::shared_ptr<const AnimationBinding> binding = AnimationBinding::Create(animation, *this);
+	std::scoped_lock lock {m_bindingMutex};
+	// Remove the bindings of animations that no longer exist
+	// (this can't be determined for animations that aren't owned by a shared pointer)
+	for(auto it = m_bindings.begin(); it != m_bindings.end();) {
+		if(it->second->m_hasAnimationRef && it->second->m_animationRef.expired())
+			it = m_bindings.erase(it);
+		else
+			++it;
+	}
+	m_bindings[&animation] = binding;
+	return binding;
+}
+
+void panima::AnimationTargetSchema::ClearBindingCache()
+{
+	std::scoped_lock lock {m_bindingMutex};
+	m_bindings.clear();
+}
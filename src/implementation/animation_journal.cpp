@@ -0,0 +1,199 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <udm.hpp>
+#include <string>
+#include <random>
+#include <filesystem>
+#include <system_error>
+#include <exception>
+
+module panima;
+
+import :animation_journal;
+import :animation;
+import :trace;
+
+static constexpr uint32_t ANIMATION_JOURNAL_FORMAT_VERSION = 1;
+
+static std::shared_ptr<udm::Data> load_udm_data(const std::string &fileName, std::string &outErr)
+{
+	try {
+		auto data = udm::Data::Load(fileName);
+		if(!data)
+			outErr = "Failed to load '" + fileName + "'!";
+		return data;
+	}
+	catch(const std::exception &e) {
+		outErr = "Failed to load '" + fileName + "': " + e.what();
+	}
+	return nullptr;
+}
+
+// The data is written to a temporary file first, so that an interrupted save never leaves a partially written file behind
+static bool save_udm_data(udm::Data &data, const std::string &fileName, uint64_t &outSize, std::string &outErr)
+{
+	auto tmpFileName = fileName + ".tmp";
+	try {
+		if(!data.Save(tmpFileName)) {
+			outErr = "Failed to write '" + fileName + "'!";
+			return false;
+		}
+	}
+	catch(const std::exception &e) {
+		outErr = "Failed to write '" + fileName + "': " + e.what();
+		return false;
+	}
+	std::error_code ec;
+	outSize = std::filesystem::file_size(tmpFileName, ec);
+	if(!ec)
+		std::filesystem::rename(tmpFileName, fileName, ec);
+	if(ec) {
+		outErr = "Failed to write '" + fileName + "': " + ec.message();
+		std::filesystem::remove(tmpFileName, ec);
+		return false;
+	}
+	return true;
+}
+
+static uint64_t generate_journal_generation()
+{
+	std::random_device rd {};
+	return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+panima::AnimationJournal::AnimationJournal(std::string fileName) : m_fileName {std::move(fileName)} {}
+
+std::string panima::AnimationJournal::GetEntryFileName(uint32_t sequence) const
+{
+	auto path = std::filesystem::path {m_fileName};
+	return (path.parent_path() / (path.stem().string() + "_journal" + std::to_string(sequence) + ".udm")).string();
+}
+
+void panima::AnimationJournal::RemoveEntries(uint32_t firstSequence)
+{
+	std::error_code ec;
+	for(auto sequence = firstSequence;; ++sequence) {
+		if(!std::filesystem::remove(GetEntryFileName(sequence), ec))
+			break;
+	}
+}
+
+bool panima::AnimationJournal::Compact(const Animation &anim, std::string &outErr)
+{
+	trace::Zone zone {"panima::AnimationJournal::Compact"};
+	// The new generation invalidates all existing entries, even if removing them below fails
+	auto generation = generate_journal_generation();
+	auto data = udm::Data::Create();
+	auto udmData = data->GetAssetData().GetData();
+	auto udmJournal = udmData["journal"];
+	udmJournal["version"] = ANIMATION_JOURNAL_FORMAT_VERSION;
+	udmJournal["generation"] = generation;
+	auto udmAnim = udmData["animation"];
+	auto snapshot = anim.CreateSnapshot();
+	anim.Save(udmAnim);
+	uint64_t size = 0;
+	if(!save_udm_data(*data, m_fileName, size, outErr)) {
+		m_compactionRequired = true;
+		return false;
+	}
+	m_baseline = std::move(snapshot);
+	m_generation = generation;
+	m_hasBase = true;
+	m_compactionRequired = false;
+	m_baseSize = size;
+	m_journalSize = 0;
+	m_entryCount = 0;
+	RemoveEntries(1);
+	return true;
+}
+
+bool panima::AnimationJournal::Save(const Animation &anim, std::string &outErr)
+{
+	if(!m_hasBase || m_compactionRequired || m_entryCount >= m_maxEntryCount || m_journalSize > static_cast<uint64_t>(m_baseSize * m_maxSizeRatio))
+		return Compact(anim, outErr);
+	if(!anim.HasUnsavedChanges(m_baseline))
+		return true;
+	trace::Zone zone {"panima::AnimationJournal::Save"};
+	auto sequence = m_entryCount + 1;
+	auto data = udm::Data::Create();
+	auto udmData = data->GetAssetData().GetData();
+	auto udmJournal = udmData["journal"];
+	udmJournal["version"] = ANIMATION_JOURNAL_FORMAT_VERSION;
+	udmJournal["generation"] = m_generation;
+	udmJournal["sequence"] = sequence;
+	auto udmChanges = udmData["changes"];
+	auto snapshot = anim.CreateSnapshot();
+	anim.SaveChanges(udmChanges, m_baseline);
+	uint64_t size = 0;
+	// The baseline is only advanced once the entry has been written, so the changes are written again by the next save if this one fails
+	if(!save_udm_data(*data, GetEntryFileName(sequence), size, outErr))
+		return false;
+	m_baseline = std::move(snapshot);
+	m_entryCount = sequence;
+	m_journalSize += size;
+	return true;
+}
+
+bool panima::AnimationJournal::Load(Animation &anim, std::string &outErr)
+{
+	trace::Zone zone {"panima::AnimationJournal::Load"};
+	auto data = load_udm_data(m_fileName, outErr);
+	if(!data)
+		return false;
+	auto udmData = data->GetAssetData().GetData();
+	auto udmJournal = udmData["journal"];
+	uint32_t version = 0;
+	udmJournal["version"](version);
+	if(version != ANIMATION_JOURNAL_FORMAT_VERSION) {
+		outErr = "Unsupported animation journal version " + std::to_string(version) + "!";
+		return false;
+	}
+	uint64_t generation = 0;
+	udmJournal["generation"](generation);
+	auto udmAnim = udmData["animation"];
+	if(!anim.Load(udmAnim)) {
+		outErr = "Failed to load animation from '" + m_fileName + "'!";
+		return false;
+	}
+	std::error_code ec;
+	m_baseline = anim.CreateSnapshot();
+	m_generation = generation;
+	m_hasBase = true;
+	m_compactionRequired = false;
+	m_baseSize = std::filesystem::file_size(m_fileName, ec);
+	m_journalSize = 0;
+	m_entryCount = 0;
+
+	// Entries are replayed up to the first one that is missing or belongs to a different base file
+	for(auto sequence = 1u;; ++sequence) {
+		auto entryFileName = GetEntryFileName(sequence);
+		if(!std::filesystem::exists(entryFileName, ec))
+			break;
+		auto entryData = load_udm_data(entryFileName, outErr);
+		if(!entryData) {
+			m_compactionRequired = true;
+			return false;
+		}
+		auto udmEntry = entryData->GetAssetData().GetData();
+		auto udmEntryJournal = udmEntry["journal"];
+		uint64_t entryGeneration = 0;
+		uint32_t entrySequence = 0;
+		udmEntryJournal["generation"](entryGeneration);
+		udmEntryJournal["sequence"](entrySequence);
+		if(entryGeneration != m_generation || entrySequence != sequence)
+			break;
+		auto udmChanges = udmEntry["changes"];
+		if(!anim.ApplyChanges(udmChanges, m_baseline)) {
+			outErr = "Failed to apply journal entry '" + entryFileName + "'!";
+			m_compactionRequired = true;
+			return false;
+		}
+		m_baseline = anim.CreateSnapshot();
+		m_entryCount = sequence;
+		m_journalSize += std::filesystem::file_size(entryFileName, ec);
+	}
+	return true;
+}
@@ -3,9 +3,13 @@
 
 module;
 
+#include <udm.hpp>
 #include <memory>
 #include <string_view>
 #include <optional>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
 
 module panima;
 
@@ -13,25 +17,28 @@ import :animation_manager;
 import :animation_set;
 import :animation;
 import :player;
+import :expression;
 
 std::shared_ptr<panima::AnimationManager> panima::AnimationManager::Create(const AnimationManager &other) { return std::shared_ptr<AnimationManager> {new AnimationManager {other}}; }
 std::shared_ptr<panima::AnimationManager> panima::AnimationManager::Create(AnimationManager &&other) { return std::shared_ptr<AnimationManager> {new AnimationManager {std::move(other)}}; }
 std::shared_ptr<panima::AnimationManager> panima::AnimationManager::Create() { return std::shared_ptr<AnimationManager> {new AnimationManager {}}; }
 panima::AnimationManager::AnimationManager(const AnimationManager &other)
     : m_player {panima::Player::Create(*other.m_player)}, m_animationSets {other.m_animationSets}, m_currentAnimation {other.m_currentAnimation}, m_setNameToIndex {other.m_setNameToIndex}, m_currentAnimationSet {other.m_currentAnimationSet}, m_prevAnimSlice {other.m_prevAnimSlice},
-      m_priority {other.m_priority}
+      m_priority {other.m_priority}, m_fadeDuration {other.m_fadeDuration}, m_fadeTime {other.m_fadeTime}, m_fadeSourceAnimation {other.m_fadeSourceAnimation}, m_fadeBlendPlanDirty {true}
 /*,m_channelValueSubmitters{m_channelValueSubmitters}*/
 {
+	CopyLayers(other);
 #ifdef _MSC_VER
-	static_assert(sizeof(*this) == 392, "Update this implementation when class has changed!");
+	static_assert(sizeof(*this) == 1168, "Update this implementation when class has changed!");
 #endif
 }
 panima::AnimationManager::AnimationManager(AnimationManager &&other)
     : m_player {panima::Player::Create(*other.m_player)}, m_animationSets {std::move(other.m_animationSets)}, m_currentAnimation {other.m_currentAnimation}, m_setNameToIndex {std::move(other.m_setNameToIndex)}, m_currentAnimationSet {other.m_currentAnimationSet},
-      m_prevAnimSlice {std::move(other.m_prevAnimSlice)}, m_priority {other.m_priority} /*,m_channelValueSubmitters{std::move(m_channelValueSubmitters)}*/
+      m_prevAnimSlice {std::move(other.m_prevAnimSlice)}, m_priority {other.m_priority}, m_fadeDuration {other.m_fadeDuration}, m_fadeTime {other.m_fadeTime}, m_fadeSourceAnimation {std::move(other.m_fadeSourceAnimation)}, m_fadeBlendPlanDirty {true} /*,m_channelValueSubmitters{std::move(m_channelValueSubmitters)}*/
 {
+	CopyLayers(other);
 #ifdef _MSC_VER
-	static_assert(sizeof(*this) == 392, "Update this implementation when class has changed!");
+	static_assert(sizeof(*this) == 1168, "Update this implementation when class has changed!");
 #endif
 }
 panima::AnimationManager::AnimationManager() : m_player {panima::Player::Create()} {}
@@ -42,12 +49,21 @@ panima::AnimationManager &panima::AnimationManager::operator=(const AnimationMan
 	m_currentAnimation = other.m_currentAnimation;
 	m_currentAnimationSet = other.m_currentAnimationSet;
 	m_setNameToIndex = other.m_setNameToIndex;
+	m_animationNameIndexDirty = true;
 
 	m_prevAnimSlice = other.m_prevAnimSlice;
 	m_priority = other.m_priority;
+	m_fadeDuration = other.m_fadeDuration;
+	m_fadeTime = other.m_fadeTime;
+	m_fadeSourceAnimation = other.m_fadeSourceAnimation;
+	// The blend plan references the slices of the other manager, so it has to be rebuilt
+	m_fadeTargetAnimation = nullptr;
+	m_fadeBlendPlan.Clear();
+	m_fadeBlendPlanDirty = true;
+	CopyLayers(other);
 	// m_channelValueSubmitters = other.m_channelValueSubmitters;
 #ifdef _MSC_VER
-	static_assert(sizeof(*this) == 392, "Update this implementation when class has changed!");
+	static_assert(sizeof(*this) == 1168, "Update this implementation when class has changed!");
 #endif
 	return *this;
 }
@@ -58,13 +74,21 @@ panima::AnimationManager &panima::AnimationManager::operator=(AnimationManager &
 	m_currentAnimation = other.m_currentAnimation;
 	m_currentAnimationSet = other.m_currentAnimationSet;
 	m_setNameToIndex = std::move(other.m_setNameToIndex);
+	m_animationNameIndexDirty = true;
 
 	m_prevAnimSlice = std::move(other.m_prevAnimSlice);
 	m_priority = other.m_priority;
+	m_fadeDuration = other.m_fadeDuration;
+	m_fadeTime = other.m_fadeTime;
+	m_fadeSourceAnimation = std::move(other.m_fadeSourceAnimation);
+	m_fadeTargetAnimation = nullptr;
+	m_fadeBlendPlan.Clear();
+	m_fadeBlendPlanDirty = true;
+	CopyLayers(other);
 	// m_channelValueSubmitters = std::move(other.m_channelValueSubmitters);
 
 #ifdef _MSC_VER
-	static_assert(sizeof(*this) == 392, "Update this implementation when class has changed!");
+	static_assert(sizeof(*this) == 1168, "Update this implementation when class has changed!");
 #endif
 	return *this;
 }
@@ -77,17 +101,92 @@ void panima::AnimationManager::RemoveAnimationSet(const std::string_view &name)
 	if(it == m_setNameToIndex.end())
 		return;
 	auto idx = it->second;
-	auto &set = m_animationSets[idx];
+	auto set = m_animationSets[idx];
 	if(m_currentAnimationSet.lock().get() == set.get())
 		StopAnimation();
+	// Entries pointing to the set have to be up to date, so that all of them are found below
+	UpdateAnimationNameIndex();
 	m_animationSets.erase(m_animationSets.begin() + idx);
 	m_setNameToIndex.erase(it);
+	for(auto &pair : m_setNameToIndex) {
+		if(pair.second > idx)
+			--pair.second;
+	}
+	m_animationNameIndexRevisions.erase(m_animationNameIndexRevisions.begin() + idx);
+	for(auto &[animName, setIdx] : m_animationNameIndex) {
+		if(setIdx > idx)
+			--setIdx;
+	}
+	for(auto &[animName, id] : set->GetNameToIdMap())
+		UpdateAnimationNameIndexEntry(animName);
 }
 void panima::AnimationManager::AddAnimationSet(std::string name, panima::AnimationSet &animSet)
 {
 	RemoveAnimationSet(name);
 	m_animationSets.push_back(animSet.shared_from_this());
 	m_setNameToIndex[name] = m_animationSets.size() - 1;
+	if(!m_animationNameIndexDirty) {
+		// Sets that were added earlier take precedence
+		m_animationNameIndexRevisions.push_back(animSet.GetRevision());
+		for(auto &[animName, id] : animSet.GetNameToIdMap())
+			m_animationNameIndex.try_emplace(animName, static_cast<AnimationSetIndex>(m_animationSets.size() - 1));
+	}
+}
+bool panima::AnimationManager::PrefetchAnimation(const std::string &animation)
+{
+	auto ref = FindAnimationByName(animation);
+	if(ref == INVALID_ANIMATION_REFERENCE)
+		return false;
+	m_animationSets[ref.first]->Prefetch(ref.second, m_prefetchExecutor);
+	return true;
+}
+bool panima::AnimationManager::IsAnimationReady(const std::string &animation) const
+{
+	auto ref = FindAnimationByName(animation);
+	if(ref == INVALID_ANIMATION_REFERENCE)
+		return false;
+	return m_animationSets[ref.first]->IsAnimationReady(ref.second);
+}
+void panima::AnimationManager::UpdateAnimationNameIndexEntry(const std::string &name) const
+{
+	// If multiple sets contain the same animation name, the first set takes precedence
+	auto it = std::find_if(m_animationSets.begin(), m_animationSets.end(), [&name](const PAnimationSet &set) { return set->LookupAnimation(name).has_value(); });
+	if(it != m_animationSets.end())
+		m_animationNameIndex.insert_or_assign(name, static_cast<AnimationSetIndex>(it - m_animationSets.begin()));
+	else
+		m_animationNameIndex.erase(name);
+}
+void panima::AnimationManager::UpdateAnimationNameIndex() const
+{
+	auto numSets = m_animationSets.size();
+	if(!m_animationNameIndexDirty) {
+		// Only the names that have been added to or removed from a set since have to be resolved again
+		std::vector<std::string> changedNames;
+		for(auto i = decltype(numSets) {0u}; i < numSets; ++i) {
+			auto &set = *m_animationSets[i];
+			if(set.GetRevision() == m_animationNameIndexRevisions[i])
+				continue;
+			if(!set.GetChangedNames(m_animationNameIndexRevisions[i], changedNames)) {
+				m_animationNameIndexDirty = true;
+				break;
+			}
+			m_animationNameIndexRevisions[i] = set.GetRevision();
+		}
+		if(!m_animationNameIndexDirty) {
+			for(auto &name : changedNames)
+				UpdateAnimationNameIndexEntry(name);
+			return;
+		}
+	}
+	m_animationNameIndexDirty = false;
+	m_animationNameIndex.clear();
+	m_animationNameIndexRevisions.resize(numSets);
+	for(auto i = decltype(numSets) {0u}; i < numSets; ++i) {
+		auto &set = *m_animationSets[i];
+		m_animationNameIndexRevisions[i] = set.GetRevision();
+		for(auto &[name, id] : set.GetNameToIdMap())
+			m_animationNameIndex.try_emplace(name, static_cast<AnimationSetIndex>(i));
+	}
 }
 
 void panima::AnimationManager::PlayAnimation(const std::string &animation, PlaybackFlags flags)
@@ -157,14 +256,24 @@ panima::AnimationManager::AnimationReference panima::AnimationManager::FindAnima
 }
 panima::AnimationManager::AnimationReference panima::AnimationManager::FindAnimation(const std::string &animation, PlaybackFlags flags) const
 {
-	for(auto it = m_animationSets.begin(); it != m_animationSets.end(); ++it) {
-		auto &set = **it;
-		auto animId = set.LookupAnimation(animation);
-		if(!animId.has_value())
-			continue;
-		return FindAnimation(it - m_animationSets.begin(), *animId, flags);
-	}
-	return INVALID_ANIMATION_REFERENCE;
+	auto ref = FindAnimationByName(animation);
+	if(ref == INVALID_ANIMATION_REFERENCE)
+		return INVALID_ANIMATION_REFERENCE;
+	return FindAnimation(ref.first, ref.second, flags);
+}
+panima::AnimationManager::AnimationReference panima::AnimationManager::FindAnimationByName(const std::string &animation) const
+{
+	UpdateAnimationNameIndex();
+	auto it = m_animationNameIndex.find(animation);
+	if(it == m_animationNameIndex.end())
+		return INVALID_ANIMATION_REFERENCE;
+	auto setIdx = it->second;
+	if(setIdx >= m_animationSets.size())
+		return INVALID_ANIMATION_REFERENCE;
+	auto id = m_animationSets[setIdx]->LookupAnimation(animation);
+	if(!id)
+		return INVALID_ANIMATION_REFERENCE;
+	return {setIdx, *id};
 }
 
 void panima::AnimationManager::PlayAnimation(AnimationSetIndex animSetIndex, panima::AnimationId animIdx, PlaybackFlags flags)
@@ -182,12 +291,30 @@ void panima::AnimationManager::PlayAnimation(AnimationSetIndex animSetIndex, pan
 
 	if(!reset && (*this)->GetCurrentTime() == 0.f && m_currentFlags == flags)
 		return;
+
+	// The pose has to be captured before the callback, which may already switch the animation of the player
+	auto *prevAnim = (*this)->GetAnimation();
+	auto fade = m_fadeDuration > 0.f && prevAnim && !(*this)->GetCurrentSlice().channelValues.empty();
+	if(fade) {
+		panima::Slice::CopyValues((*this)->GetCurrentSlice(), m_prevAnimSlice);
+		m_fadeSourceAnimation = prevAnim->shared_from_this();
+		m_fadeTargetAnimation = nullptr;
+		m_fadeBlendPlanDirty = true;
+	}
 	if(m_callbackInterface.onPlayAnimation && m_callbackInterface.onPlayAnimation(*set, animIdx, flags) == false)
-		return;
+		return; // If a crossfade was already active, it continues from the captured pose
+	if(fade)
+		m_fadeTime = 0.f;
+	else
+		StopFade();
 	m_currentAnimationSet = set;
 	m_currentAnimation = animIdx;
 	(*this)->Reset();
 	m_currentFlags = flags;
+	// The animation must not be evaluated while it's being prefetched
+	m_pendingPrefetch = set->GetPendingPrefetch(animIdx);
+	if(!m_pendingPrefetch.valid() && (flags & PlaybackFlags::PrefetchBit) != PlaybackFlags::None && !set->IsAnimationReady(animIdx))
+		m_pendingPrefetch = set->Prefetch(animIdx, m_prefetchExecutor);
 #ifdef PRAGMA_ENABLE_ANIMATION_SYSTEM_2
 	auto &channels = anim->GetChannels();
 	m_currentSlice.channelValues.resize(channels.size());
@@ -228,24 +355,303 @@ void panima::AnimationManager::StopAnimation()
 	m_currentAnimation = panima::INVALID_ANIMATION;
 	(*this)->Reset();
 	m_currentFlags = PlaybackFlags::None;
+	m_pendingPrefetch = {};
+	StopFade();
 }
-void panima::AnimationManager::ApplySliceInterpolation(const panima::Slice &src, panima::Slice &dst, float f)
+void panima::AnimationManager::StopFade()
+{
+	m_fadeSourceAnimation = nullptr;
+	m_fadeTargetAnimation = nullptr;
+	m_fadeBlendPlan.Clear();
+	m_fadeBlendPlanDirty = false;
+	m_fadeTime = 0.f;
+}
+void panima::AnimationManager::UpdateFadeBlendPlan(const panima::Animation &anim)
+{
+	m_fadeTargetAnimation = &anim;
+	m_fadeBlendPlanDirty = false;
+	auto &dstSlice = (*this)->GetCurrentSlice();
+	if(&anim == m_fadeSourceAnimation.get()) {
+		m_fadeBlendPlan.Build(m_prevAnimSlice, dstSlice);
+		return;
+	}
+	// The animations don't necessarily share the same channel layout, so the channels are matched by their target paths
+	auto &srcChannels = m_fadeSourceAnimation->GetChannels();
+	std::unordered_map<std::string, uint32_t> srcPathToIndex;
+	srcPathToIndex.reserve(srcChannels.size());
+	for(auto i = decltype(srcChannels.size()) {0u}; i < srcChannels.size(); ++i)
+		srcPathToIndex[srcChannels[i]->targetPath.ToUri()] = i;
+	auto &dstChannels = anim.GetChannels();
+	std::vector<uint32_t> dstToSrc;
+	dstToSrc.resize(dstChannels.size(), panima::SliceBlendPlan::INVALID_CHANNEL);
+	for(auto i = decltype(dstChannels.size()) {0u}; i < dstChannels.size(); ++i) {
+		auto it = srcPathToIndex.find(dstChannels[i]->targetPath.ToUri());
+		if(it != srcPathToIndex.end())
+			dstToSrc[i] = it->second;
+	}
+	m_fadeBlendPlan.Build(m_prevAnimSlice, dstSlice, &dstToSrc);
+}
+bool panima::AnimationManager::Advance(float dt, bool force)
+{
+	if(m_pendingPrefetch.valid()) {
+		if(m_pendingPrefetch.wait_for(std::chrono::seconds {0}) != std::future_status::ready)
+			return false;
+		m_pendingPrefetch = {};
+	}
+	auto updated = false;
+	if(!m_fadeSourceAnimation)
+		updated = m_player->Advance(dt, force);
+	else {
+		// The slice has to be re-sampled for every step of the fade, otherwise the blend would be applied on top of the previous result
+		updated = m_player->Advance(dt, true);
+		m_fadeTime += dt;
+		auto *anim = m_player->GetAnimation();
+		if(!anim || m_fadeTime >= m_fadeDuration)
+			StopFade();
+		else {
+			if(m_fadeBlendPlanDirty || anim != m_fadeTargetAnimation)
+				UpdateFadeBlendPlan(*anim);
+			m_fadeBlendPlan.Apply(m_fadeTime / m_fadeDuration);
+			if(m_player->IsChangeTrackingEnabled())
+				m_player->MarkAllChannelsChanged();
+		}
+	}
+	if(m_layers.empty()) {
+		if(updated)
+			ApplyChannelBindings(m_player->GetCurrentSlice(), m_player->IsChangeTrackingEnabled() ? &m_player->GetChangedChannels() : nullptr);
+		return updated;
+	}
+	for(auto &layerData : m_layers) {
+		if(layerData.layer.player->Advance(dt, force))
+			updated = true;
+	}
+	if(!updated && !force && !IsLayerLayoutDirty())
+		return false;
+	ComposeLayers();
+	ApplyChannelBindings(m_outputSlice, nullptr);
+	return true;
+}
+
+void panima::AnimationManager::ApplyChannelBindings(const panima::Slice &slice, const std::vector<uint32_t> *optChangedChannels) const
+{
+	if(m_channelBindings.IsEmpty())
+		return;
+	// With a target schema the bindings are keyed by slot, which are resolved through the binding of the current animation.
+	// Channels of the base animation have the same indices in the output slice, so this applies to layers as well.
+	auto *binding = m_player->GetBinding();
+	if(m_player->GetTargetSchema() && !binding)
+		return;
+	if(optChangedChannels)
+		m_channelBindings.Apply(slice, *optChangedChannels, binding);
+	else
+		m_channelBindings.Apply(slice, binding);
+}
+
+uint32_t panima::AnimationManager::AddLayer(const AnimationLayer &layer)
+{
+	auto &layerData = m_layers.emplace_back();
+	layerData.layer = layer;
+	if(!layerData.layer.player)
+		layerData.layer.player = panima::Player::Create();
+	m_layerLayoutDirty = true;
+	return static_cast<uint32_t>(m_layers.size() - 1);
+}
+void panima::AnimationManager::RemoveLayer(uint32_t layerIdx)
+{
+	if(layerIdx >= m_layers.size())
+		return;
+	m_layers.erase(m_layers.begin() + layerIdx);
+	m_layerLayoutDirty = true;
+}
+void panima::AnimationManager::ClearLayers()
+{
+	m_layers.clear();
+	m_outputSlice.channelValues.clear();
+	m_outputChannelPaths.clear();
+	m_outputBasePlan.Clear();
+	m_layerBaseAnimation = nullptr;
+	m_layerLayoutDirty = false;
+}
+const panima::AnimationLayer *panima::AnimationManager::GetLayer(uint32_t layerIdx) const
 {
-	// TODO
-	/*if(f == 1.f)
+	if(layerIdx >= m_layers.size())
+		return nullptr;
+	return &m_layers[layerIdx].layer;
+}
+panima::Player *panima::AnimationManager::GetLayerPlayer(uint32_t layerIdx)
+{
+	if(layerIdx >= m_layers.size())
+		return nullptr;
+	return m_layers[layerIdx].layer.player.get();
+}
+void panima::AnimationManager::SetLayerWeight(uint32_t layerIdx, float weight)
+{
+	if(layerIdx >= m_layers.size())
+		return;
+	m_layers[layerIdx].layer.weight = weight;
+}
+void panima::AnimationManager::SetLayerBlendMode(uint32_t layerIdx, AnimationLayer::BlendMode blendMode)
+{
+	if(layerIdx >= m_layers.size())
 		return;
-	auto n = src.channelValues.size();
-	for(auto i=decltype(n){0u};i<n;++i)
-	{
-		//auto &channel = m_channels[i];
-		pragma::AnimationChannel &channel ;// TODO
-		// TODO: How to translate channels?
-		auto &srcVal = src.channelValues[i];
-		auto &dstVal = dst.channelValues[i];
-		// TODO
-		auto interp = channel.GetInterpolationFunction<Vector3>();
-		dstVal = interp(srcVal.GetValue<Vector3>(),dstVal.GetValue<Vector3>(),f);
-	}*/
+	m_layers[layerIdx].layer.blendMode = blendMode;
+	m_layerLayoutDirty = true;
+}
+void panima::AnimationManager::SetLayerMask(uint32_t layerIdx, std::vector<std::string> mask)
+{
+	if(layerIdx >= m_layers.size())
+		return;
+	m_layers[layerIdx].layer.mask = std::move(mask);
+	m_layerLayoutDirty = true;
+}
+void panima::AnimationManager::SetUpdateRateDivisor(uint32_t divisor, uint32_t frameOffset)
+{
+	m_player->SetUpdateRateDivisor(divisor, frameOffset);
+	for(auto &layerData : m_layers)
+		layerData.layer.player->SetUpdateRateDivisor(divisor, frameOffset);
+}
+void panima::AnimationManager::SetChannelMask(const std::vector<std::string> &pathPrefixes)
+{
+	m_player->SetChannelMask(pathPrefixes);
+	for(auto &layerData : m_layers)
+		layerData.layer.player->SetChannelMask(pathPrefixes);
+}
+const panima::Slice &panima::AnimationManager::GetOutputSlice() const
+{
+	if(m_layers.empty())
+		return m_player->GetCurrentSlice();
+	return m_outputSlice;
+}
+void panima::AnimationManager::CopyLayers(const AnimationManager &other)
+{
+	m_layers.clear();
+	m_layers.reserve(other.m_layers.size());
+	for(auto &otherLayerData : other.m_layers) {
+		auto &layerData = m_layers.emplace_back();
+		layerData.layer = otherLayerData.layer;
+		layerData.layer.player = panima::Player::Create(*otherLayerData.layer.player);
+	}
+	m_outputSlice.channelValues.clear();
+	m_outputChannelPaths.clear();
+	m_outputBasePlan.Clear();
+	m_layerBaseAnimation = nullptr;
+	m_layerLayoutDirty = !m_layers.empty();
+}
+bool panima::AnimationManager::IsLayerLayoutDirty() const
+{
+	if(m_layerLayoutDirty || m_player->GetAnimation() != m_layerBaseAnimation)
+		return true;
+	for(auto &layerData : m_layers) {
+		if(layerData.layer.player->GetAnimation() != layerData.animation)
+			return true;
+	}
+	return false;
+}
+void panima::AnimationManager::UpdateLayerLayout()
+{
+	m_layerLayoutDirty = false;
+	auto *baseAnim = m_player->GetAnimation();
+	m_layerBaseAnimation = baseAnim;
+	for(auto &layerData : m_layers)
+		layerData.animation = layerData.layer.player->GetAnimation();
+
+	// The base channels come first, so that their indices match between the player slice and the output slice
+	std::unordered_map<std::string, uint32_t> pathToOutputIndex;
+	std::vector<udm::Type> outputTypes;
+	m_outputChannelPaths.clear();
+	auto addChannels = [this, &pathToOutputIndex, &outputTypes](const panima::Animation &anim) {
+		for(auto &channel : anim.GetChannels()) {
+			auto path = channel->targetPath.ToUri(false);
+			if(pathToOutputIndex.find(path) != pathToOutputIndex.end())
+				continue;
+			pathToOutputIndex[path] = static_cast<uint32_t>(m_outputChannelPaths.size());
+			m_outputChannelPaths.push_back(std::move(path));
+			outputTypes.push_back(channel->GetValueType());
+		}
+	};
+	if(baseAnim)
+		addChannels(*baseAnim);
+	auto numBaseChannels = m_outputChannelPaths.size();
+	for(auto &layerData : m_layers) {
+		if(layerData.animation)
+			addChannels(*layerData.animation);
+	}
+	auto numOutputChannels = outputTypes.size();
+	m_outputSlice.channelValues.resize(numOutputChannels);
+	for(auto i = decltype(numOutputChannels) {0u}; i < numOutputChannels; ++i) {
+		auto &prop = m_outputSlice.channelValues[i];
+		if(!prop || prop->type != outputTypes[i])
+			prop = udm::Property::Create(outputTypes[i]);
+	}
+	m_outputBasePlan.Build(m_player->GetCurrentSlice(), m_outputSlice);
+
+	// Output channels that don't exist in the base animation are initialized by the first override layer that animates them
+	std::vector<bool> initialized(numOutputChannels, false);
+	std::fill(initialized.begin(), initialized.begin() + numBaseChannels, true);
+	std::vector<uint32_t> dstToSrc;
+	std::vector<uint32_t> initDstToSrc;
+	for(auto &layerData : m_layers) {
+		layerData.initPlan.Clear();
+		layerData.blendPlan.Clear();
+		if(!layerData.animation)
+			continue;
+		auto &layer = layerData.layer;
+		auto additive = (layer.blendMode == AnimationLayer::BlendMode::Additive);
+		dstToSrc.assign(numOutputChannels, panima::SliceBlendPlan::INVALID_CHANNEL);
+		initDstToSrc.assign(numOutputChannels, panima::SliceBlendPlan::INVALID_CHANNEL);
+		auto &channels = layerData.animation->GetChannels();
+		for(auto i = decltype(channels.size()) {0u}; i < channels.size(); ++i) {
+			auto path = channels[i]->targetPath.ToUri(false);
+			if(!layer.mask.empty()) {
+				auto it = std::find_if(layer.mask.begin(), layer.mask.end(), [&path](const std::string &prefix) { return path.starts_with(prefix); });
+				if(it == layer.mask.end())
+					continue;
+			}
+			auto outputIdx = pathToOutputIndex[path];
+			dstToSrc[outputIdx] = i;
+			if(!initialized[outputIdx] && !additive) {
+				initDstToSrc[outputIdx] = i;
+				initialized[outputIdx] = true;
+			}
+		}
+		if(additive) {
+			std::vector<uint32_t> pivotTimeIndices;
+			panima::expression::EvaluationContext context;
+			layerData.animation->Evaluate(0.0, layerData.referencePose, pivotTimeIndices, context);
+		}
+		else
+			layerData.referencePose.channelValues.clear();
+		auto &layerSlice = layer.player->GetCurrentSlice();
+		layerData.initPlan.Build(layerSlice, m_outputSlice, &initDstToSrc);
+		layerData.blendPlan.Build(layerSlice, m_outputSlice, &dstToSrc, additive ? &layerData.referencePose : nullptr);
+	}
+}
+void panima::AnimationManager::ComposeLayers()
+{
+	if(IsLayerLayoutDirty())
+		UpdateLayerLayout();
+	m_outputBasePlan.Apply(0.f);
+	for(auto &layerData : m_layers) {
+		if(!layerData.animation)
+			continue;
+		layerData.initPlan.Apply(0.f);
+		auto &layer = layerData.layer;
+		switch(layer.blendMode) {
+		case AnimationLayer::BlendMode::Override:
+			layerData.blendPlan.Apply(1.f - umath::clamp(layer.weight, 0.f, 1.f));
+			break;
+		case AnimationLayer::BlendMode::Additive:
+			layerData.blendPlan.ApplyAdditive(layer.weight);
+			break;
+		}
+	}
+}
+
+void panima::AnimationManager::ApplySliceInterpolation(const panima::Slice &src, panima::Slice &dst, float f)
+{
+	panima::SliceBlendPlan plan;
+	plan.Build(src, dst);
+	plan.Apply(f);
 }
 
 std::ostream &operator<<(std::ostream &out, const panima::AnimationManager &o)
@@ -254,3 +660,32 @@ std::ostream &operator<<(std::ostream &out, const panima::AnimationManager &o)
 	out << "[Player:" << *o << "]";
 	return out;
 }
+
+panima::MemoryUsage panima::AnimationManager::GetMemoryUsage() const
+{
+	MemoryUsage usage {};
+	usage.objectBytes = sizeof(*this) + m_animationSets.capacity() * sizeof(PAnimationSet) + m_channelValueSubmitters.capacity() * sizeof(ChannelValueSubmitter) + m_layers.capacity() * sizeof(LayerData);
+	usage.objectBytes += m_prevAnimSlice.GetMemoryUsage() + m_outputSlice.GetMemoryUsage() + m_fadeBlendPlan.GetMemoryUsage() + m_outputBasePlan.GetMemoryUsage();
+	for(auto &layer : m_layers)
+		usage.objectBytes += layer.referencePose.GetMemoryUsage() + layer.initPlan.GetMemoryUsage() + layer.blendPlan.GetMemoryUsage();
+	if(m_player)
+		usage.objectBytes += sizeof(*m_player) + m_player->GetCurrentSlice().GetMemoryUsage();
+
+	usage.stringBytes = m_outputChannelPaths.capacity() * sizeof(std::string);
+	for(auto &path : m_outputChannelPaths)
+		usage.stringBytes += path.capacity();
+	for(auto &[name, idx] : m_setNameToIndex)
+		usage.stringBytes += name.capacity();
+	// Approximation of the node and bucket overhead of the name index
+	usage.derivedBytes = m_animationNameIndex.size() * (sizeof(decltype(m_animationNameIndex)::value_type) + sizeof(void *) * 2) + m_animationNameIndex.bucket_count() * sizeof(void *);
+	for(auto &[name, setIdx] : m_animationNameIndex)
+		usage.derivedBytes += name.capacity();
+
+	for(auto &set : m_animationSets) {
+		auto setUsage = set->GetMemoryUsage();
+		if(set.use_count() > 1)
+			setUsage.MarkShared();
+		usage += setUsage;
+	}
+	return usage;
+}
@@ -6,66 +6,240 @@ module;
 #include <string>
 #include <memory>
 #include <optional>
+#include <stdexcept>
+#include <future>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
 
 module panima;
 
 import :animation_set;
 import :animation;
 
-static size_t get_anim_hash(const std::string &name) { return std::hash<std::string> {}(name); }
-static size_t get_anim_hash(const std::string_view &name) { return std::hash<std::string_view> {}(name); }
-static size_t get_anim_hash(const panima::Animation &anim) { return get_anim_hash(anim.GetName()); }
 std::shared_ptr<panima::AnimationSet> panima::AnimationSet::Create() { return std::shared_ptr<AnimationSet> {new AnimationSet {}}; }
 panima::AnimationSet::AnimationSet() {}
 void panima::AnimationSet::Clear()
 {
+	// Slots are kept (with a new generation), so that ids of the removed animations remain invalid
+	for(auto id : m_indexToId)
+		FreeSlot(id & ID_INDEX_MASK);
 	m_animations.clear();
+	m_indexToId.clear();
 	m_nameToId.clear();
+	++m_revision;
+	m_nameHistory.clear();
+	std::scoped_lock lock {m_prefetchMutex};
+	m_prefetches.clear();
+}
+void panima::AnimationSet::OnNameChanged(std::string name)
+{
+	++m_revision;
+	if(m_nameHistory.size() >= MAX_NAME_HISTORY)
+		m_nameHistory.pop_front();
+	m_nameHistory.push_back(std::move(name));
+}
+bool panima::AnimationSet::GetChangedNames(uint32_t sinceRevision, std::vector<std::string> &outNames) const
+{
+	auto numChanges = m_revision - sinceRevision;
+	if(numChanges > m_nameHistory.size())
+		return false;
+	outNames.insert(outNames.end(), m_nameHistory.end() - numChanges, m_nameHistory.end());
+	return true;
+}
+void panima::AnimationSet::FreeSlot(uint32_t slot)
+{
+	auto &s = m_slots[slot];
+	s.animationIndex = Slot::UNUSED;
+	++s.generation;
+	m_freeSlots.push_back(slot);
+}
+const panima::AnimationSet::Slot *panima::AnimationSet::FindSlot(AnimationId id) const
+{
+	if(id == INVALID_ANIMATION)
+		return nullptr;
+	auto slot = id & ID_INDEX_MASK;
+	if(slot >= m_slots.size())
+		return nullptr;
+	auto &s = m_slots[slot];
+	if(s.animationIndex == Slot::UNUSED || s.generation != (id >> ID_INDEX_BITS))
+		return nullptr;
+	return &s;
 }
 void panima::AnimationSet::AddAnimation(Animation &anim)
 {
-	auto hash = get_anim_hash(anim);
-	auto it = m_nameToId.find(hash);
-	if(it != m_nameToId.end())
-		RemoveAnimation(anim);
+	RemoveAnimation(anim.GetName());
+	uint32_t slot;
+	if(!m_freeSlots.empty()) {
+		slot = m_freeSlots.front();
+		m_freeSlots.pop_front();
+	}
+	else {
+		// The highest index is reserved, otherwise the id could collide with INVALID_ANIMATION
+		if(m_slots.size() >= ID_INDEX_MASK)
+			throw std::length_error {"Maximum number of animations in animation set exceeded!"};
+		slot = static_cast<uint32_t>(m_slots.size());
+		m_slots.push_back({});
+	}
+	auto &s = m_slots[slot];
+	s.animationIndex = static_cast<uint32_t>(m_animations.size());
+	auto id = GetId(slot, s.generation);
 	m_animations.push_back(anim.shared_from_this());
-	m_nameToId.insert(std::make_pair(hash, m_animations.size() - 1));
+	m_indexToId.push_back(id);
+	m_nameToId[anim.GetName()] = id;
+	OnNameChanged(anim.GetName());
 }
 void panima::AnimationSet::RemoveAnimation(const Animation &anim) { RemoveAnimation(anim.GetName()); }
 
 void panima::AnimationSet::RemoveAnimation(AnimationId id)
 {
-	if(id >= m_animations.size())
+	auto *s = FindSlot(id);
+	if(!s)
 		return;
-	RemoveAnimation(*m_animations[id]);
+	auto animIdx = s->animationIndex;
+	auto &anim = *m_animations[animIdx];
+	std::string name = anim.GetName();
+	auto it = m_nameToId.find(name);
+	if(it != m_nameToId.end() && it->second == id)
+		m_nameToId.erase(it);
+	else {
+		// The animation has been renamed since it was added
+		for(auto itName = m_nameToId.begin(); itName != m_nameToId.end(); ++itName) {
+			if(itName->second != id)
+				continue;
+			name = itName->first;
+			m_nameToId.erase(itName);
+			break;
+		}
+	}
+
+	// Move the last animation into the gap
+	auto lastIdx = static_cast<uint32_t>(m_animations.size() - 1);
+	if(animIdx != lastIdx) {
+		m_animations[animIdx] = std::move(m_animations[lastIdx]);
+		m_indexToId[animIdx] = m_indexToId[lastIdx];
+		m_slots[m_indexToId[animIdx] & ID_INDEX_MASK].animationIndex = animIdx;
+	}
+	m_animations.pop_back();
+	m_indexToId.pop_back();
+	FreeSlot(id & ID_INDEX_MASK);
+	OnNameChanged(std::move(name));
+	// Pending prefetch tasks keep the animation alive, so they can safely be dropped here
+	std::scoped_lock lock {m_prefetchMutex};
+	m_prefetches.erase(id);
 }
 
 void panima::AnimationSet::RemoveAnimation(const std::string_view &animName)
 {
-	auto it = m_nameToId.find(get_anim_hash(animName));
-	if(it == m_nameToId.end())
+	auto id = LookupAnimation(animName);
+	if(!id.has_value())
 		return;
-	auto id = it->second;
-	m_animations.erase(m_animations.begin() + id);
-	m_nameToId.erase(it);
-	for(auto &pair : m_nameToId) {
-		if(id >= pair.second)
-			--pair.second;
+	RemoveAnimation(*id);
+}
+
+uint32_t panima::AnimationSet::PrecompileExpressions(const TaskExecutor &executor)
+{
+	uint32_t numScheduled = 0;
+	for(auto &anim : m_animations)
+		numScheduled += anim->PrecompileExpressions(executor);
+	return numScheduled;
+}
+
+std::shared_future<void> panima::AnimationSet::Prefetch(AnimationId id, const TaskExecutor &executor)
+{
+	auto *s = FindSlot(id);
+	if(!s)
+		return {};
+	auto anim = m_animations[s->animationIndex];
+	std::scoped_lock lock {m_prefetchMutex};
+	auto it = m_prefetches.find(id);
+	if(it != m_prefetches.end())
+		return it->second;
+	auto promise = std::make_shared<std::promise<void>>();
+	std::shared_future<void> future = promise->get_future().share();
+	if(!executor) {
+		anim->Prefetch();
+		promise->set_value();
+		return future;
 	}
+	m_prefetches[id] = future;
+	executor([anim = std::move(anim), promise]() {
+		anim->Prefetch();
+		promise->set_value();
+	});
+	return future;
+}
+
+std::shared_future<void> panima::AnimationSet::GetPendingPrefetch(AnimationId id) const
+{
+	std::scoped_lock lock {m_prefetchMutex};
+	auto it = m_prefetches.find(id);
+	if(it == m_prefetches.end())
+		return {};
+	if(it->second.wait_for(std::chrono::seconds {0}) == std::future_status::ready) {
+		m_prefetches.erase(it);
+		return {};
+	}
+	return it->second;
+}
+
+bool panima::AnimationSet::IsAnimationReady(AnimationId id) const
+{
+	auto *anim = GetAnimation(id);
+	if(!anim)
+		return false;
+	if(GetPendingPrefetch(id).valid())
+		return false;
+	return anim->IsReady();
 }
 
 void panima::AnimationSet::Reserve(uint32_t count)
 {
 	m_animations.reserve(count);
+	m_indexToId.reserve(count);
+	m_slots.reserve(count);
 	m_nameToId.reserve(count);
 }
 uint32_t panima::AnimationSet::GetSize() const { return m_animations.size(); }
 
+static panima::MemoryUsage get_animation_memory_usage(const std::shared_ptr<panima::Animation> &anim)
+{
+	auto usage = anim->GetMemoryUsage();
+	if(anim.use_count() > 1)
+		usage.MarkShared();
+	return usage;
+}
+
+panima::MemoryUsage panima::AnimationSet::GetMemoryUsage() const
+{
+	MemoryUsage usage {};
+	usage.objectBytes = sizeof(*this) + m_animations.capacity() * sizeof(m_animations.front()) + m_indexToId.capacity() * sizeof(AnimationId) + m_slots.capacity() * sizeof(Slot)
+	  + m_freeSlots.size() * sizeof(uint32_t);
+	// Approximation of the node and bucket overhead of the name map
+	usage.derivedBytes = m_nameToId.size() * (sizeof(decltype(m_nameToId)::value_type) + sizeof(void *) * 2) + m_nameToId.bucket_count() * sizeof(void *);
+	for(auto &[name, id] : m_nameToId)
+		usage.stringBytes += name.capacity();
+	for(auto &anim : m_animations)
+		usage += get_animation_memory_usage(anim);
+	return usage;
+}
+
+std::vector<panima::AnimationSet::AnimationMemoryUsage> panima::AnimationSet::GetMemoryBreakdown() const
+{
+	std::vector<AnimationMemoryUsage> breakdown;
+	breakdown.reserve(m_animations.size());
+	for(size_t i = 0; i < m_animations.size(); ++i)
+		breakdown.push_back({m_indexToId[i], get_animation_memory_usage(m_animations[i])});
+	std::sort(breakdown.begin(), breakdown.end(), [](const AnimationMemoryUsage &a, const AnimationMemoryUsage &b) { return a.usage.GetTotal() > b.usage.GetTotal(); });
+	return breakdown;
+}
+
 panima::Animation *panima::AnimationSet::GetAnimation(AnimationId id)
 {
-	if(id >= m_animations.size())
+	auto *s = FindSlot(id);
+	if(!s)
 		return nullptr;
-	return m_animations[id].get();
+	return m_animations[s->animationIndex].get();
 }
 
 panima::Animation *panima::AnimationSet::FindAnimation(const std::string_view &animName)
@@ -78,7 +252,7 @@ panima::Animation *panima::AnimationSet::FindAnimation(const std::string_view &a
 
 std::optional<panima::AnimationId> panima::AnimationSet::LookupAnimation(const std::string_view &animName) const
 {
-	auto it = m_nameToId.find(get_anim_hash(animName));
+	auto it = m_nameToId.find(animName);
 	if(it == m_nameToId.end())
 		return {};
 	return it->second;
@@ -7,6 +7,9 @@ module;
 #include <sharedutils/util_uri.hpp>
 #include <sharedutils/util_string.h>
 #include <exprtk.hpp>
+#include <atomic>
+#include <memory>
+#include <algorithm>
 
 module panima;
 
@@ -36,8 +39,61 @@ panima::Channel &panima::Channel::operator=(Channel &other)
 	m_timeFrame = other.m_timeFrame;
 	m_effectiveTimeFrame = other.m_effectiveTimeFrame;
 	UpdateLookupCache();
+	if(other.HasConstantSpanInfo()) {
+		m_constantSpanEnds = other.m_constantSpanEnds;
+		m_constantSpansRevision = m_revision;
+	}
 	return *this;
 }
+uint32_t panima::Channel::AnimationRevisions::NextChannelLayoutRevision()
+{
+	static std::atomic<uint32_t> revision = 0;
+	return ++revision;
+}
+void panima::Channel::IncrementRevision()
+{
+	++m_revision;
+	for(auto it = m_animationRevisions.begin(); it != m_animationRevisions.end();) {
+		auto revisions = it->lock();
+		if(!revisions) {
+			it = m_animationRevisions.erase(it);
+			continue;
+		}
+		revisions->revision.fetch_add(1, std::memory_order_relaxed);
+		++it;
+	}
+}
+void panima::Channel::SetTargetPath(const ChannelPath &path)
+{
+	auto changed = (path.GetId() != targetPath.GetId());
+	targetPath = path;
+	if(!changed)
+		return;
+	// Invalidates the channel index of every animation the channel belongs to
+	for(auto it = m_animationRevisions.begin(); it != m_animationRevisions.end();) {
+		auto revisions = it->lock();
+		if(!revisions) {
+			it = m_animationRevisions.erase(it);
+			continue;
+		}
+		revisions->channelLayoutRevision.store(AnimationRevisions::NextChannelLayoutRevision(), std::memory_order_relaxed);
+		revisions->revision.fetch_add(1, std::memory_order_relaxed);
+		++it;
+	}
+}
+void panima::Channel::AddAnimationRevisions(const std::shared_ptr<AnimationRevisions> &revisions)
+{
+	auto it = std::find_if(m_animationRevisions.begin(), m_animationRevisions.end(), [&revisions](const std::weak_ptr<AnimationRevisions> &other) { return other.lock() == revisions; });
+	if(it == m_animationRevisions.end())
+		m_animationRevisions.push_back(revisions);
+}
+void panima::Channel::RemoveAnimationRevisions(const std::shared_ptr<AnimationRevisions> &revisions)
+{
+	std::erase_if(m_animationRevisions, [&revisions](const std::weak_ptr<AnimationRevisions> &other) {
+		auto ptr = other.lock();
+		return !ptr || ptr == revisions;
+	});
+}
 bool panima::Channel::Save(udm::LinkedPropertyWrapper &prop) const
 {
 	prop["interpolation"] = interpolation;
@@ -47,6 +103,7 @@ bool panima::Channel::Save(udm::LinkedPropertyWrapper &prop) const
 
 	prop["times"] = m_times;
 	prop["values"] = m_values;
+	UpdateCompressedSizes();
 	return true;
 }
 bool panima::Channel::Load(udm::LinkedPropertyWrapper &prop)
@@ -54,7 +111,7 @@ bool panima::Channel::Load(udm::LinkedPropertyWrapper &prop)
 	prop["interpolation"](interpolation);
 	std::string targetPath;
 	prop["targetPath"](targetPath);
-	this->targetPath = std::move(targetPath);
+	SetTargetPath(std::move(targetPath));
 
 	auto *el = prop.GetValuePtr<udm::Element>();
 	if(!el)
@@ -68,15 +125,19 @@ bool panima::Channel::Load(udm::LinkedPropertyWrapper &prop)
 	UpdateLookupCache();
 
 	// Note: Expression has to be loaded *after* the values, because
-	// it's dependent on the value type
+	// it's dependent on the value type.
+	// Compilation is deferred until the expression is used for the first time
+	// (or precompiled via CompileValueExpression), so compilation errors can't be reported here.
+	// They are passed to the compile error handler instead (see expression::set_compile_error_handler)
+	// and are available through GetValueExpressionError.
 	auto udmExpression = prop["expression"];
 	if(udmExpression) {
 		std::string expr;
 		udmExpression(expr);
 		std::string err;
-		if(SetValueExpression(expr, err) == false)
-			; // TODO: Print warning?
+		SetValueExpression(expr, err, true);
 	}
+	UpdateConstantSpans();
 	return true;
 }
 
@@ -7,6 +7,7 @@ module;
 #include <sharedutils/util_uri.hpp>
 #include <sharedutils/util_string.h>
 #include <exprtk.hpp>
+#include <cmath>
 
 module panima;
 
@@ -61,6 +62,122 @@ void panima::Channel::MergeValues(const Channel &other)
 		});
 	});
 }
+static uint32_t get_key_count(const std::vector<panima::Channel::KeyRange> &ranges)
+{
+	uint32_t n = 0;
+	for(auto &range : ranges)
+		n += range.count;
+	return n;
+}
+static void copy_key_ranges(udm::Array &times, udm::Array &values, const std::vector<panima::Channel::KeyRange> &ranges, uint32_t offset)
+{
+	auto valueSize = values.GetValueSize();
+	for(auto &range : ranges) {
+		if(range.count == 0)
+			continue;
+		assert(range.channel->GetValueType() == values.GetValueType());
+		memcpy(times.GetValuePtr(offset), const_cast<udm::Array &>(range.channel->GetTimesArray()).GetValuePtr(range.first), range.count * sizeof(float));
+		memcpy(values.GetValuePtr(offset), const_cast<udm::Array &>(range.channel->GetValueArray()).GetValuePtr(range.first), range.count * valueSize);
+		offset += range.count;
+	}
+}
+void panima::Channel::AssignKeys(const std::vector<KeyRange> &ranges)
+{
+	auto n = get_key_count(ranges);
+	auto &times = GetTimesArray();
+	auto &values = GetValueArray();
+	times.Resize(n);
+	values.Resize(n);
+	UpdateLookupCache();
+	copy_key_ranges(times, values, ranges, 0);
+	// The data has been written after the lookup cache update
+	IncrementRevision();
+}
+void panima::Channel::SpliceKeys(uint32_t keepFirst, uint32_t keepCount, const std::vector<KeyRange> &prepend, const std::vector<KeyRange> &append)
+{
+	auto numCur = GetTimeCount();
+	assert(keepFirst + keepCount <= numCur);
+	auto numPrepend = get_key_count(prepend);
+	auto n = numPrepend + keepCount + get_key_count(append);
+	auto &times = GetTimesArray();
+	auto &values = GetValueArray();
+	auto resize = [this, &times, &values](uint32_t size) {
+		times.Resize(size);
+		values.Resize(size);
+		UpdateLookupCache();
+	};
+	// The arrays are grown before the kept keys are moved up, and shrunk after they have been moved down
+	if(n > numCur)
+		resize(n);
+	if(keepCount > 0 && numPrepend != keepFirst) {
+		memmove(times.GetValuePtr(numPrepend), times.GetValuePtr(keepFirst), keepCount * sizeof(float));
+		memmove(values.GetValuePtr(numPrepend), values.GetValuePtr(keepFirst), keepCount * values.GetValueSize());
+	}
+	if(n < numCur)
+		resize(n);
+	copy_key_ranges(times, values, prepend, 0);
+	copy_key_ranges(times, values, append, numPrepend + keepCount);
+	IncrementRevision();
+}
+bool panima::Channel::ValidateKeys(uint32_t n, const float *times, udm::Type valueType, std::string *optOutErr)
+{
+	auto fail = [optOutErr](std::string err) {
+		if(optOutErr)
+			*optOutErr = std::move(err);
+		return false;
+	};
+	if(valueType == udm::Type::Invalid || !is_animatable_type(valueType))
+		return fail("Value type is not animatable!");
+	for(uint32_t i = 0; i < n; ++i) {
+		if(!std::isfinite(times[i]))
+			return fail("Time of key " + std::to_string(i) + " is not finite!");
+		if(i > 0 && times[i] <= times[i - 1])
+			return fail("Time of key " + std::to_string(i) + " (" + std::to_string(times[i]) + ") is not greater than the time of the previous key (" + std::to_string(times[i - 1]) + ")!");
+	}
+	return true;
+}
+bool panima::Channel::ValidateKeys(std::string *optOutErr) const
+{
+	auto n = GetTimeCount();
+	if(GetValueCount() != n) {
+		if(optOutErr)
+			*optOutErr = "Number of times (" + std::to_string(n) + ") does not match number of values (" + std::to_string(GetValueCount()) + ")!";
+		return false;
+	}
+	return ValidateKeys(n, m_timesData, GetValueType(), optOutErr);
+}
+bool panima::Channel::SetKeys(uint32_t n, const float *times, const void *values, udm::Type valueType, std::string *optOutErr)
+{
+	if(!ValidateKeys(n, times, valueType, optOutErr))
+		return false;
+	auto &timesArray = GetTimesArray();
+	auto &valueArray = GetValueArray();
+	valueArray.SetValueType(valueType);
+	timesArray.Resize(n);
+	valueArray.Resize(n);
+	UpdateLookupCache();
+	if(n > 0) {
+		memcpy(timesArray.GetValuePtr(0), times, n * sizeof(float));
+		memcpy(valueArray.GetValuePtr(0), values, n * valueArray.GetValueSize());
+	}
+	// The data has been written after the lookup cache update
+	IncrementRevision();
+	return true;
+}
+std::shared_ptr<panima::Channel> panima::Channel::Create(const udm::PProperty &times, const udm::PProperty &values, std::string *optOutErr)
+{
+	auto *timesArray = times ? times->GetValuePtr<udm::Array>() : nullptr;
+	auto *valueArray = values ? values->GetValuePtr<udm::Array>() : nullptr;
+	if(!timesArray || !valueArray || timesArray->GetValueType() != udm::Type::Float) {
+		if(optOutErr)
+			*optOutErr = "Times have to be a float array and values have to be an array!";
+		return nullptr;
+	}
+	auto channel = std::make_shared<Channel>(times, values);
+	if(!channel->ValidateKeys(optOutErr))
+		return nullptr;
+	return channel;
+}
 void panima::Channel::ClearAnimationData()
 {
 	GetTimesArray().Resize(0);
@@ -106,6 +223,56 @@ bool panima::Channel::ClearRange(float startTime, float endTime, bool addCaps)
 	return true;
 }
 void panima::Channel::ClearValueExpression() { m_valueExpression = nullptr; }
+bool panima::Channel::BakeValueExpression(float sampleRate, float maxError, std::string *optOutErr)
+{
+	if(!m_valueExpression || sampleRate <= 0.f || m_timeFrame.scale == 0.f)
+		return false;
+	// An expression that fails to compile isn't applied, so baking it would silently replace it with the raw keys
+	if(!CompileValueExpression(optOutErr))
+		return false;
+	Update();
+	// Range in channel-local time
+	auto tStart = GetMinTime();
+	auto tEnd = GetMaxTime();
+	if(m_timeFrame.duration >= 0.f)
+		tEnd = umath::max(tEnd, m_timeFrame.duration * m_timeFrame.scale);
+	if(tEnd < tStart)
+		return false;
+	auto numSamples = static_cast<uint32_t>(std::ceil((tEnd - tStart) * sampleRate)) + 1;
+	auto sampleInterval = 1.f / sampleRate;
+	return udm::visit_ng(GetValueType(), [this, tStart, tEnd, numSamples, sampleInterval, maxError](auto tag) {
+		using T = typename decltype(tag)::type;
+		using TValue = std::conditional_t<std::is_same_v<T, bool>, uint8_t, T>;
+		if constexpr(is_supported_expression_type_v<T> && is_animatable_type(udm::type_to_enum<T>())) {
+			// All samples have to be evaluated before the animation data is touched, since
+			// the expression may reference the current keys via value_at
+			std::vector<float> times;
+			std::vector<TValue> values;
+			times.reserve(numSamples);
+			values.reserve(numSamples);
+			uint32_t pivotTimeIndex = 0;
+			for(auto i = decltype(numSamples) {0u}; i < numSamples; ++i) {
+				auto tLocal = (i == numSamples - 1) ? tEnd : umath::min(tStart + i * sampleInterval, tEnd);
+				if(!times.empty() && tLocal - times.back() < TIME_EPSILON)
+					continue;
+				// The expression operates on the time before the time frame has been applied
+				auto t = tLocal / m_timeFrame.scale + m_timeFrame.startOffset;
+				auto value = GetInterpolatedValue<T>(t, pivotTimeIndex);
+				ApplyValueExpression<T>(t, pivotTimeIndex, value);
+				times.push_back(tLocal);
+				values.push_back(static_cast<TValue>(value));
+			}
+
+			ClearValueExpression();
+			ClearAnimationData();
+			InsertValues<TValue>(times.size(), times.data(), values.data(), 0.f, InsertFlags::ClearExistingDataInRange);
+			if(maxError > 0.f)
+				Decimate(maxError);
+			return true;
+		}
+		return false;
+	});
+}
 bool panima::Channel::TestValueExpression(std::string expression, std::string &outErr)
 {
 	m_valueExpression = nullptr;
@@ -116,17 +283,32 @@ bool panima::Channel::TestValueExpression(std::string expression, std::string &o
 		return false;
 	return true;
 }
-bool panima::Channel::SetValueExpression(std::string expression, std::string &outErr)
+bool panima::Channel::SetValueExpression(std::string expression, std::string &outErr, bool deferCompilation)
 {
 	m_valueExpression = nullptr;
 
 	auto expr = std::make_unique<expression::ValueExpression>(*this);
 	expr->expression = std::move(expression);
-	if(!expr->Initialize(GetValueType(), outErr))
+	if(deferCompilation)
+		expr->InitializeDeferred(GetValueType());
+	else if(!expr->Initialize(GetValueType(), outErr))
 		return false;
 	m_valueExpression = std::move(expr);
 	return true;
 }
+bool panima::Channel::CompileValueExpression(std::string *optOutErr)
+{
+	if(!m_valueExpression)
+		return false;
+	return m_valueExpression->Compile(optOutErr);
+}
+bool panima::Channel::HasPendingValueExpression() const { return m_valueExpression && m_valueExpression->GetCompileState() == expression::ValueExpression::CompileState::Pending; }
+const std::string *panima::Channel::GetValueExpressionError() const
+{
+	if(!m_valueExpression || m_valueExpression->GetCompileState() != expression::ValueExpression::CompileState::Failed)
+		return nullptr;
+	return &m_valueExpression->GetCompileError();
+}
 const std::string *panima::Channel::GetValueExpression() const
 {
 	if(m_valueExpression)
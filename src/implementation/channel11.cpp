@@ -14,6 +14,7 @@ import bezierfit;
 
 import :channel;
 import :expression;
+import :trace;
 uint32_t panima::Channel::GetSize() const { return GetTimesArray().GetSize(); }
 void panima::Channel::Resize(uint32_t numValues)
 {
@@ -29,6 +30,7 @@ void panima::Channel::Update()
 }
 size_t panima::Channel::Optimize()
 {
+	trace::Zone zone {"panima::Channel::Optimize"};
 	auto numTimes = GetTimeCount();
 	constexpr auto EPSILON = 0.001f;
 	size_t numRemoved = 0;
@@ -82,13 +84,15 @@ size_t panima::Channel::Optimize()
 		});
 	}
 
+	UpdateConstantSpans();
 	return numRemoved;
 }
 template<typename T>
 bool panima::Channel::DoApplyValueExpression(double time, uint32_t timeIndex, T &inOutVal) const
 {
-	if(!m_valueExpression)
+	if(!m_valueExpression || !m_valueExpression->Compile())
 		return false;
+	CountSamplingEvent(SamplingCounter::ExpressionEvaluations);
 	m_valueExpression->Apply<T>(time, timeIndex, m_effectiveTimeFrame, inOutVal);
 	return true;
 }
@@ -113,6 +117,35 @@ template bool panima::Channel::DoApplyValueExpression(double, uint32_t, udm::Mat
 template bool panima::Channel::DoApplyValueExpression(double, uint32_t, udm::Vector2i &) const;
 template bool panima::Channel::DoApplyValueExpression(double, uint32_t, udm::Vector3i &) const;
 template bool panima::Channel::DoApplyValueExpression(double, uint32_t, udm::Vector4i &) const;
+template<typename T>
+bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &context, double time, uint32_t timeIndex, T &inOutVal) const
+{
+	if(!m_valueExpression || !m_valueExpression->Compile())
+		return false;
+	CountSamplingEvent(SamplingCounter::ExpressionEvaluations);
+	return m_valueExpression->Apply<T>(context, time, timeIndex, m_effectiveTimeFrame, inOutVal);
+}
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Int8 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::UInt8 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Int16 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::UInt16 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Int32 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::UInt32 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Int64 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::UInt64 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Float &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Double &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Boolean &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Vector2 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Vector3 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Vector4 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Quaternion &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::EulerAngles &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Mat4 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Mat3x4 &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Vector2i &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Vector3i &) const;
+template bool panima::Channel::DoApplyValueExpression(expression::EvaluationContext &, double, uint32_t, udm::Vector4i &) const;
 
 float panima::Channel::GetMinTime() const
 {
@@ -15,7 +15,14 @@ import bezierfit;
 import :channel;
 import :expression;
 
+panima::ChannelPath::ChannelPath() { UpdateId(); }
 panima::ChannelPath::ChannelPath(const std::string &ppath)
+{
+	Parse(ppath);
+	UpdateId();
+}
+panima::ChannelPath::ChannelPath(const std::string &ppath, NoIntern) { Parse(ppath); }
+void panima::ChannelPath::Parse(const std::string &ppath)
 {
 	auto pathWithoutScheme = ppath;
 	auto colon = pathWithoutScheme.find(':');
@@ -59,8 +66,10 @@ panima::ChannelPath &panima::ChannelPath::operator=(const ChannelPath &other)
 	m_components = nullptr;
 	if(other.m_components)
 		m_components = std::make_unique<std::vector<std::string>>(*other.m_components);
+	m_id = other.m_id;
 	return *this;
 }
+void panima::ChannelPath::UpdateId() { m_id = ChannelPathRegistry::Get().Intern(*this); }
 std::string panima::ChannelPath::ToUri(bool includeScheme) const
 {
 	std::string uri;
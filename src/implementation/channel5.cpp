@@ -50,8 +50,10 @@ std::pair<uint32_t, uint32_t> panima::Channel::FindInterpolationIndices(float t,
 {
 	constexpr uint32_t MAX_RECURSION_DEPTH = 2;
 	auto &times = GetTimesArray();
-	if(pivotIndex >= times.GetSize() || times.GetSize() < 2 || recursionDepth == MAX_RECURSION_DEPTH)
+	if(pivotIndex >= times.GetSize() || times.GetSize() < 2 || recursionDepth == MAX_RECURSION_DEPTH) {
+		CountSamplingEvent(SamplingCounter::PivotMisses);
 		return FindInterpolationIndices(t, interpFactor);
+	}
 	// We'll use the pivot index as the starting point of our search and check out the times immediately surrounding it.
 	// If we have a match, we can return immediately. If not, we'll slightly broaden the search until we've reached the max recursion depth or found a match.
 	// If we hit the max recusion depth, we'll just do a regular binary search instead.
@@ -60,18 +62,21 @@ std::pair<uint32_t, uint32_t> panima::Channel::FindInterpolationIndices(float t,
 	TimeToLocalTimeFrame(tLocal);
 	if(tLocal >= tPivot) {
 		if(pivotIndex == times.GetSize() - 1) {
+			CountSamplingEvent(SamplingCounter::PivotHits);
 			interpFactor = 0.f;
 			return {static_cast<uint32_t>(GetValueArray().GetSize() - 1), static_cast<uint32_t>(GetValueArray().GetSize() - 1)};
 		}
 		auto tPivotNext = times.GetValue<float>(pivotIndex + 1);
 		if(tLocal < tPivotNext) {
 			// Most common case
+			CountSamplingEvent(SamplingCounter::PivotHits);
 			interpFactor = (tLocal - tPivot) / (tPivotNext - tPivot);
 			return {pivotIndex, pivotIndex + 1};
 		}
 		return FindInterpolationIndices(t, interpFactor, pivotIndex + 1, recursionDepth + 1);
 	}
 	if(pivotIndex == 0) {
+		CountSamplingEvent(SamplingCounter::PivotHits);
 		interpFactor = 0.f;
 		return {0u, 0u};
 	}
@@ -88,6 +93,7 @@ std::pair<uint32_t, uint32_t> panima::Channel::FindInterpolationIndices(float t,
 		return {std::numeric_limits<uint32_t>::max(), std::numeric_limits<uint32_t>::max()};
 	}
 	// Binary search
+	CountSamplingEvent(SamplingCounter::BinarySearches);
 	TimeToLocalTimeFrame(t);
 	auto it = std::upper_bound(begin(times), end(times), t);
 	if(it == end(times)) {
@@ -14,9 +14,11 @@ import bezierfit;
 
 import :channel;
 import :expression;
+import :trace;
 
 uint32_t panima::Channel::InsertValues(uint32_t n, const float *times, const void *values, size_t valueStride, float offset, InsertFlags flags)
 {
+	trace::Zone zone {"panima::Channel::InsertValues"};
 	if(n == 0)
 		return std::numeric_limits<uint32_t>::max();
 	if(offset != 0.f) {
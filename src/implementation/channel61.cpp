@@ -32,6 +32,7 @@ uint32_t panima::Channel::AddValue(float t, const void *value)
 		auto idx = indices.first;
 		GetTimesArray()[idx] = t;
 		GetValueArray()[idx] = value;
+		IncrementRevision();
 		return idx;
 	}
 	if(umath::abs(t - *GetTime(indices.second)) < VALUE_EPSILON) {
@@ -39,6 +40,7 @@ uint32_t panima::Channel::AddValue(float t, const void *value)
 		auto idx = indices.second;
 		GetTimesArray()[idx] = t;
 		GetValueArray()[idx] = value;
+		IncrementRevision();
 		return idx;
 	}
 	auto &times = GetTimesArray();
@@ -14,16 +14,49 @@ import bezierfit;
 
 import :channel;
 import :expression;
+import :trace;
 
 void panima::Channel::UpdateLookupCache()
 {
+	// The array layout has changed, which invalidates any data derived from it
+	IncrementRevision();
+	CountSamplingEvent(SamplingCounter::LookupCacheUpdates);
 	m_timesArray = m_times->GetValuePtr<udm::Array>();
 	m_valueArray = m_values->GetValuePtr<udm::Array>();
-	m_timesData = !m_timesArray->IsEmpty() ? m_timesArray->GetValuePtr<float>(0) : nullptr;
-	m_valueData = !m_valueArray->IsEmpty() ? m_valueArray->GetValuePtr(0) : nullptr;
+	// Accessing the data of a compressed array below decompresses it, unless the uncompressed buffer already exists.
+	// The uncompressed memory is made persistent after the first access (see below), so a persistent array has already
+	// been decompressed and is not counted again.
+	auto requiresDecompression = [](const udm::Array &a) {
+		return a.GetArrayType() == udm::ArrayType::Compressed && !a.IsEmpty() && !static_cast<const udm::ArrayLz4 &>(a).IsUncompressedMemoryPersistent();
+	};
+	auto timesCompressed = requiresDecompression(*m_timesArray);
+	auto valuesCompressed = requiresDecompression(*m_valueArray);
+	if(timesCompressed)
+		CountSamplingEvent(SamplingCounter::Decompressions);
+	if(valuesCompressed)
+		CountSamplingEvent(SamplingCounter::Decompressions);
+	auto resolveData = [this]() {
+		m_timesData = !m_timesArray->IsEmpty() ? m_timesArray->GetValuePtr<float>(0) : nullptr;
+		m_valueData = !m_valueArray->IsEmpty() ? m_valueArray->GetValuePtr(0) : nullptr;
+	};
+	if(timesCompressed || valuesCompressed) {
+		trace::Zone zone {"panima::Channel::Decompress"};
+		resolveData();
+	}
+	else
+		resolveData();
 
 	if(m_timesArray->GetArrayType() == udm::ArrayType::Compressed)
 		static_cast<udm::ArrayLz4 *>(m_timesArray)->SetUncompressedMemoryPersistent(true);
 	if(m_valueArray->GetArrayType() == udm::ArrayType::Compressed)
 		static_cast<udm::ArrayLz4 *>(m_valueArray)->SetUncompressedMemoryPersistent(true);
 }
+
+void panima::Channel::Prefetch()
+{
+	// The key arrays have already been decompressed by UpdateLookupCache
+	if(HasPendingValueExpression())
+		CompileValueExpression();
+	if(!HasConstantSpanInfo())
+		UpdateConstantSpans();
+}
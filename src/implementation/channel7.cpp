@@ -14,6 +14,7 @@ import bezierfit;
 
 import :channel;
 import :expression;
+import :trace;
 #pragma clang optimize off
 void panima::Channel::ScaleTimeInRange(float tStart, float tEnd, float tPivot, double scale, bool retainBoundaryValues)
 {
@@ -85,9 +86,11 @@ void panima::Channel::ScaleTimeInRange(float tStart, float tEnd, float tPivot, d
 		ResolveDuplicates(tStart);
 		ResolveDuplicates(tEnd);
 	}
+	IncrementRevision();
 }
 void panima::Channel::Decimate(float tStart, float tEnd, float error)
 {
+	trace::Zone zone {"panima::Channel::Decimate"};
 	return udm::visit_ng(GetValueType(), [this, tStart, tEnd, error](auto tag) {
 		using T = typename decltype(tag)::type;
 		using TValue = std::conditional_t<std::is_same_v<T, bool>, uint8_t, T>;
@@ -104,4 +104,5 @@ void panima::Channel::ShiftTimeInRange(float tStart, float tEnd, float shiftAmou
 		ResolveDuplicates(tStart);
 		ResolveDuplicates(tEnd);
 	}
+	IncrementRevision();
 }
\ No newline at end of file
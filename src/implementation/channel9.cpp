@@ -165,6 +165,7 @@ void panima::Channel::TransformGlobal(const umath::ScaledTransform &transform)
 	default:
 		break;
 	}
+	IncrementRevision();
 }
 void panima::Channel::RemoveValueAtIndex(uint32_t idx)
 {
@@ -0,0 +1,163 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <udm.hpp>
+#include <memory>
+#include <algorithm>
+
+module panima;
+
+import :channel;
+
+std::shared_ptr<const panima::ChannelAggregates> panima::Channel::GetAggregates() const
+{
+	auto aggregates = std::atomic_load(&m_aggregates);
+	if(aggregates && aggregates->revision == m_revision)
+		return aggregates;
+	// Multiple threads may end up building the structures at the same time, in which case the last one wins.
+	// This only happens on the first query after a change, so it's not worth synchronizing.
+	auto newAggregates = std::make_shared<ChannelAggregates>();
+	newAggregates->revision = m_revision;
+	auto n = GetTimeCount();
+	auto &times = GetTimesArray();
+	udm::visit_ng(GetValueType(), [this, n, &times, &newAggregates](auto tag) {
+		using T = typename decltype(tag)::type;
+		using TValue = std::conditional_t<std::is_same_v<T, bool>, uint8_t, T>;
+		if constexpr(is_animatable_type(udm::type_to_enum<TValue>())) {
+			auto numComp = udm::get_numeric_component_count(udm::type_to_enum<TValue>());
+			newAggregates->components.resize(numComp);
+			for(auto c = decltype(numComp) {0u}; c < numComp; ++c) {
+				auto &comp = newAggregates->components[c];
+				comp.prefixIntegrals.resize(n);
+				comp.minTree.resize(n * 2);
+				comp.maxTree.resize(n * 2);
+				double integral = 0.0;
+				float tPrev = 0.f;
+				float vPrev = 0.f;
+				for(auto i = decltype(n) {0u}; i < n; ++i) {
+					auto t = times.GetValue<float>(i);
+					auto v = static_cast<float>(udm::get_numeric_component(GetValue<TValue>(i), c));
+					if(i > 0)
+						integral += (t - tPrev) * (static_cast<double>(v) + vPrev) * 0.5;
+					comp.prefixIntegrals[i] = integral;
+					comp.minTree[n + i] = v;
+					comp.maxTree[n + i] = v;
+					tPrev = t;
+					vPrev = v;
+				}
+				for(auto i = static_cast<int64_t>(n) - 1; i > 0; --i) {
+					comp.minTree[i] = umath::min(comp.minTree[i * 2], comp.minTree[i * 2 + 1]);
+					comp.maxTree[i] = umath::max(comp.maxTree[i * 2], comp.maxTree[i * 2 + 1]);
+				}
+			}
+		}
+	});
+	aggregates = newAggregates;
+	std::atomic_store(&m_aggregates, aggregates);
+	return aggregates;
+}
+
+// Returns the integral of the component from the first key to t (in channel-local time)
+double panima::Channel::GetPrefixIntegral(const ChannelAggregates::Component &component, float t) const
+{
+	auto &times = GetTimesArray();
+	auto n = times.GetSize();
+	auto *values = component.minTree.data() + n;
+	auto tFirst = times.GetValue<float>(0);
+	if(t <= tFirst)
+		return (t - tFirst) * static_cast<double>(values[0]);
+	auto tLast = times.GetValue<float>(n - 1);
+	if(t >= tLast)
+		return component.prefixIntegrals[n - 1] + (t - tLast) * static_cast<double>(values[n - 1]);
+	auto idx1 = static_cast<uint32_t>(std::upper_bound(begin(times), end(times), t) - begin(times));
+	auto idx0 = idx1 - 1;
+	auto t0 = times.GetValue<float>(idx0);
+	auto t1 = times.GetValue<float>(idx1);
+	auto dt = t - t0;
+	auto v = umath::lerp(values[idx0], values[idx1], dt / (t1 - t0));
+	return component.prefixIntegrals[idx0] + dt * (static_cast<double>(values[idx0]) + v) * 0.5;
+}
+
+std::optional<double> panima::Channel::GetIntegral(float tStart, float tEnd, uint32_t component) const
+{
+	if(GetTimeCount() == 0)
+		return {};
+	auto aggregates = GetAggregates();
+	if(component >= aggregates->components.size())
+		return {};
+	auto &comp = aggregates->components[component];
+	TimeToLocalTimeFrame(tStart);
+	TimeToLocalTimeFrame(tEnd);
+	auto integral = GetPrefixIntegral(comp, tEnd) - GetPrefixIntegral(comp, tStart);
+	// Convert back from channel-local time
+	if(m_timeFrame.scale != 0.f)
+		integral /= m_timeFrame.scale;
+	return integral;
+}
+
+std::optional<double> panima::Channel::GetAverage(float tStart, float tEnd, uint32_t component) const
+{
+	if(GetTimeCount() == 0)
+		return {};
+	auto aggregates = GetAggregates();
+	if(component >= aggregates->components.size())
+		return {};
+	auto &comp = aggregates->components[component];
+	TimeToLocalTimeFrame(tStart);
+	TimeToLocalTimeFrame(tEnd);
+	if(umath::abs(tEnd - tStart) < TIME_EPSILON) {
+		// Empty window, average is the value at the given time
+		return (GetPrefixIntegral(comp, tStart + TIME_EPSILON) - GetPrefixIntegral(comp, tStart)) / TIME_EPSILON;
+	}
+	return (GetPrefixIntegral(comp, tEnd) - GetPrefixIntegral(comp, tStart)) / (tEnd - tStart);
+}
+
+std::optional<float> panima::Channel::GetWindowExtremum(float tStart, float tEnd, uint32_t component, bool max) const
+{
+	auto n = GetTimeCount();
+	if(n == 0)
+		return {};
+	auto aggregates = GetAggregates();
+	if(component >= aggregates->components.size())
+		return {};
+	auto &comp = aggregates->components[component];
+	auto &tree = max ? comp.maxTree : comp.minTree;
+	auto *values = tree.data() + n;
+	auto &times = GetTimesArray();
+	TimeToLocalTimeFrame(tStart);
+	TimeToLocalTimeFrame(tEnd);
+	if(tEnd < tStart)
+		std::swap(tStart, tEnd);
+	auto select = [max](float a, float b) { return max ? umath::max(a, b) : umath::min(a, b); };
+	auto getValue = [&times, values, n](float t) {
+		auto it = std::upper_bound(begin(times), end(times), t);
+		if(it == begin(times))
+			return values[0];
+		if(it == end(times))
+			return values[n - 1];
+		auto idx1 = static_cast<uint32_t>(it - begin(times));
+		auto idx0 = idx1 - 1;
+		auto t0 = times.GetValue<float>(idx0);
+		auto t1 = times.GetValue<float>(idx1);
+		return umath::lerp(values[idx0], values[idx1], (t - t0) / (t1 - t0));
+	};
+	// The extremum of a piecewise linear function is either at one of the window boundaries,
+	// or at one of the keys within the window
+	auto result = select(getValue(tStart), getValue(tEnd));
+	auto l = static_cast<uint32_t>(std::upper_bound(begin(times), end(times), tStart) - begin(times)) + n;
+	auto r = static_cast<uint32_t>(std::lower_bound(begin(times), end(times), tEnd) - begin(times)) + n;
+	while(l < r) {
+		if(l & 1)
+			result = select(result, tree[l++]);
+		if(r & 1)
+			result = select(result, tree[--r]);
+		l >>= 1;
+		r >>= 1;
+	}
+	return result;
+}
+
+std::optional<float> panima::Channel::GetMinimum(float tStart, float tEnd, uint32_t component) const { return GetWindowExtremum(tStart, tEnd, component, false); }
+std::optional<float> panima::Channel::GetMaximum(float tStart, float tEnd, uint32_t component) const { return GetWindowExtremum(tStart, tEnd, component, true); }
@@ -0,0 +1,162 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <udm.hpp>
+#include <cstring>
+#include <algorithm>
+
+module panima;
+
+import :channel_binding;
+import :animation_binding;
+import :types;
+
+namespace panima {
+	template<size_t TSize>
+	static void copy_values(const Slice &slice, const std::vector<uint32_t> &channels, const std::vector<uint8_t *> &destinations, udm::Type type, const AnimationBinding *optBinding)
+	{
+		auto &values = slice.channelValues;
+		for(size_t i = 0; i < channels.size(); ++i) {
+			// Slots without a channel resolve to AnimationBinding::INVALID_INDEX
+			auto idx = optBinding ? optBinding->GetChannel(channels[i]) : channels[i];
+			if(idx >= values.size())
+				continue;
+			auto &prop = values[idx];
+			if(!prop || prop->type != type)
+				continue;
+			std::memcpy(destinations[i], prop->value, TSize);
+		}
+	}
+	static void copy_values(const Slice &slice, const std::vector<uint32_t> &channels, const std::vector<uint8_t *> &destinations, udm::Type type, uint32_t size, const AnimationBinding *optBinding)
+	{
+		auto &values = slice.channelValues;
+		for(size_t i = 0; i < channels.size(); ++i) {
+			auto idx = optBinding ? optBinding->GetChannel(channels[i]) : channels[i];
+			if(idx >= values.size())
+				continue;
+			auto &prop = values[idx];
+			if(!prop || prop->type != type)
+				continue;
+			std::memcpy(destinations[i], prop->value, size);
+		}
+	}
+};
+
+panima::ChannelBindingTable::Group &panima::ChannelBindingTable::GetGroup(udm::Type type, uint32_t &outGroupIndex)
+{
+	auto it = std::find_if(m_groups.begin(), m_groups.end(), [type](const Group &group) { return group.type == type; });
+	if(it != m_groups.end()) {
+		outGroupIndex = static_cast<uint32_t>(it - m_groups.begin());
+		return *it;
+	}
+	outGroupIndex = static_cast<uint32_t>(m_groups.size());
+	auto &group = m_groups.emplace_back();
+	group.type = type;
+	group.size = static_cast<uint32_t>(udm::size_of_base_type(type));
+	return group;
+}
+
+bool panima::ChannelBindingTable::Bind(uint32_t channelIndex, void *destination, udm::Type type)
+{
+	if(!destination || !is_animatable_type(type) || channelIndex == INVALID_INDEX)
+		return false;
+	Unbind(channelIndex);
+	uint32_t groupIdx;
+	auto &group = GetGroup(type, groupIdx);
+	if(channelIndex >= m_locations.size())
+		m_locations.resize(channelIndex + 1);
+	m_locations[channelIndex] = {groupIdx, static_cast<uint32_t>(group.channels.size())};
+	group.channels.push_back(channelIndex);
+	group.destinations.push_back(static_cast<uint8_t *>(destination));
+	++m_numBindings;
+	return true;
+}
+
+bool panima::ChannelBindingTable::Bind(uint32_t firstChannelIndex, uint32_t count, void *destination, size_t stride, udm::Type type)
+{
+	if(!destination || !is_animatable_type(type))
+		return false;
+	auto *ptr = static_cast<uint8_t *>(destination);
+	for(auto i = decltype(count) {0u}; i < count; ++i) {
+		if(!Bind(firstChannelIndex + i, ptr, type))
+			return false;
+		ptr += stride;
+	}
+	return true;
+}
+
+void panima::ChannelBindingTable::Unbind(uint32_t channelIndex)
+{
+	if(channelIndex >= m_locations.size())
+		return;
+	auto loc = m_locations[channelIndex];
+	if(loc.group == INVALID_INDEX)
+		return;
+	// Swap with the last entry of the group to keep the group contiguous
+	auto &group = m_groups[loc.group];
+	auto last = group.channels.size() - 1;
+	if(loc.entry != last) {
+		group.channels[loc.entry] = group.channels[last];
+		group.destinations[loc.entry] = group.destinations[last];
+		m_locations[group.channels[loc.entry]].entry = loc.entry;
+	}
+	group.channels.pop_back();
+	group.destinations.pop_back();
+	m_locations[channelIndex] = {};
+	--m_numBindings;
+}
+
+bool panima::ChannelBindingTable::IsBound(uint32_t channelIndex) const { return channelIndex < m_locations.size() && m_locations[channelIndex].group != INVALID_INDEX; }
+
+void panima::ChannelBindingTable::Clear()
+{
+	m_groups.clear();
+	m_locations.clear();
+	m_numBindings = 0;
+}
+
+void panima::ChannelBindingTable::Apply(const Slice &slice, const AnimationBinding *optBinding) const
+{
+	for(auto &group : m_groups) {
+		switch(group.size) {
+		case 1:
+			copy_values<1>(slice, group.channels, group.destinations, group.type, optBinding);
+			break;
+		case 4:
+			copy_values<4>(slice, group.channels, group.destinations, group.type, optBinding);
+			break;
+		case 8:
+			copy_values<8>(slice, group.channels, group.destinations, group.type, optBinding);
+			break;
+		case 12:
+			copy_values<12>(slice, group.channels, group.destinations, group.type, optBinding);
+			break;
+		case 16:
+			copy_values<16>(slice, group.channels, group.destinations, group.type, optBinding);
+			break;
+		default:
+			copy_values(slice, group.channels, group.destinations, group.type, group.size, optBinding);
+			break;
+		}
+	}
+}
+
+void panima::ChannelBindingTable::Apply(const Slice &slice, const std::vector<uint32_t> &channelIndices, const AnimationBinding *optBinding) const
+{
+	auto &values = slice.channelValues;
+	for(auto idx : channelIndices) {
+		auto key = optBinding ? optBinding->GetSlot(idx) : idx;
+		if(key >= m_locations.size() || idx >= values.size())
+			continue;
+		auto loc = m_locations[key];
+		if(loc.group == INVALID_INDEX)
+			continue;
+		auto &group = m_groups[loc.group];
+		auto &prop = values[idx];
+		if(!prop || prop->type != group.type)
+			continue;
+		std::memcpy(group.destinations[loc.entry], prop->value, group.size);
+	}
+}
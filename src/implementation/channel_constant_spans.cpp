@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <udm.hpp>
+#include <cstring>
+
+module panima;
+
+import :channel;
+
+void panima::Channel::UpdateConstantSpans()
+{
+	auto n = GetValueCount();
+	m_constantSpanEnds.resize(n);
+	m_constantSpansRevision = m_revision;
+	if(n == 0)
+		return;
+	m_constantSpanEnds[n - 1] = n - 1;
+	udm::visit_ng(GetValueType(), [this, n](auto tag) {
+		using T = typename decltype(tag)::type;
+		if constexpr(is_animatable_type(udm::type_to_enum<T>())) {
+			for(auto i = static_cast<int64_t>(n) - 2; i >= 0; --i) {
+				auto idx = static_cast<uint32_t>(i);
+				// Values have to match exactly, otherwise slow ramps could be detected as constant
+				auto equal = std::memcmp(&GetValue<T>(idx), &GetValue<T>(idx + 1), sizeof(T)) == 0;
+				m_constantSpanEnds[idx] = equal ? m_constantSpanEnds[idx + 1] : idx;
+			}
+		}
+		else {
+			for(auto i = decltype(n) {0u}; i < n; ++i)
+				m_constantSpanEnds[i] = i;
+		}
+	});
+}
+
+bool panima::Channel::IsConstant() const
+{
+	if(m_valueExpression || !HasConstantSpanInfo())
+		return false;
+	return m_constantSpanEnds.empty() || m_constantSpanEnds.front() == m_constantSpanEnds.size() - 1;
+}
+
+bool panima::Channel::IsConstantBetween(uint32_t idx0, uint32_t idx1) const
+{
+	if(m_valueExpression || !HasConstantSpanInfo())
+		return false;
+	if(idx1 < idx0)
+		std::swap(idx0, idx1);
+	if(idx1 >= m_constantSpanEnds.size())
+		return false;
+	return m_constantSpanEnds[idx0] >= idx1;
+}
+
+bool panima::Channel::IsInConstantSpan(float t, uint32_t pivotTimeIndex) const
+{
+	if(m_valueExpression || !HasConstantSpanInfo() || pivotTimeIndex >= m_constantSpanEnds.size() || !m_timesData)
+		return false;
+	auto lastIdx = static_cast<uint32_t>(m_constantSpanEnds.size() - 1);
+	auto spanEnd = m_constantSpanEnds[pivotTimeIndex];
+	// The last sample was interpolated between the pivot key and the next one, so unless the pivot is the
+	// last key (in which case the value is clamped), both have to be part of the span
+	if(spanEnd == pivotTimeIndex && pivotTimeIndex != lastIdx)
+		return false;
+	auto localT = GetLocalTime(t);
+	if(localT < m_timesData[pivotTimeIndex])
+		return false;
+	return spanEnd == lastIdx || localT <= m_timesData[spanEnd];
+}
@@ -0,0 +1,82 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <udm.hpp>
+#include <memory>
+#include <optional>
+
+module panima;
+
+import :channel;
+
+static const udm::ArrayLz4 *get_compressed_array(const udm::PProperty &prop)
+{
+	auto *arr = prop->GetValuePtr<udm::Array>();
+	if(!arr || arr->GetArrayType() != udm::ArrayType::Compressed)
+		return nullptr;
+	return static_cast<const udm::ArrayLz4 *>(arr);
+}
+
+// compressedBytes has to be empty if the compressed blob of the array may not be current, since
+// accessing the blob of a modified array would compress it
+static void add_array_memory_usage(const udm::PProperty &prop, std::optional<size_t> compressedBytes, panima::MemoryUsage &usage)
+{
+	auto *arr = prop->GetValuePtr<udm::Array>();
+	if(!arr)
+		return;
+	panima::MemoryUsage arrayUsage {};
+	// Panima keeps the uncompressed memory of compressed arrays persistent (see Channel::UpdateLookupCache),
+	// so both buffers are resident.
+	arrayUsage.uncompressedBytes = arr->GetSize() * arr->GetValueSize();
+	if(arr->GetArrayType() == udm::ArrayType::Compressed) {
+		if(compressedBytes)
+			arrayUsage.compressedBytes = *compressedBytes;
+		else
+			++arrayUsage.unknownCompressedArrays;
+	}
+	if(prop.use_count() > 1)
+		arrayUsage.MarkShared();
+	usage += arrayUsage;
+}
+
+void panima::Channel::UpdateCompressedSizes() const
+{
+	// Called by Save, which has to compress the arrays anyway
+	auto sizes = std::make_shared<CompressedSizes>();
+	sizes->revision = m_revision;
+	if(auto *arr = get_compressed_array(m_times))
+		sizes->timesBytes = arr->GetCompressedBlob().compressedData.capacity();
+	if(auto *arr = get_compressed_array(m_values))
+		sizes->valuesBytes = arr->GetCompressedBlob().compressedData.capacity();
+	std::atomic_store(&m_compressedSizes, std::shared_ptr<const CompressedSizes> {std::move(sizes)});
+}
+
+panima::MemoryUsage panima::Channel::GetMemoryUsage() const
+{
+	MemoryUsage usage {};
+	usage.objectBytes = sizeof(*this);
+	auto compressedSizes = std::atomic_load(&m_compressedSizes);
+	auto compressedSizesValid = compressedSizes && compressedSizes->revision == m_revision;
+	add_array_memory_usage(m_times, compressedSizesValid ? compressedSizes->timesBytes : std::optional<size_t> {}, usage);
+	add_array_memory_usage(m_values, compressedSizesValid ? compressedSizes->valuesBytes : std::optional<size_t> {}, usage);
+
+	usage.stringBytes = targetPath.path.GetString().capacity();
+	if(auto *components = targetPath.GetComponents()) {
+		usage.stringBytes += sizeof(*components) + components->capacity() * sizeof(std::string);
+		for(auto &c : *components)
+			usage.stringBytes += c.capacity();
+	}
+
+	if(m_valueExpression)
+		usage.expressionBytes = m_valueExpression->GetMemoryUsage();
+
+	usage.derivedBytes = m_constantSpanEnds.capacity() * sizeof(m_constantSpanEnds.front());
+	if(auto aggregates = std::atomic_load(&m_aggregates)) {
+		usage.derivedBytes += sizeof(*aggregates) + aggregates->components.capacity() * sizeof(ChannelAggregates::Component);
+		for(auto &comp : aggregates->components)
+			usage.derivedBytes += comp.prefixIntegrals.capacity() * sizeof(double) + (comp.minTree.capacity() + comp.maxTree.capacity()) * sizeof(float);
+	}
+	return usage;
+}
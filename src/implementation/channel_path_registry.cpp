@@ -0,0 +1,100 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <sharedutils/util_path.hpp>
+#include <string>
+#include <mutex>
+#include <shared_mutex>
+
+module panima;
+
+import :channel;
+
+panima::ChannelPathRegistry &panima::ChannelPathRegistry::Get()
+{
+	static ChannelPathRegistry registry;
+	return registry;
+}
+
+std::string panima::ChannelPathRegistry::GetKey(const ChannelPath &path)
+{
+	// Components are separated by null characters, which can't be part of a path
+	auto key = path.path.GetString();
+	if(auto *components = path.GetComponents()) {
+		key += '\0';
+		for(auto first = true; auto &c : *components) {
+			if(first)
+				first = false;
+			else
+				key += '\0';
+			key += c;
+		}
+	}
+	return key;
+}
+
+panima::ChannelPathId panima::ChannelPathRegistry::Intern(const ChannelPath &path)
+{
+	auto key = GetKey(path);
+	{
+		std::shared_lock lock {m_mutex};
+		auto it = m_keyToId.find(key);
+		if(it != m_keyToId.end())
+			return it->second;
+	}
+	std::unique_lock lock {m_mutex};
+	auto it = m_keyToId.find(key);
+	if(it != m_keyToId.end())
+		return it->second;
+	auto id = static_cast<ChannelPathId>(m_entries.size());
+	auto hash = std::hash<std::string> {}(key);
+	m_keyToId[key] = id;
+	m_entries.push_back({std::move(key), hash});
+	return id;
+}
+
+panima::ChannelPathId panima::ChannelPathRegistry::Intern(const std::string &path)
+{
+	{
+		std::shared_lock lock {m_mutex};
+		auto it = m_aliasToId.find(path);
+		if(it != m_aliasToId.end())
+			return it->second;
+	}
+	// The constructor interns the parsed path
+	auto id = ChannelPath {path}.GetId();
+	std::unique_lock lock {m_mutex};
+	m_aliasToId[path] = id;
+	return id;
+}
+
+panima::ChannelPathId panima::ChannelPathRegistry::Find(const std::string &path) const
+{
+	{
+		std::shared_lock lock {m_mutex};
+		auto it = m_aliasToId.find(path);
+		if(it != m_aliasToId.end())
+			return it->second;
+	}
+	auto key = GetKey(ChannelPath {path, ChannelPath::NoIntern {}});
+	std::unique_lock lock {m_mutex};
+	auto it = m_keyToId.find(key);
+	if(it == m_keyToId.end())
+		return INVALID_CHANNEL_PATH_ID;
+	m_aliasToId[path] = it->second;
+	return it->second;
+}
+
+size_t panima::ChannelPathRegistry::GetHash(ChannelPathId id) const
+{
+	std::shared_lock lock {m_mutex};
+	return (id < m_entries.size()) ? m_entries[id].hash : 0;
+}
+
+size_t panima::ChannelPathRegistry::GetCount() const
+{
+	std::shared_lock lock {m_mutex};
+	return m_entries.size();
+}
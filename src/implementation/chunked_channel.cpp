@@ -0,0 +1,333 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <udm.hpp>
+#include <mathutil/umath.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <optional>
+#include <future>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <exception>
+
+module panima;
+
+import :chunked_channel;
+import :channel;
+import :trace;
+
+static constexpr uint32_t CHUNKED_CHANNEL_FORMAT_VERSION = 1;
+
+static std::shared_ptr<udm::Data> load_udm_data(const std::string &fileName, std::string &outErr)
+{
+	try {
+		auto data = udm::Data::Load(fileName);
+		if(!data)
+			outErr = "Failed to load '" + fileName + "'!";
+		return data;
+	}
+	catch(const std::exception &e) {
+		outErr = "Failed to load '" + fileName + "': " + e.what();
+	}
+	return nullptr;
+}
+
+std::shared_ptr<panima::FileChunkSource> panima::FileChunkSource::Open(const std::string &manifestFileName, std::string &outErr)
+{
+	auto data = load_udm_data(manifestFileName, outErr);
+	if(!data)
+		return nullptr;
+	auto udmManifest = data->GetAssetData().GetData()["chunkedChannel"];
+	uint32_t version = 0;
+	udmManifest["version"](version);
+	if(version != CHUNKED_CHANNEL_FORMAT_VERSION) {
+		outErr = "Unsupported chunked channel version " + std::to_string(version) + "!";
+		return nullptr;
+	}
+	auto source = std::shared_ptr<FileChunkSource> {new FileChunkSource {}};
+	uint32_t valueType = umath::to_integral(udm::Type::Invalid);
+	udmManifest["valueType"](valueType);
+	source->m_valueType = static_cast<udm::Type>(valueType);
+	if(!is_animatable_type(source->m_valueType)) {
+		outErr = "Invalid value type!";
+		return nullptr;
+	}
+	udmManifest["interpolation"](source->m_interpolation);
+	udmManifest["targetPath"](source->m_targetPath);
+	auto udmExpression = udmManifest["expression"];
+	if(udmExpression) {
+		std::string expr;
+		udmExpression(expr);
+		source->m_expression = std::move(expr);
+	}
+
+	// Chunk file names are relative to the manifest
+	auto path = std::filesystem::path {manifestFileName}.parent_path();
+	auto udmChunks = udmManifest["chunks"];
+	source->m_chunks.reserve(udmChunks.GetSize());
+	source->m_chunkFileNames.reserve(udmChunks.GetSize());
+	for(auto udmChunk : udmChunks) {
+		ChunkInfo info {};
+		udmChunk["startTime"](info.startTime);
+		udmChunk["endTime"](info.endTime);
+		udmChunk["keyCount"](info.keyCount);
+		std::string fileName;
+		udmChunk["file"](fileName);
+		if(!source->m_chunks.empty() && info.startTime <= source->m_chunks.back().endTime) {
+			outErr = "Chunks are not in chronological order!";
+			return nullptr;
+		}
+		source->m_chunks.push_back(info);
+		source->m_chunkFileNames.push_back((path / fileName).string());
+	}
+	return source;
+}
+
+std::shared_ptr<panima::Channel> panima::FileChunkSource::LoadChunk(uint32_t chunkIndex) const
+{
+	if(chunkIndex >= m_chunkFileNames.size())
+		return nullptr;
+	trace::Zone zone {"panima::FileChunkSource::LoadChunk"};
+	std::string err;
+	auto data = load_udm_data(m_chunkFileNames[chunkIndex], err);
+	if(!data)
+		return nullptr;
+	auto udmChannel = data->GetAssetData().GetData()["channel"];
+	auto channel = std::make_shared<Channel>();
+	// Loading the channel decompresses the key arrays
+	if(!channel->Load(udmChannel) || channel->GetValueType() != m_valueType)
+		return nullptr;
+	return channel;
+}
+
+void panima::FileChunkSource::InitializeChannel(Channel &channel) const
+{
+	channel.interpolation = m_interpolation;
+	channel.SetTargetPath(m_targetPath);
+	if(m_expression) {
+		std::string err;
+		channel.SetValueExpression(*m_expression, err, true);
+	}
+}
+
+bool panima::ChunkedChannel::Save(const Channel &channel, const std::string &manifestFileName, std::string &outErr, float chunkDuration)
+{
+	if(chunkDuration <= 0.f) {
+		outErr = "Invalid chunk duration!";
+		return false;
+	}
+	auto manifestPath = std::filesystem::path {manifestFileName};
+	auto path = manifestPath.parent_path();
+	auto baseName = manifestPath.stem().string();
+
+	auto data = udm::Data::Create();
+	auto udmManifest = data->GetAssetData().GetData()["chunkedChannel"];
+	udmManifest["version"] = CHUNKED_CHANNEL_FORMAT_VERSION;
+	udmManifest["valueType"] = static_cast<uint32_t>(umath::to_integral(channel.GetValueType()));
+	udmManifest["interpolation"] = channel.interpolation;
+	udmManifest["targetPath"] = channel.targetPath.ToUri();
+	if(auto *expr = channel.GetValueExpression())
+		udmManifest["expression"] = *expr;
+
+	// Chunk boundaries are multiples of the chunk duration, relative to the first key. Empty chunks are skipped.
+	struct ChunkRange {
+		uint32_t first;
+		uint32_t count;
+	};
+	std::vector<ChunkRange> ranges;
+	auto &times = channel.GetTimesArray();
+	auto n = channel.GetTimeCount();
+	for(uint32_t i = 0; i < n;) {
+		auto tChunkStart = times.GetValue<float>(0) + std::floor((times.GetValue<float>(i) - times.GetValue<float>(0)) / chunkDuration) * chunkDuration;
+		auto tChunkEnd = tChunkStart + chunkDuration;
+		auto first = i;
+		while(i < n && times.GetValue<float>(i) < tChunkEnd)
+			++i;
+		ranges.push_back({first, i - first});
+	}
+
+	auto udmChunks = udmManifest.AddArray("chunks", ranges.size());
+	for(size_t i = 0; i < ranges.size(); ++i) {
+		auto &range = ranges[i];
+		Channel chunk {};
+		chunk.SetValueType(channel.GetValueType());
+		chunk.AssignKeys({{&channel, range.first, range.count}});
+
+		auto chunkFileName = baseName + "_chunk" + std::to_string(i) + ".udm";
+		auto chunkData = udm::Data::Create();
+		auto udmChannel = chunkData->GetAssetData().GetData()["channel"];
+		chunk.Save(udmChannel);
+		try {
+			if(!chunkData->Save((path / chunkFileName).string())) {
+				outErr = "Failed to write chunk '" + chunkFileName + "'!";
+				return false;
+			}
+		}
+		catch(const std::exception &e) {
+			outErr = "Failed to write chunk '" + chunkFileName + "': " + e.what();
+			return false;
+		}
+
+		auto udmChunk = udmChunks[i];
+		udmChunk["startTime"] = times.GetValue<float>(range.first);
+		udmChunk["endTime"] = times.GetValue<float>(range.first + range.count - 1);
+		udmChunk["keyCount"] = range.count;
+		udmChunk["file"] = chunkFileName;
+	}
+	try {
+		if(!data->Save(manifestFileName)) {
+			outErr = "Failed to write manifest '" + manifestFileName + "'!";
+			return false;
+		}
+	}
+	catch(const std::exception &e) {
+		outErr = "Failed to write manifest '" + manifestFileName + "': " + e.what();
+		return false;
+	}
+	return true;
+}
+
+std::shared_ptr<panima::ChunkedChannel> panima::ChunkedChannel::Create(const std::shared_ptr<ChunkSource> &source, const TaskExecutor &executor)
+{
+	if(!source)
+		return nullptr;
+	return std::shared_ptr<ChunkedChannel> {new ChunkedChannel {source, executor}};
+}
+
+panima::ChunkedChannel::ChunkedChannel(const std::shared_ptr<ChunkSource> &source, const TaskExecutor &executor) : m_source {source}, m_executor {executor}, m_channel {std::make_shared<Channel>()}
+{
+	m_channel->SetValueType(source->GetValueType());
+	source->InitializeChannel(*m_channel);
+}
+
+uint32_t panima::ChunkedChannel::FindChunk(float tLocal) const
+{
+	auto &chunks = m_source->GetChunks();
+	auto it = std::upper_bound(chunks.begin(), chunks.end(), tLocal, [](float t, const ChunkInfo &chunk) { return t < chunk.startTime; });
+	if(it == chunks.begin())
+		return 0;
+	return static_cast<uint32_t>((it - chunks.begin()) - 1);
+}
+
+bool panima::ChunkedChannel::IsChunkLoaded(uint32_t chunkIndex) const
+{
+	auto it = m_chunks.find(chunkIndex);
+	return it != m_chunks.end() && it->second.wait_for(std::chrono::seconds {0}) == std::future_status::ready;
+}
+
+void panima::ChunkedChannel::RequestChunk(uint32_t chunkIndex)
+{
+	if(m_chunks.find(chunkIndex) != m_chunks.end())
+		return;
+	auto promise = std::make_shared<std::promise<std::shared_ptr<Channel>>>();
+	m_chunks[chunkIndex] = promise->get_future().share();
+	auto load = [source = m_source, chunkIndex, promise]() {
+		try {
+			promise->set_value(source->LoadChunk(chunkIndex));
+		}
+		catch(...) {
+			promise->set_value(nullptr);
+		}
+	};
+	if(!m_executor) {
+		load();
+		return;
+	}
+	m_executor(std::move(load));
+}
+
+bool panima::ChunkedChannel::IsResident(float t) const
+{
+	if(!m_residentRange)
+		return false;
+	auto idx = FindChunk(m_channel->GetLocalTime(t));
+	return idx >= m_residentRange->first && idx <= m_residentRange->second;
+}
+
+uint32_t panima::ChunkedChannel::GetResidentKeyCount(uint32_t chunkIndex)
+{
+	auto &chunk = m_chunks[chunkIndex].get();
+	return (chunk && chunk->GetValueType() == m_channel->GetValueType()) ? chunk->GetTimeCount() : 0;
+}
+
+bool panima::ChunkedChannel::Update(float t, bool wait)
+{
+	auto numChunks = static_cast<uint32_t>(m_source->GetChunks().size());
+	if(numChunks == 0)
+		return false;
+	auto idx = FindChunk(m_channel->GetLocalTime(t));
+	auto first = (idx >= m_residentRadius) ? idx - m_residentRadius : 0u;
+	auto last = umath::min(idx + m_residentRadius, numChunks - 1);
+
+	// The chunk containing the playhead is requested first, followed by its neighbours in order of distance
+	RequestChunk(idx);
+	for(uint32_t d = 1; d <= m_residentRadius; ++d) {
+		if(idx >= d)
+			RequestChunk(idx - d);
+		if(idx + d < numChunks)
+			RequestChunk(idx + d);
+	}
+	// Chunks are released with a margin of one chunk, so that scrubbing back and forth across a chunk boundary doesn't reload them
+	for(auto it = m_chunks.begin(); it != m_chunks.end();) {
+		if(it->first + m_residentRadius + 1 < idx || it->first > idx + m_residentRadius + 1)
+			it = m_chunks.erase(it);
+		else
+			++it;
+	}
+
+	if(wait)
+		m_chunks[idx].wait();
+	else if(!IsChunkLoaded(idx))
+		return IsResident(t);
+
+	// The resident keys are the contiguous run of loaded chunks around the playhead
+	auto residentFirst = idx;
+	while(residentFirst > first && IsChunkLoaded(residentFirst - 1))
+		--residentFirst;
+	auto residentLast = idx;
+	while(residentLast < last && IsChunkLoaded(residentLast + 1))
+		++residentLast;
+	std::pair<uint32_t, uint32_t> residentRange {residentFirst, residentLast};
+	if(m_residentRange == residentRange)
+		return GetResidentKeyCount(idx) > 0;
+	trace::Zone zone {"panima::ChunkedChannel::Update"};
+	// Key ranges of the chunks [chunkBegin, chunkEnd)
+	auto getRanges = [this](uint32_t chunkBegin, uint32_t chunkEnd) {
+		std::vector<Channel::KeyRange> ranges;
+		for(auto i = chunkBegin; i < chunkEnd; ++i) {
+			if(GetResidentKeyCount(i) > 0) {
+				auto &chunk = m_chunks[i].get();
+				ranges.push_back({chunk.get(), 0, chunk->GetTimeCount()});
+			}
+		}
+		return ranges;
+	};
+	std::vector<uint32_t> keyCounts;
+	keyCounts.reserve(residentLast - residentFirst + 1);
+	for(auto i = residentFirst; i <= residentLast; ++i)
+		keyCounts.push_back(GetResidentKeyCount(i));
+
+	// Chunks that were already resident are kept in place, only the keys of the chunks before and after them are copied
+	auto keepFirst = m_residentRange ? umath::max(m_residentRange->first, residentFirst) : 1u;
+	auto keepLast = m_residentRange ? umath::min(m_residentRange->second, residentLast) : 0u;
+	if(keepFirst <= keepLast) {
+		uint32_t keyOffset = 0;
+		for(auto i = m_residentRange->first; i < keepFirst; ++i)
+			keyOffset += m_residentKeyCounts[i - m_residentRange->first];
+		uint32_t keyCount = 0;
+		for(auto i = keepFirst; i <= keepLast; ++i)
+			keyCount += m_residentKeyCounts[i - m_residentRange->first];
+		m_channel->SpliceKeys(keyOffset, keyCount, getRanges(residentFirst, keepFirst), getRanges(keepLast + 1, residentLast + 1));
+	}
+	else
+		m_channel->AssignKeys(getRanges(residentFirst, residentLast + 1));
+	m_residentRange = residentRange;
+	m_residentKeyCounts = std::move(keyCounts);
+	return m_residentKeyCounts[idx - residentFirst] > 0;
+}
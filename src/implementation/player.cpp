@@ -4,26 +4,48 @@
 module;
 
 #include <udm.hpp>
+#include <algorithm>
+#include <cmath>
 
 module panima;
 
 import :player;
 import :animation;
 import :channel;
+import :pose_cache;
+import :expression;
+import :trace;
+import :chunked_channel;
 
 std::shared_ptr<panima::Player> panima::Player::Create() { return std::shared_ptr<Player> {new Player {}}; }
 std::shared_ptr<panima::Player> panima::Player::Create(const Player &other) { return std::shared_ptr<Player> {new Player {other}}; }
 std::shared_ptr<panima::Player> panima::Player::Create(Player &&other) { return std::shared_ptr<Player> {new Player {std::move(other)}}; }
+static std::unique_ptr<panima::PlayerLod> copy_lod(const std::unique_ptr<panima::PlayerLod> &lod)
+{
+	if(!lod)
+		return nullptr;
+	// Only the settings are copied, the cached poses are re-evaluated on demand
+	auto newLod = std::make_unique<panima::PlayerLod>();
+	newLod->updateRateDivisor = lod->updateRateDivisor;
+	newLod->frameCounter = lod->frameCounter;
+	newLod->channelMask = lod->channelMask;
+	return newLod;
+}
+
 panima::Player::Player() {}
 panima::Player::Player(const Player &other)
-    : m_playbackRate {other.m_playbackRate}, m_currentTime {other.m_currentTime}, m_stateFlags {other.m_stateFlags}, m_lastChannelTimestampIndices {other.m_lastChannelTimestampIndices}, m_animation {other.m_animation}, m_currentSlice {other.m_currentSlice}
+    : m_playbackRate {other.m_playbackRate}, m_currentTime {other.m_currentTime}, m_stateFlags {other.m_stateFlags}, m_lastChannelTimestampIndices {other.m_lastChannelTimestampIndices}, m_animation {other.m_animation}, m_currentSlice {other.m_currentSlice},
+      m_poseCache {other.m_poseCache}, m_poseTable {other.m_poseTable}, m_lod {copy_lod(other.m_lod)}, m_changedChannels {other.m_changedChannels},
+      m_targetSchema {other.m_targetSchema}, m_binding {other.m_binding}, m_chunkedChannels {other.m_chunkedChannels}
 {
-	static_assert(sizeof(*this) == 96, "Update this implementation when class has changed!");
+	static_assert(sizeof(*this) == 216, "Update this implementation when class has changed!");
 }
 panima::Player::Player(Player &&other)
-    : m_playbackRate {other.m_playbackRate}, m_currentTime {other.m_currentTime}, m_stateFlags {other.m_stateFlags}, m_lastChannelTimestampIndices {std::move(other.m_lastChannelTimestampIndices)}, m_animation {other.m_animation}, m_currentSlice {std::move(other.m_currentSlice)}
+    : m_playbackRate {other.m_playbackRate}, m_currentTime {other.m_currentTime}, m_stateFlags {other.m_stateFlags}, m_lastChannelTimestampIndices {std::move(other.m_lastChannelTimestampIndices)}, m_animation {other.m_animation}, m_currentSlice {std::move(other.m_currentSlice)},
+      m_poseCache {std::move(other.m_poseCache)}, m_poseTable {std::move(other.m_poseTable)}, m_lod {std::move(other.m_lod)}, m_changedChannels {std::move(other.m_changedChannels)},
+      m_targetSchema {std::move(other.m_targetSchema)}, m_binding {std::move(other.m_binding)}, m_chunkedChannels {std::move(other.m_chunkedChannels)}
 {
-	static_assert(sizeof(*this) == 96, "Update this implementation when class has changed!");
+	static_assert(sizeof(*this) == 216, "Update this implementation when class has changed!");
 }
 panima::Player &panima::Player::operator=(const Player &other)
 {
@@ -32,9 +54,16 @@ panima::Player &panima::Player::operator=(const Player &other)
 	m_stateFlags = other.m_stateFlags;
 	m_animation = other.m_animation;
 	m_currentSlice = other.m_currentSlice;
+	m_poseCache = other.m_poseCache;
+	m_poseTable = other.m_poseTable;
+	m_lod = copy_lod(other.m_lod);
+	m_changedChannels = other.m_changedChannels;
+	m_targetSchema = other.m_targetSchema;
+	m_binding = other.m_binding;
+	m_chunkedChannels = other.m_chunkedChannels;
 
 	m_lastChannelTimestampIndices = other.m_lastChannelTimestampIndices;
-	static_assert(sizeof(*this) == 96, "Update this implementation when class has changed!");
+	static_assert(sizeof(*this) == 216, "Update this implementation when class has changed!");
 	return *this;
 }
 panima::Player &panima::Player::operator=(Player &&other)
@@ -44,9 +73,16 @@ panima::Player &panima::Player::operator=(Player &&other)
 	m_stateFlags = other.m_stateFlags;
 	m_animation = other.m_animation;
 	m_currentSlice = std::move(other.m_currentSlice);
+	m_poseCache = std::move(other.m_poseCache);
+	m_poseTable = std::move(other.m_poseTable);
+	m_lod = std::move(other.m_lod);
+	m_changedChannels = std::move(other.m_changedChannels);
+	m_targetSchema = std::move(other.m_targetSchema);
+	m_binding = std::move(other.m_binding);
+	m_chunkedChannels = std::move(other.m_chunkedChannels);
 
 	m_lastChannelTimestampIndices = std::move(other.m_lastChannelTimestampIndices);
-	static_assert(sizeof(*this) == 96, "Update this implementation when class has changed!");
+	static_assert(sizeof(*this) == 216, "Update this implementation when class has changed!");
 	return *this;
 }
 float panima::Player::GetDuration() const
@@ -79,6 +115,7 @@ void panima::Player::SetLooping(bool looping) { umath::set_flag(m_stateFlags, St
 bool panima::Player::IsLooping() const { return umath::is_flag_set(m_stateFlags, StateFlags::Looping); }
 bool panima::Player::Advance(float dt, bool forceUpdate)
 {
+	trace::Zone zone {"panima::Player::Advance"};
 	if(!m_animation)
 		return false;
 	auto &anim = m_animation;
@@ -94,69 +131,271 @@ bool panima::Player::Advance(float dt, bool forceUpdate)
 		// else
 		// 	newTime = dur;
 	}
-	if(newTime == m_currentTime && !forceUpdate && !umath::is_flag_set(m_stateFlags, StateFlags::AnimationDirty))
+	auto dirty = umath::is_flag_set(m_stateFlags, StateFlags::AnimationDirty);
+	if(newTime == m_currentTime && !forceUpdate && !dirty) {
+		m_changedChannels.clear();
 		return false;
+	}
 	umath::set_flag(m_stateFlags, StateFlags::AnimationDirty, false);
 	m_currentTime = newTime;
+	auto trackChanges = umath::is_flag_set(m_stateFlags, StateFlags::TrackChanges);
+	if(trackChanges) {
+		m_changedChannels.clear();
+		// The slice may have been modified externally, so constant channels have to be re-sampled
+		if(forceUpdate || dirty)
+			std::fill(m_lastChannelTimestampIndices.begin(), m_lastChannelTimestampIndices.end(), std::numeric_limits<uint32_t>::max());
+	}
+	if(m_lod) {
+		AdvanceLod(dt, forceUpdate || dirty);
+		// Interpolated values change on every call, so we don't bother detecting changes here
+		if(trackChanges)
+			MarkAllChannelsChanged();
+	}
+	else
+		SampleAnimation(m_currentTime, m_currentSlice, nullptr, trackChanges ? &m_changedChannels : nullptr);
 	return true;
-	/*auto &channels = anim->GetChannels();
-	auto numChannels = umath::min(channels.size(),m_currentSlice.channelValues.size());
-	auto vs = [this,newTime](auto tag,pragma::animation::AnimationChannel &channel,udm::Property &sliceData,uint32_t &inOutPivotTimeIndex) {
-		using T = decltype(tag)::type;
-		if constexpr(
-			!std::is_same_v<T,udm::Vector2i> && !std::is_same_v<T,udm::Vector3i> && !std::is_same_v<T,udm::Vector4i> && !std::is_same_v<T,udm::Srgba> && !std::is_same_v<T,udm::HdrColor> &&
-			!std::is_same_v<T,udm::Transform> && !std::is_same_v<T,udm::ScaledTransform> && !std::is_same_v<T,udm::Nil>
-		)
-			sliceData = channel.GetInterpolatedValue<T>(newTime,inOutPivotTimeIndex);
-	};
-	for(auto i=decltype(numChannels){0u};i<numChannels;++i)
-	{
-		auto &channel = channels[i];
-		auto &sliceData = m_currentSlice.channelValues[i];
-		auto &lastChannelTimestampIndex = m_lastChannelTimestampIndices[i];
-		auto valueType = channel->GetValueType();
-		if(udm::is_numeric_type(valueType))
-			std::visit([&vs,&channel,&sliceData,&lastChannelTimestampIndex](auto tag) {vs(tag,*channel,*sliceData,lastChannelTimestampIndex);},udm::get_numeric_tag(valueType));
-		else if(udm::is_generic_type(valueType))
-			std::visit([&vs,&channel,&sliceData,&lastChannelTimestampIndex](auto tag) {vs(tag,*channel,*sliceData,lastChannelTimestampIndex);},udm::get_generic_tag(valueType));
-	}*/
-	// TODO
-	// ApplySliceInterpolation(m_prevAnimSlice,m_currentSlice,fadeFactor);
+}
+
+void panima::Player::SampleAnimation(float t, Slice &inOutSlice, const std::vector<uint8_t> *optChannelMask, std::vector<uint32_t> *optOutChangedChannels)
+{
+	auto &anim = *m_animation;
+	if(m_targetSchema) {
+		if(!m_binding || !m_binding->IsValid(anim))
+			UpdateBinding();
+		auto &bindingMask = m_binding->GetChannelMask();
+		if(!optChannelMask)
+			optChannelMask = &bindingMask;
+		else {
+			// Channels are skipped if either mask excludes them
+			m_combinedChannelMask.resize(bindingMask.size());
+			for(size_t i = 0; i < bindingMask.size(); ++i)
+				m_combinedChannelMask[i] = (bindingMask[i] != 0 && (i >= optChannelMask->size() || (*optChannelMask)[i] != 0)) ? 1 : 0;
+			optChannelMask = &m_combinedChannelMask;
+		}
+	}
+	if(m_poseCache) {
+		if(!m_poseTable || !m_poseTable->IsUpToDate(anim))
+			m_poseTable = m_poseCache->Get(anim);
+		m_poseTable->Sample(t, inOutSlice, optChannelMask);
+		// Pose tables are interpolated, so every sampled channel is considered changed
+		if(optOutChangedChannels) {
+			auto numChannels = static_cast<uint32_t>(inOutSlice.channelValues.size());
+			for(auto i = decltype(numChannels) {0u}; i < numChannels; ++i) {
+				if(!optChannelMask || i >= optChannelMask->size() || (*optChannelMask)[i] != 0)
+					optOutChangedChannels->push_back(i);
+			}
+		}
+		return;
+	}
+	for(auto &chunkedChannel : m_chunkedChannels)
+		chunkedChannel->Update(t);
+	anim.Evaluate(t, inOutSlice, m_lastChannelTimestampIndices, expression::EvaluationContext::GetThreadContext(), optChannelMask, optOutChangedChannels);
+}
+
+void panima::Player::AddChunkedChannel(const std::shared_ptr<ChunkedChannel> &channel)
+{
+	if(std::find(m_chunkedChannels.begin(), m_chunkedChannels.end(), channel) == m_chunkedChannels.end())
+		m_chunkedChannels.push_back(channel);
+}
+void panima::Player::RemoveChunkedChannel(const ChunkedChannel &channel)
+{
+	std::erase_if(m_chunkedChannels, [&channel](const std::shared_ptr<ChunkedChannel> &other) { return other.get() == &channel; });
+}
+
+void panima::Player::SetChangeTrackingEnabled(bool enabled)
+{
+	umath::set_flag(m_stateFlags, StateFlags::TrackChanges, enabled);
+	m_changedChannels.clear();
+}
+void panima::Player::MarkAllChannelsChanged()
+{
+	auto numChannels = static_cast<uint32_t>(m_currentSlice.channelValues.size());
+	m_changedChannels.resize(numChannels);
+	for(auto i = decltype(numChannels) {0u}; i < numChannels; ++i)
+		m_changedChannels[i] = i;
+}
+
+panima::PlayerLod &panima::Player::InitializeLod()
+{
+	if(!m_lod)
+		m_lod = std::make_unique<PlayerLod>();
+	return *m_lod;
+}
+void panima::Player::SetUpdateRateDivisor(uint32_t divisor, uint32_t frameOffset)
+{
+	auto &lod = InitializeLod();
+	lod.updateRateDivisor = umath::max(divisor, 1u);
+	lod.frameCounter = frameOffset;
+	lod.interpolationValid = false;
+}
+void panima::Player::SetChannelMask(std::vector<std::string> pathPrefixes)
+{
+	auto &lod = InitializeLod();
+	lod.channelMask = std::move(pathPrefixes);
+	lod.maskAnimation = nullptr;
+	lod.interpolationValid = false;
+	SetAnimationDirty();
+}
+void panima::Player::UpdateLodChannelMask()
+{
+	auto &lod = *m_lod;
+	lod.maskAnimation = m_animation.get();
+	lod.interpolationValid = false;
+	lod.channelEnabled.clear();
+	if(lod.channelMask.empty() || !m_animation)
+		return;
+	auto &channels = m_animation->GetChannels();
+	lod.channelEnabled.resize(channels.size(), 0);
+	for(auto i = decltype(channels.size()) {0u}; i < channels.size(); ++i) {
+		auto path = channels[i]->targetPath.ToUri(false);
+		auto it = std::find_if(lod.channelMask.begin(), lod.channelMask.end(), [&path](const std::string &prefix) { return path.starts_with(prefix); });
+		lod.channelEnabled[i] = (it != lod.channelMask.end()) ? 1 : 0;
+	}
+}
+void panima::Player::AdvanceLod(float dt, bool discontinuous)
+{
+	auto &lod = *m_lod;
+	if(lod.maskAnimation != m_animation.get())
+		UpdateLodChannelMask();
+	auto *mask = lod.channelMask.empty() ? nullptr : &lod.channelEnabled;
+	auto divisor = lod.updateRateDivisor;
+	auto frame = lod.frameCounter % divisor;
+	// Time changes without a time step (e.g. SetCurrentTime) don't count as frames, to keep the evaluations in phase
+	if(dt != 0.f)
+		++lod.frameCounter;
+	if(divisor <= 1 || discontinuous) {
+		// Interpolation is resumed on the next scheduled evaluation
+		lod.interpolationValid = false;
+		SampleAnimation(m_currentTime, m_currentSlice, mask);
+		return;
+	}
+	if(frame == 0) {
+		// The previously predicted pose becomes the pose of this evaluation
+		if(lod.interpolationValid)
+			Slice::CopyValues(lod.nextSlice, lod.prevSlice);
+		else
+			SampleAnimation(m_currentTime, lod.prevSlice, mask);
+		auto tNext = m_currentTime + dt * static_cast<float>(divisor);
+		auto dur = m_animation->GetDuration();
+		if(tNext > dur)
+			tNext = (umath::is_flag_set(m_stateFlags, StateFlags::Looping) && dur > 0.f) ? fmodf(tNext, dur) : dur;
+		SampleAnimation(tNext, lod.nextSlice, mask);
+		if(!lod.interpolationValid) {
+			if(m_currentSlice.channelValues.size() != lod.nextSlice.channelValues.size())
+				SampleAnimation(m_currentTime, m_currentSlice, mask);
+			std::vector<uint32_t> dstToSrc;
+			if(mask) {
+				dstToSrc.resize(mask->size());
+				for(auto i = decltype(dstToSrc.size()) {0u}; i < dstToSrc.size(); ++i)
+					dstToSrc[i] = (*mask)[i] ? static_cast<uint32_t>(i) : SliceBlendPlan::INVALID_CHANNEL;
+			}
+			lod.nextPlan.Build(lod.nextSlice, m_currentSlice, mask ? &dstToSrc : nullptr);
+			lod.prevPlan.Build(lod.prevSlice, m_currentSlice, mask ? &dstToSrc : nullptr);
+			lod.interpolationValid = true;
+		}
+	}
+	else if(!lod.interpolationValid) {
+		SampleAnimation(m_currentTime, m_currentSlice, mask);
+		return;
+	}
+	// current = lerp(prev, next, f)
+	lod.nextPlan.Apply(0.f);
+	lod.prevPlan.Apply(static_cast<float>(frame) / static_cast<float>(divisor));
 }
 
 void panima::Player::SetAnimation(const Animation &animation)
 {
 	Reset();
+	if(m_lod)
+		m_lod->maskAnimation = nullptr;
 	m_animation = animation.shared_from_this();
 	auto &channels = animation.GetChannels();
-	m_currentSlice.channelValues.reserve(channels.size());
-	for(auto &channel : channels)
-		m_currentSlice.channelValues.push_back(udm::Property::Create(channel->GetValueType()));
+	// Existing properties are kept where possible, so that references to them (e.g. by blend plans) remain valid
+	m_currentSlice.channelValues.resize(channels.size());
+	for(auto i = decltype(channels.size()) {0u}; i < channels.size(); ++i) {
+		auto &prop = m_currentSlice.channelValues[i];
+		auto type = channels[i]->GetValueType();
+		if(!prop || prop->type != type)
+			prop = udm::Property::Create(type);
+	}
 	m_lastChannelTimestampIndices.resize(channels.size(), std::numeric_limits<uint32_t>::max());
+	UpdateBinding();
+}
+
+void panima::Player::SetTargetSchema(const std::shared_ptr<const AnimationTargetSchema> &schema)
+{
+	m_targetSchema = schema;
+	UpdateBinding();
+	SetAnimationDirty();
+}
+void panima::Player::UpdateBinding()
+{
+	m_binding = (m_targetSchema && m_animation) ? m_targetSchema->GetBinding(*m_animation) : nullptr;
+}
+udm::Property *panima::Player::GetSlotValue(uint32_t slot)
+{
+	if(!m_binding)
+		return nullptr;
+	auto channelIdx = m_binding->GetChannel(slot);
+	if(channelIdx >= m_currentSlice.channelValues.size())
+		return nullptr;
+	return m_currentSlice.channelValues[channelIdx].get();
+}
+
+void panima::Player::SetPoseCache(const std::shared_ptr<PoseCache> &poseCache)
+{
+	m_poseCache = poseCache;
+	m_poseTable = nullptr;
+	if(m_lod)
+		m_lod->interpolationValid = false;
+	SetAnimationDirty();
 }
 
 void panima::Player::Reset()
 {
 	m_currentTime = 0.f;
 	m_lastChannelTimestampIndices.clear();
+	if(m_lod)
+		m_lod->interpolationValid = false;
 }
 void panima::Player::ApplySliceInterpolation(const Slice &src, Slice &dst, float f)
 {
-	// TODO
-	/*if(f == 1.f)
-		return;
-	auto n = src.channelValues.size();
-	for(auto i=decltype(n){0u};i<n;++i)
-	{
-		//auto &channel = m_channels[i];
-		pragma::AnimationChannel &channel ;// TODO
-		// TODO: How to translate channels?
-		auto &srcVal = src.channelValues[i];
-		auto &dstVal = dst.channelValues[i];
-		// TODO
-		auto interp = channel.GetInterpolationFunction<Vector3>();
-		dstVal = interp(srcVal.GetValue<Vector3>(),dstVal.GetValue<Vector3>(),f);
-	}*/
+	SliceBlendPlan plan;
+	plan.Build(src, dst);
+	plan.Apply(f);
+}
+
+uint32_t panima::LodScheduler::Schedule(Player &player, uint32_t updateRateDivisor)
+{
+	auto divisor = umath::max(updateRateDivisor, 1u);
+	uint32_t bestPhase = 0;
+	auto bestLoad = std::numeric_limits<uint64_t>::max();
+	for(uint32_t phase = 0; phase < divisor; ++phase) {
+		uint64_t load = 0;
+		for(auto i = phase; i < HORIZON; i += divisor)
+			load += m_load[i];
+		if(load < bestLoad) {
+			bestLoad = load;
+			bestPhase = phase;
+		}
+	}
+	AddLoad(divisor, bestPhase, 1);
+	// The player evaluates whenever its frame counter is a multiple of the divisor, so the counter
+	// has to be offset for the evaluations to land on frames where (frameIndex % divisor) == phase
+	auto offset = static_cast<uint32_t>((m_frameIndex % divisor + divisor - bestPhase) % divisor);
+	player.SetUpdateRateDivisor(divisor, offset);
+	return bestPhase;
+}
+void panima::LodScheduler::Unschedule(uint32_t updateRateDivisor, uint32_t phase) { AddLoad(umath::max(updateRateDivisor, 1u), phase, -1); }
+void panima::LodScheduler::AddLoad(uint32_t divisor, uint32_t phase, int32_t amount)
+{
+	for(auto i = phase % divisor; i < HORIZON; i += divisor)
+		m_load[i] = static_cast<uint32_t>(umath::max(static_cast<int64_t>(m_load[i]) + amount, static_cast<int64_t>(0)));
+}
+void panima::LodScheduler::Clear()
+{
+	m_load = {};
+	m_frameIndex = 0;
 }
 
 #undef GetCurrentTime
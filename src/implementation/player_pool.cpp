@@ -0,0 +1,337 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <udm.hpp>
+#include <atomic>
+#include <latch>
+#include <thread>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+module panima;
+
+import :player_pool;
+import :animation;
+import :expression;
+import :pose_cache;
+
+#undef GetCurrentTime
+
+panima::PlayerHandle panima::PlayerPool::Create()
+{
+	uint32_t idx;
+	if(!m_freeIndices.empty()) {
+		idx = m_freeIndices.back();
+		m_freeIndices.pop_back();
+	}
+	else {
+		idx = static_cast<uint32_t>(m_generations.size());
+		m_animations.push_back(nullptr);
+		m_currentTimes.push_back(0.f);
+		m_playbackRates.push_back(1.f);
+		m_stateFlags.push_back(Player::StateFlags::None);
+		m_updated.push_back(0);
+		m_slices.push_back({});
+		m_lastChannelTimestampIndices.push_back({});
+		m_poseTables.push_back(nullptr);
+		m_generations.push_back(0);
+		m_alive.push_back(0);
+		m_activeListIndices.push_back(INVALID_ACTIVE_INDEX);
+	}
+	m_alive[idx] = 1;
+	return {idx, m_generations[idx]};
+}
+panima::PlayerHandle panima::PlayerPool::Create(const Player &player)
+{
+	auto handle = Create();
+	auto idx = handle.index;
+	if(auto *anim = player.GetAnimation())
+		SetAnimation(handle, *anim);
+	m_currentTimes[idx] = player.GetCurrentTime();
+	m_playbackRates[idx] = player.GetPlaybackRate();
+	SetLooping(handle, player.IsLooping());
+	Slice::CopyValues(player.GetCurrentSlice(), m_slices[idx]);
+	return handle;
+}
+void panima::PlayerPool::Destroy(PlayerHandle handle)
+{
+	if(!IsValid(handle))
+		return;
+	auto idx = handle.index;
+	Deactivate(idx);
+	m_animations[idx] = nullptr;
+	m_currentTimes[idx] = 0.f;
+	m_playbackRates[idx] = 1.f;
+	m_stateFlags[idx] = Player::StateFlags::None;
+	m_updated[idx] = 0;
+	m_slices[idx].channelValues.clear();
+	m_lastChannelTimestampIndices[idx].clear();
+	m_poseTables[idx] = nullptr;
+	m_alive[idx] = 0;
+	++m_generations[idx];
+	m_freeIndices.push_back(idx);
+}
+void panima::PlayerPool::Clear()
+{
+	// Generations have to be kept to invalidate existing handles
+	for(auto idx = decltype(m_generations.size()) {0u}; idx < m_generations.size(); ++idx) {
+		if(m_alive[idx])
+			Destroy({static_cast<uint32_t>(idx), m_generations[idx]});
+	}
+}
+
+void panima::PlayerPool::Activate(uint32_t idx)
+{
+	if(m_activeListIndices[idx] != INVALID_ACTIVE_INDEX || !m_animations[idx])
+		return;
+	m_activeListIndices[idx] = static_cast<uint32_t>(m_activeList.size());
+	m_activeList.push_back(idx);
+}
+void panima::PlayerPool::Deactivate(uint32_t idx)
+{
+	auto activeIdx = m_activeListIndices[idx];
+	if(activeIdx == INVALID_ACTIVE_INDEX)
+		return;
+	auto lastIdx = m_activeList.back();
+	m_activeList[activeIdx] = lastIdx;
+	m_activeListIndices[lastIdx] = activeIdx;
+	m_activeList.pop_back();
+	m_activeListIndices[idx] = INVALID_ACTIVE_INDEX;
+}
+bool panima::PlayerPool::IsFinished(uint32_t idx) const
+{
+	auto &anim = m_animations[idx];
+	if(!anim)
+		return true;
+	auto flags = m_stateFlags[idx];
+	if(umath::is_flag_set(flags, Player::StateFlags::Looping) || umath::is_flag_set(flags, Player::StateFlags::AnimationDirty))
+		return false;
+	auto rate = m_playbackRates[idx];
+	auto t = m_currentTimes[idx];
+	return (rate >= 0.f) ? (t >= anim->GetDuration()) : (t <= 0.f);
+}
+
+bool panima::PlayerPool::AdvancePlayer(uint32_t idx, float dt, bool force)
+{
+	// Same logic as Player::Advance
+	auto &anim = m_animations[idx];
+	if(!anim) {
+		m_updated[idx] = 0;
+		return false;
+	}
+	auto &flags = m_stateFlags[idx];
+	auto &currentTime = m_currentTimes[idx];
+	dt *= m_playbackRates[idx];
+	auto newTime = currentTime + dt;
+	auto dur = anim->GetDuration();
+	if(newTime > dur && umath::is_flag_set(flags, Player::StateFlags::Looping) && dur > 0.f)
+		newTime = fmodf(newTime, dur);
+	if(newTime == currentTime && !force && !umath::is_flag_set(flags, Player::StateFlags::AnimationDirty)) {
+		m_updated[idx] = 0;
+		return false;
+	}
+	umath::set_flag(flags, Player::StateFlags::AnimationDirty, false);
+	currentTime = newTime;
+	m_updated[idx] = 1;
+	if(m_poseCache) {
+		auto &poseTable = m_poseTables[idx];
+		if(!poseTable || !poseTable->IsUpToDate(*anim))
+			poseTable = m_poseCache->Get(*anim);
+		poseTable->Sample(currentTime, m_slices[idx]);
+		return true;
+	}
+	anim->Evaluate(currentTime, m_slices[idx], m_lastChannelTimestampIndices[idx], expression::EvaluationContext::GetThreadContext());
+	return true;
+}
+
+void panima::PlayerPool::PrepareAnimations()
+{
+	m_activeAnimations.clear();
+	m_activeAnimations.reserve(m_activeList.size());
+	for(auto idx : m_activeList) {
+		if(m_animations[idx])
+			m_activeAnimations.push_back(m_animations[idx].get());
+	}
+	std::sort(m_activeAnimations.begin(), m_activeAnimations.end());
+	m_activeAnimations.erase(std::unique(m_activeAnimations.begin(), m_activeAnimations.end()), m_activeAnimations.end());
+	for(auto *anim : m_activeAnimations) {
+		// Pending expressions would otherwise be compiled by whichever task evaluates them first (blocking all other tasks
+		// evaluating them in the meantime), and expressions set since the last graph update would be evaluated out of order
+		if(!anim->IsReady())
+			const_cast<Animation *>(anim)->Prefetch();
+	}
+}
+
+void panima::PlayerPool::Advance(float dt, const TaskExecutor &executor, uint32_t maxTasks)
+{
+	PrepareAnimations();
+	auto numActive = m_activeList.size();
+	std::atomic<size_t> nextIdx = 0;
+	auto work = [this, dt, numActive, &nextIdx]() {
+		for(;;) {
+			auto start = nextIdx.fetch_add(ADVANCE_CHUNK_SIZE, std::memory_order_relaxed);
+			if(start >= numActive)
+				break;
+			auto end = umath::min(start + ADVANCE_CHUNK_SIZE, numActive);
+			for(auto i = start; i < end; ++i) {
+				auto idx = m_activeList[i];
+				// Has to have been prepared by PrepareAnimations
+				assert(!m_animations[idx] || m_animations[idx]->IsReady());
+				AdvancePlayer(idx, dt, false);
+			}
+		}
+	};
+	auto numChunks = (numActive + ADVANCE_CHUNK_SIZE - 1) / ADVANCE_CHUNK_SIZE;
+	if(maxTasks == 0)
+		maxTasks = umath::max(std::thread::hardware_concurrency(), 1u);
+	// One of the tasks is executed by the calling thread
+	auto numTasks = umath::min(static_cast<size_t>(maxTasks), numChunks);
+	if(!executor || numTasks <= 1)
+		work();
+	else {
+		std::latch latch {static_cast<std::ptrdiff_t>(numTasks - 1)};
+		for(auto i = decltype(numTasks) {1u}; i < numTasks; ++i) {
+			executor([&work, &latch]() {
+				work();
+				latch.count_down();
+			});
+		}
+		work();
+		latch.wait();
+	}
+
+	for(auto i = numActive; i > 0; --i) {
+		auto idx = m_activeList[i - 1];
+		if(IsFinished(idx))
+			Deactivate(idx);
+	}
+}
+bool panima::PlayerPool::Advance(PlayerHandle handle, float dt, bool force)
+{
+	if(!IsValid(handle))
+		return false;
+	auto updated = AdvancePlayer(handle.index, dt, force);
+	if(IsFinished(handle.index))
+		Deactivate(handle.index);
+	return updated;
+}
+bool panima::PlayerPool::WasUpdated(PlayerHandle handle) const
+{
+	if(!IsValid(handle))
+		return false;
+	return m_updated[handle.index] != 0;
+}
+
+void panima::PlayerPool::SetPoseCache(const std::shared_ptr<PoseCache> &poseCache)
+{
+	m_poseCache = poseCache;
+	for(auto idx = decltype(m_poseTables.size()) {0u}; idx < m_poseTables.size(); ++idx) {
+		m_poseTables[idx] = nullptr;
+		if(m_alive[idx]) {
+			umath::set_flag(m_stateFlags[idx], Player::StateFlags::AnimationDirty, true);
+			Activate(static_cast<uint32_t>(idx));
+		}
+	}
+}
+
+void panima::PlayerPool::SetAnimation(PlayerHandle handle, const Animation &animation)
+{
+	if(!IsValid(handle))
+		return;
+	auto idx = handle.index;
+	Reset(handle);
+	m_animations[idx] = animation.shared_from_this();
+	auto &channels = animation.GetChannels();
+	auto &slice = m_slices[idx];
+	slice.channelValues.resize(channels.size());
+	for(auto i = decltype(channels.size()) {0u}; i < channels.size(); ++i) {
+		auto &prop = slice.channelValues[i];
+		auto type = channels[i]->GetValueType();
+		if(!prop || prop->type != type)
+			prop = udm::Property::Create(type);
+	}
+	m_lastChannelTimestampIndices[idx].resize(channels.size(), std::numeric_limits<uint32_t>::max());
+	Activate(idx);
+}
+const panima::Animation *panima::PlayerPool::GetAnimation(PlayerHandle handle) const
+{
+	if(!IsValid(handle))
+		return nullptr;
+	return m_animations[handle.index].get();
+}
+void panima::PlayerPool::Reset(PlayerHandle handle)
+{
+	if(!IsValid(handle))
+		return;
+	m_currentTimes[handle.index] = 0.f;
+	m_lastChannelTimestampIndices[handle.index].clear();
+	Activate(handle.index);
+}
+float panima::PlayerPool::GetDuration(PlayerHandle handle) const
+{
+	auto *anim = GetAnimation(handle);
+	return anim ? anim->GetDuration() : 0.f;
+}
+float panima::PlayerPool::GetCurrentTime(PlayerHandle handle) const
+{
+	if(!IsValid(handle))
+		return 0.f;
+	return m_currentTimes[handle.index];
+}
+void panima::PlayerPool::SetCurrentTime(PlayerHandle handle, float t, bool updateAnimation)
+{
+	if(!IsValid(handle))
+		return;
+	auto idx = handle.index;
+	if(t == m_currentTimes[idx])
+		return;
+	m_currentTimes[idx] = t;
+	Activate(idx);
+	if(updateAnimation == false) {
+		m_stateFlags[idx] |= Player::StateFlags::AnimationDirty;
+		return;
+	}
+	Advance(handle, 0.f, true);
+}
+float panima::PlayerPool::GetPlaybackRate(PlayerHandle handle) const
+{
+	if(!IsValid(handle))
+		return 0.f;
+	return m_playbackRates[handle.index];
+}
+void panima::PlayerPool::SetPlaybackRate(PlayerHandle handle, float playbackRate)
+{
+	if(!IsValid(handle))
+		return;
+	m_playbackRates[handle.index] = playbackRate;
+	Activate(handle.index);
+}
+void panima::PlayerPool::SetLooping(PlayerHandle handle, bool looping)
+{
+	if(!IsValid(handle))
+		return;
+	umath::set_flag(m_stateFlags[handle.index], Player::StateFlags::Looping, looping);
+	Activate(handle.index);
+}
+bool panima::PlayerPool::IsLooping(PlayerHandle handle) const
+{
+	if(!IsValid(handle))
+		return false;
+	return umath::is_flag_set(m_stateFlags[handle.index], Player::StateFlags::Looping);
+}
+void panima::PlayerPool::SetAnimationDirty(PlayerHandle handle)
+{
+	if(!IsValid(handle))
+		return;
+	umath::set_flag(m_stateFlags[handle.index], Player::StateFlags::AnimationDirty, true);
+	Activate(handle.index);
+}
+panima::Slice *panima::PlayerPool::GetCurrentSlice(PlayerHandle handle)
+{
+	if(!IsValid(handle))
+		return nullptr;
+	return &m_slices[handle.index];
+}
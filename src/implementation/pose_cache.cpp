@@ -0,0 +1,224 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <udm.hpp>
+#include <mathutil/uquat.h>
+#include <cstring>
+#include <cmath>
+#include <mutex>
+
+module panima;
+
+import :pose_cache;
+import :animation;
+import :channel;
+import :expression;
+import :types;
+
+std::shared_ptr<panima::PoseTable> panima::PoseTable::Create(const Animation &animation, float sampleRate)
+{
+	auto table = std::shared_ptr<PoseTable> {new PoseTable {}};
+	table->m_animation = &animation;
+	table->m_revision = animation.GetRevision();
+	table->m_sampleRate = sampleRate;
+	table->m_duration = animation.GetDuration();
+	table->m_frameCount = static_cast<uint32_t>(std::ceil(umath::max(table->m_duration, 0.f) * sampleRate)) + 1;
+
+	auto &channels = animation.GetChannels();
+	table->m_channels.reserve(channels.size());
+	for(auto &channel : channels) {
+		ChannelLayout layout {};
+		layout.type = channel->GetValueType();
+		udm::visit_ng(layout.type, [&layout, &table](auto tag) {
+			using T = typename decltype(tag)::type;
+			if constexpr(is_animatable_type(udm::type_to_enum<T>())) {
+				if constexpr(std::is_same_v<T, udm::Quaternion> || std::is_same_v<T, float> || std::is_same_v<T, udm::Vector2> || std::is_same_v<T, udm::Vector3> || std::is_same_v<T, udm::Vector4> || std::is_same_v<T, udm::EulerAngles>
+				  || std::is_same_v<T, udm::Mat4> || std::is_same_v<T, udm::Mat3x4>) {
+					layout.kind = std::is_same_v<T, udm::Quaternion> ? ValueKind::Quaternion : ValueKind::Float;
+					layout.numComponents = sizeof(T) / sizeof(float);
+					layout.size = sizeof(T);
+					layout.offset = table->m_floatsPerFrame;
+					table->m_floatsPerFrame += layout.numComponents;
+				}
+				else {
+					layout.kind = ValueKind::Raw;
+					layout.size = sizeof(T);
+					layout.offset = table->m_rawBytesPerFrame;
+					table->m_rawBytesPerFrame += layout.size;
+				}
+			}
+		});
+		table->m_channels.push_back(layout);
+	}
+	table->m_floatData.resize(static_cast<size_t>(table->m_floatsPerFrame) * table->m_frameCount);
+	table->m_rawData.resize(static_cast<size_t>(table->m_rawBytesPerFrame) * table->m_frameCount);
+
+	// Expressions are evaluated as well, so the table contains the final values
+	Slice slice;
+	std::vector<uint32_t> pivotTimeIndices;
+	expression::EvaluationContext context;
+	for(uint32_t frame = 0; frame < table->m_frameCount; ++frame) {
+		auto t = umath::min(frame / sampleRate, table->m_duration);
+		animation.Evaluate(t, slice, pivotTimeIndices, context);
+		auto *floatData = table->m_floatData.data() + static_cast<size_t>(frame) * table->m_floatsPerFrame;
+		auto *rawData = table->m_rawData.data() + static_cast<size_t>(frame) * table->m_rawBytesPerFrame;
+		for(auto i = decltype(table->m_channels.size()) {0u}; i < table->m_channels.size(); ++i) {
+			auto &layout = table->m_channels[i];
+			if(layout.size == 0)
+				continue;
+			auto *src = slice.channelValues[i]->value;
+			if(layout.kind == ValueKind::Raw)
+				memcpy(rawData + layout.offset, src, layout.size);
+			else
+				memcpy(floatData + layout.offset, src, layout.size);
+		}
+	}
+	return table;
+}
+
+void panima::PoseTable::Sample(float t, Slice &inOutSlice, const std::vector<uint8_t> *optChannelMask) const
+{
+	auto numChannels = m_channels.size();
+	inOutSlice.channelValues.resize(numChannels);
+	if(m_frameCount == 0)
+		return;
+	auto ft = umath::clamp(t, 0.f, umath::max(m_duration, 0.f)) * m_sampleRate;
+	auto frame0 = umath::min(static_cast<uint32_t>(ft), m_frameCount - 1);
+	auto frame1 = umath::min(frame0 + 1, m_frameCount - 1);
+	auto f = ft - static_cast<float>(frame0);
+	auto *floatData0 = m_floatData.data() + static_cast<size_t>(frame0) * m_floatsPerFrame;
+	auto *floatData1 = m_floatData.data() + static_cast<size_t>(frame1) * m_floatsPerFrame;
+	auto *rawData0 = m_rawData.data() + static_cast<size_t>(frame0) * m_rawBytesPerFrame;
+	for(auto i = decltype(numChannels) {0u}; i < numChannels; ++i) {
+		auto &layout = m_channels[i];
+		if(layout.size == 0)
+			continue;
+		auto &prop = inOutSlice.channelValues[i];
+		if(!prop || prop->type != layout.type)
+			prop = udm::Property::Create(layout.type);
+		if(optChannelMask && i < optChannelMask->size() && (*optChannelMask)[i] == 0)
+			continue;
+		switch(layout.kind) {
+		case ValueKind::Float:
+			{
+				auto *v0 = floatData0 + layout.offset;
+				auto *v1 = floatData1 + layout.offset;
+				auto *dst = static_cast<float *>(prop->value);
+				for(uint32_t c = 0; c < layout.numComponents; ++c)
+					dst[c] = v0[c] + f * (v1[c] - v0[c]);
+				break;
+			}
+		case ValueKind::Quaternion:
+			{
+				Quat q0, q1;
+				memcpy(&q0, floatData0 + layout.offset, sizeof(q0));
+				memcpy(&q1, floatData1 + layout.offset, sizeof(q1));
+				if(q0.w * q1.w + q0.x * q1.x + q0.y * q1.y + q0.z * q1.z < 0.f)
+					q1 = -q1;
+				auto q = glm::normalize(q0 * (1.f - f) + q1 * f);
+				memcpy(prop->value, &q, sizeof(q));
+				break;
+			}
+		case ValueKind::Raw:
+			memcpy(prop->value, rawData0 + layout.offset, layout.size);
+			break;
+		}
+	}
+}
+
+size_t panima::PoseTable::GetMemoryUsage() const { return sizeof(*this) + m_channels.capacity() * sizeof(ChannelLayout) + m_floatData.capacity() * sizeof(float) + m_rawData.capacity(); }
+
+std::shared_ptr<panima::PoseCache> panima::PoseCache::Create(size_t maxMemory, float sampleRate) { return std::shared_ptr<PoseCache> {new PoseCache {maxMemory, sampleRate}}; }
+panima::PoseCache::PoseCache(size_t maxMemory, float sampleRate) : m_maxMemory {maxMemory}, m_sampleRate {sampleRate} {}
+
+std::shared_ptr<const panima::PoseTable> panima::PoseCache::Get(const Animation &animation)
+{
+	std::unique_lock lock {m_mutex};
+	auto it = m_entryMap.find(&animation);
+	if(it != m_entryMap.end()) {
+		auto &entry = *it->second;
+		// The address may have been re-used by a different animation
+		if(entry.animation.lock().get() == &animation && entry.table->IsUpToDate(animation)) {
+			++m_stats.hits;
+			m_entries.splice(m_entries.begin(), m_entries, it->second);
+			return entry.table;
+		}
+		m_stats.memoryUsage -= entry.table->GetMemoryUsage();
+		m_entries.erase(it->second);
+		m_entryMap.erase(it);
+	}
+	++m_stats.misses;
+	auto sampleRate = m_sampleRate;
+	// Building the table can take a while, so other threads shouldn't be blocked in the meantime
+	lock.unlock();
+	std::shared_ptr<const PoseTable> table = PoseTable::Create(animation, sampleRate);
+	lock.lock();
+	if(sampleRate != m_sampleRate)
+		return table; // Sample rate has changed in the meantime, don't cache the outdated table
+	it = m_entryMap.find(&animation);
+	if(it != m_entryMap.end()) {
+		// Another thread was faster
+		m_stats.memoryUsage -= it->second->table->GetMemoryUsage();
+		m_entries.erase(it->second);
+		m_entryMap.erase(it);
+	}
+	m_entries.push_front({animation.shared_from_this(), table});
+	m_entryMap[&animation] = m_entries.begin();
+	m_stats.memoryUsage += table->GetMemoryUsage();
+	EvictToLimit();
+	return table;
+}
+
+void panima::PoseCache::EvictToLimit()
+{
+	// The most recently added table is never evicted
+	while(m_stats.memoryUsage > m_maxMemory && m_entries.size() > 1) {
+		auto &entry = m_entries.back();
+		m_stats.memoryUsage -= entry.table->GetMemoryUsage();
+		m_entryMap.erase(entry.table->m_animation);
+		m_entries.pop_back();
+		++m_stats.evictions;
+	}
+}
+
+void panima::PoseCache::Clear()
+{
+	std::scoped_lock lock {m_mutex};
+	m_entries.clear();
+	m_entryMap.clear();
+	m_stats.memoryUsage = 0;
+}
+
+void panima::PoseCache::SetMaxMemory(size_t maxMemory)
+{
+	std::scoped_lock lock {m_mutex};
+	m_maxMemory = maxMemory;
+	EvictToLimit();
+}
+void panima::PoseCache::SetSampleRate(float sampleRate)
+{
+	std::scoped_lock lock {m_mutex};
+	if(sampleRate == m_sampleRate)
+		return;
+	m_sampleRate = sampleRate;
+	m_entries.clear();
+	m_entryMap.clear();
+	m_stats.memoryUsage = 0;
+}
+
+panima::PoseCache::Stats panima::PoseCache::GetStats() const
+{
+	std::scoped_lock lock {m_mutex};
+	auto stats = m_stats;
+	stats.tableCount = static_cast<uint32_t>(m_entries.size());
+	return stats;
+}
+void panima::PoseCache::ResetStats()
+{
+	std::scoped_lock lock {m_mutex};
+	m_stats.hits = 0;
+	m_stats.misses = 0;
+	m_stats.evictions = 0;
+}
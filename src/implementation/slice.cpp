@@ -4,7 +4,296 @@
 module;
 
 #include <exprtk.hpp>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <mathutil/uquat.h>
+#include <udm.hpp>
 
 module panima;
 
 import :slice;
+import :types;
+
+void panima::Slice::CopyValues(const Slice &src, Slice &dst)
+{
+	auto n = src.channelValues.size();
+	dst.channelValues.resize(n);
+	for(auto i = decltype(n) {0u}; i < n; ++i) {
+		auto &propSrc = src.channelValues[i];
+		auto &propDst = dst.channelValues[i];
+		if(!propSrc) {
+			propDst = nullptr;
+			continue;
+		}
+		if(!propDst || propDst->type != propSrc->type || udm::is_non_trivial_type(propSrc->type)) {
+			propDst = propSrc->Copy(true);
+			continue;
+		}
+		memcpy(propDst->value, propSrc->value, udm::size_of_base_type(propSrc->type));
+	}
+}
+
+size_t panima::Slice::GetMemoryUsage() const
+{
+	auto size = sizeof(*this) + channelValues.capacity() * sizeof(udm::PProperty);
+	for(auto &prop : channelValues) {
+		if(prop)
+			size += sizeof(*prop) + udm::size_of_base_type(prop->type);
+	}
+	return size;
+}
+
+template<uint32_t N>
+static void lerp_values(float *const *dst, const float *const *src, size_t count, float f)
+{
+	for(size_t i = 0; i < count; ++i) {
+		auto *d = dst[i];
+		auto *s = src[i];
+		for(uint32_t c = 0; c < N; ++c)
+			d[c] = s[c] + f * (d[c] - s[c]);
+	}
+}
+static void lerp_values(float *const *dst, const float *const *src, size_t count, uint32_t numComponents, float f)
+{
+	for(size_t i = 0; i < count; ++i) {
+		auto *d = dst[i];
+		auto *s = src[i];
+		for(uint32_t c = 0; c < numComponents; ++c)
+			d[c] = s[c] + f * (d[c] - s[c]);
+	}
+}
+static void nlerp_values(Quat *const *dst, const Quat *const *src, size_t count, float f)
+{
+	for(size_t i = 0; i < count; ++i) {
+		auto &d = *dst[i];
+		auto &s = *src[i];
+		// Take the shortest path
+		auto dot = s.w * d.w + s.x * d.x + s.y * d.y + s.z * d.z;
+		auto fd = (dot < 0.f) ? -f : f;
+		auto fs = 1.f - f;
+		Quat q {s.w * fs + d.w * fd, s.x * fs + d.x * fd, s.y * fs + d.y * fd, s.z * fs + d.z * fd};
+		auto len = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+		if(len > 0.f) {
+			auto invLen = 1.f / len;
+			q.w *= invLen;
+			q.x *= invLen;
+			q.y *= invLen;
+			q.z *= invLen;
+		}
+		d = q;
+	}
+}
+template<uint32_t N>
+static void add_values(float *const *dst, const float *const *src, const float *const *reference, size_t count, float weight)
+{
+	for(size_t i = 0; i < count; ++i) {
+		auto *d = dst[i];
+		auto *s = src[i];
+		auto *r = reference[i];
+		for(uint32_t c = 0; c < N; ++c)
+			d[c] += weight * (s[c] - r[c]);
+	}
+}
+static void add_values(float *const *dst, const float *const *src, const float *const *reference, size_t count, uint32_t numComponents, float weight)
+{
+	for(size_t i = 0; i < count; ++i) {
+		auto *d = dst[i];
+		auto *s = src[i];
+		auto *r = reference[i];
+		for(uint32_t c = 0; c < numComponents; ++c)
+			d[c] += weight * (s[c] - r[c]);
+	}
+}
+static void add_values(Quat *const *dst, const Quat *const *src, const Quat *const *reference, size_t count, float weight)
+{
+	Quat identity {1.f, 0.f, 0.f, 0.f};
+	const Quat *pIdentity = &identity;
+	for(size_t i = 0; i < count; ++i) {
+		auto delta = glm::inverse(*reference[i]) * *src[i];
+		auto *pDelta = &delta;
+		nlerp_values(&pDelta, &pIdentity, 1, weight);
+		*dst[i] = *dst[i] * delta;
+	}
+}
+static void add_values(double *const *dst, const double *const *src, const double *const *reference, size_t count, double weight)
+{
+	for(size_t i = 0; i < count; ++i)
+		*dst[i] += weight * (*src[i] - *reference[i]);
+}
+static void lerp_values(double *const *dst, const double *const *src, size_t count, double f)
+{
+	for(size_t i = 0; i < count; ++i)
+		*dst[i] = *src[i] + f * (*dst[i] - *src[i]);
+}
+
+void panima::SliceBlendPlan::Clear()
+{
+	m_floatGroups.clear();
+	m_quatDst.clear();
+	m_quatSrc.clear();
+	m_quatReference.clear();
+	m_doubleDst.clear();
+	m_doubleSrc.clear();
+	m_doubleReference.clear();
+	m_stepValues.clear();
+	m_properties.clear();
+}
+
+size_t panima::SliceBlendPlan::GetMemoryUsage() const
+{
+	auto size = sizeof(*this) + m_floatGroups.capacity() * sizeof(FloatGroup);
+	for(auto &group : m_floatGroups)
+		size += (group.dst.capacity() + group.src.capacity() + group.reference.capacity()) * sizeof(float *);
+	size += (m_quatDst.capacity() + m_quatSrc.capacity() + m_quatReference.capacity()) * sizeof(Quat *);
+	size += (m_doubleDst.capacity() + m_doubleSrc.capacity() + m_doubleReference.capacity()) * sizeof(double *);
+	size += m_stepValues.capacity() * sizeof(StepValue) + m_properties.capacity() * sizeof(udm::PProperty);
+	return size;
+}
+
+void panima::SliceBlendPlan::Build(const Slice &src, Slice &dst, const std::vector<uint32_t> *dstToSrc, const Slice *reference)
+{
+	Clear();
+	auto n = dst.channelValues.size();
+	for(auto i = decltype(n) {0u}; i < n; ++i) {
+		auto iSrc = dstToSrc ? ((i < dstToSrc->size()) ? (*dstToSrc)[i] : INVALID_CHANNEL) : static_cast<uint32_t>(i);
+		if(iSrc >= src.channelValues.size())
+			continue;
+		auto &propDst = dst.channelValues[i];
+		auto &propSrc = src.channelValues[iSrc];
+		if(!propDst || !propSrc || propDst->type != propSrc->type || !is_animatable_type(propDst->type))
+			continue;
+		udm::PProperty propRef = nullptr;
+		if(reference) {
+			if(iSrc >= reference->channelValues.size())
+				continue;
+			propRef = reference->channelValues[iSrc];
+			if(!propRef || propRef->type != propSrc->type)
+				continue;
+			m_properties.push_back(propRef);
+		}
+		m_properties.push_back(propDst);
+		m_properties.push_back(propSrc);
+		udm::visit_ng(propDst->type, [this, &propDst, &propSrc, &propRef](auto tag) {
+			using T = typename decltype(tag)::type;
+			if constexpr(is_animatable_type(udm::type_to_enum<T>())) {
+				auto &vDst = propDst->template GetValue<T>();
+				auto &vSrc = propSrc->template GetValue<T>();
+				auto *vRef = propRef ? &propRef->template GetValue<T>() : nullptr;
+				if constexpr(std::is_same_v<T, udm::Quaternion>) {
+					m_quatDst.push_back(&vDst);
+					m_quatSrc.push_back(&vSrc);
+					if(vRef)
+						m_quatReference.push_back(vRef);
+				}
+				else if constexpr(std::is_same_v<T, double>) {
+					m_doubleDst.push_back(&vDst);
+					m_doubleSrc.push_back(&vSrc);
+					if(vRef)
+						m_doubleReference.push_back(vRef);
+				}
+				else if constexpr(std::is_same_v<T, float> || std::is_same_v<T, udm::Vector2> || std::is_same_v<T, udm::Vector3> || std::is_same_v<T, udm::Vector4> || std::is_same_v<T, udm::EulerAngles> || std::is_same_v<T, udm::Mat4>
+				  || std::is_same_v<T, udm::Mat3x4>) {
+					constexpr auto numComponents = udm::get_numeric_component_count(udm::type_to_enum<T>());
+					static_assert(sizeof(T) == numComponents * sizeof(float));
+					auto it = std::find_if(m_floatGroups.begin(), m_floatGroups.end(), [](const FloatGroup &group) { return group.numComponents == numComponents; });
+					if(it == m_floatGroups.end()) {
+						m_floatGroups.push_back({});
+						it = m_floatGroups.end() - 1;
+						it->numComponents = numComponents;
+					}
+					it->dst.push_back(reinterpret_cast<float *>(&vDst));
+					it->src.push_back(reinterpret_cast<const float *>(&vSrc));
+					if(vRef)
+						it->reference.push_back(reinterpret_cast<const float *>(vRef));
+				}
+				else
+					m_stepValues.push_back({&vDst, &vSrc, sizeof(T)});
+			}
+		});
+	}
+}
+
+void panima::SliceBlendPlan::Apply(float f) const
+{
+	if(f >= 1.f)
+		return;
+	if(f <= 0.f) {
+		// Plain copy, the destination values may not have been initialized yet
+		for(auto &group : m_floatGroups) {
+			auto size = group.numComponents * sizeof(float);
+			for(size_t i = 0; i < group.dst.size(); ++i)
+				memcpy(group.dst[i], group.src[i], size);
+		}
+		for(size_t i = 0; i < m_quatDst.size(); ++i)
+			*m_quatDst[i] = *m_quatSrc[i];
+		for(size_t i = 0; i < m_doubleDst.size(); ++i)
+			*m_doubleDst[i] = *m_doubleSrc[i];
+		for(auto &v : m_stepValues)
+			memcpy(v.dst, v.src, v.size);
+		return;
+	}
+	for(auto &group : m_floatGroups) {
+		auto *dst = group.dst.data();
+		auto *src = group.src.data();
+		auto count = group.dst.size();
+		switch(group.numComponents) {
+		case 1:
+			lerp_values<1>(dst, src, count, f);
+			break;
+		case 2:
+			lerp_values<2>(dst, src, count, f);
+			break;
+		case 3:
+			lerp_values<3>(dst, src, count, f);
+			break;
+		case 4:
+			lerp_values<4>(dst, src, count, f);
+			break;
+		default:
+			lerp_values(dst, src, count, group.numComponents, f);
+			break;
+		}
+	}
+	nlerp_values(m_quatDst.data(), m_quatSrc.data(), m_quatDst.size(), f);
+	lerp_values(m_doubleDst.data(), m_doubleSrc.data(), m_doubleDst.size(), static_cast<double>(f));
+	if(f < 0.5f) {
+		for(auto &v : m_stepValues)
+			memcpy(v.dst, v.src, v.size);
+	}
+}
+
+void panima::SliceBlendPlan::ApplyAdditive(float weight) const
+{
+	if(weight == 0.f)
+		return;
+	for(auto &group : m_floatGroups) {
+		if(group.reference.size() != group.dst.size())
+			continue;
+		auto *dst = group.dst.data();
+		auto *src = group.src.data();
+		auto *ref = group.reference.data();
+		auto count = group.dst.size();
+		switch(group.numComponents) {
+		case 1:
+			add_values<1>(dst, src, ref, count, weight);
+			break;
+		case 2:
+			add_values<2>(dst, src, ref, count, weight);
+			break;
+		case 3:
+			add_values<3>(dst, src, ref, count, weight);
+			break;
+		case 4:
+			add_values<4>(dst, src, ref, count, weight);
+			break;
+		default:
+			add_values(dst, src, ref, count, group.numComponents, weight);
+			break;
+		}
+	}
+	if(m_quatReference.size() == m_quatDst.size())
+		add_values(m_quatDst.data(), m_quatSrc.data(), m_quatReference.data(), m_quatDst.size(), weight);
+	if(m_doubleReference.size() == m_doubleDst.size())
+		add_values(m_doubleDst.data(), m_doubleSrc.data(), m_doubleReference.data(), m_doubleDst.size(), static_cast<double>(weight));
+}
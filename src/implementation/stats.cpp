@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <array>
+#include <atomic>
+
+module panima;
+
+import :stats;
+
+panima::SamplingStats &panima::SamplingStats::operator+=(const SamplingStats &other)
+{
+	for(size_t i = 0; i < counters.size(); ++i)
+		counters[i] += other.counters[i];
+	return *this;
+}
+
+panima::SamplingStats panima::SamplingCounters::Snapshot() const
+{
+	SamplingStats stats {};
+	for(size_t i = 0; i < m_counters.size(); ++i)
+		stats.counters[i] = m_counters[i].load(std::memory_order_relaxed);
+	return stats;
+}
+
+void panima::SamplingCounters::Reset()
+{
+	for(auto &counter : m_counters)
+		counter.store(0, std::memory_order_relaxed);
+}
+
+panima::SamplingCountersType &panima::get_global_sampling_counters()
+{
+	static SamplingCountersType counters {};
+	return counters;
+}
+panima::SamplingStats panima::get_global_sampling_stats() { return get_global_sampling_counters().Snapshot(); }
+void panima::reset_global_sampling_stats() { get_global_sampling_counters().Reset(); }
+
+panima::MemoryUsage &panima::MemoryUsage::operator+=(const MemoryUsage &other)
+{
+	compressedBytes += other.compressedBytes;
+	uncompressedBytes += other.uncompressedBytes;
+	expressionBytes += other.expressionBytes;
+	stringBytes += other.stringBytes;
+	derivedBytes += other.derivedBytes;
+	objectBytes += other.objectBytes;
+	sharedBytes += other.sharedBytes;
+	unknownCompressedArrays += other.unknownCompressedArrays;
+	return *this;
+}
@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <mathutil/umath.h>
+
+module panima;
+
+import :trace;
+
+static std::shared_ptr<panima::trace::TraceSink> g_sink = nullptr;
+
+std::atomic<panima::trace::TraceSink *> &panima::trace::detail::get_active_sink()
+{
+	static std::atomic<TraceSink *> sink = nullptr;
+	return sink;
+}
+void panima::trace::set_sink(const std::shared_ptr<TraceSink> &sink)
+{
+	detail::get_active_sink().store(sink.get(), std::memory_order_release);
+	g_sink = sink;
+}
+const std::shared_ptr<panima::trace::TraceSink> &panima::trace::get_sink() { return g_sink; }
+
+std::shared_ptr<panima::trace::ChromeTraceSink> panima::trace::ChromeTraceSink::Create(const std::string &fileName)
+{
+	auto *file = std::fopen(fileName.c_str(), "wb");
+	if(!file)
+		return nullptr;
+	return std::shared_ptr<ChromeTraceSink> {new ChromeTraceSink {file}};
+}
+panima::trace::ChromeTraceSink::ChromeTraceSink(std::FILE *file) : m_file {file} { m_buffer = "{\"traceEvents\":[\n"; }
+panima::trace::ChromeTraceSink::~ChromeTraceSink()
+{
+	m_buffer += "\n]}\n";
+	FlushUnlocked();
+	std::fclose(m_file);
+}
+void panima::trace::ChromeTraceSink::EndZone(const char *name, Clock::time_point start, Clock::time_point end)
+{
+	// Small sequential ids are easier to read in the trace viewer than hashed std::thread::ids
+	static std::atomic<uint32_t> nextThreadId = 1;
+	thread_local auto threadId = nextThreadId.fetch_add(1, std::memory_order_relaxed);
+	auto ts = std::chrono::duration<double, std::micro>(start.time_since_epoch()).count();
+	auto dur = std::chrono::duration<double, std::micro>(end - start).count();
+
+	// Buffered, so that writing an event only rarely involves file I/O
+	constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+	char event[256];
+	auto len = std::snprintf(event, sizeof(event), "{\"name\":\"%s\",\"cat\":\"panima\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}", name, ts, dur, threadId);
+	if(len <= 0)
+		return;
+	std::scoped_lock lock {m_mutex};
+	if(!m_firstEvent)
+		m_buffer += ",\n";
+	m_firstEvent = false;
+	m_buffer.append(event, umath::min(static_cast<size_t>(len), sizeof(event) - 1));
+	if(m_buffer.size() >= FLUSH_THRESHOLD)
+		FlushUnlocked();
+}
+void panima::trace::ChromeTraceSink::Flush()
+{
+	std::scoped_lock lock {m_mutex};
+	FlushUnlocked();
+	std::fflush(m_file);
+}
+void panima::trace::ChromeTraceSink::FlushUnlocked()
+{
+	std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+	m_buffer.clear();
+}
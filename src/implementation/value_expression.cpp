@@ -4,12 +4,21 @@
 module;
 
 #include <mathutil/color.h>
+#include <mathutil/perlin_noise.hpp>
+#include <atomic>
+#include <array>
+#include <cctype>
+#include <algorithm>
+#include <mutex>
+#include <unordered_set>
 #include <exprtk.hpp>
 #include <udm.hpp>
 
 module panima;
 
 import :expression;
+import :animation;
+import :trace;
 
 static constexpr auto VALUE_EPSILON = 0.001f;
 
@@ -17,8 +26,8 @@ panima::expression::ExprScalar panima::expression::ExprFuncPerlinNoise::operator
 template<typename T>
 panima::expression::ExprScalar panima::expression::ExprFuncValueAtArithmetic<T>::operator()(const ExprScalar &v)
 {
-	assert(m_valueExpression);
-	uint32_t pivotIndex = m_valueExpression->expr.timeIndex;
+	assert(m_valueExpression && m_timeIndex);
+	uint32_t pivotIndex = *m_timeIndex;
 	return m_valueExpression->channel.GetInterpolatedValue<T>(v, pivotIndex);
 }
 
@@ -29,8 +38,8 @@ panima::expression::ExprScalar panima::expression::ExprFuncValueAtVector<T>::ope
 	assert(parameters.size() == 2);
 	typename generic_type::scalar_view t {parameters[0]};
 	typename generic_type::vector_view out {parameters[1]};
-	assert(m_valueExpression);
-	uint32_t pivotIndex = m_valueExpression->expr.timeIndex;
+	assert(m_valueExpression && m_timeIndex);
+	uint32_t pivotIndex = *m_timeIndex;
 	auto n = udm::get_numeric_component_count(udm::type_to_enum<T>());
 	assert(out.size() == n);
 	if constexpr(std::is_same_v<udm::underlying_numeric_type<T>, ExprScalar>)
@@ -45,6 +54,141 @@ panima::expression::ExprScalar panima::expression::ExprFuncValueAtVector<T>::ope
 	return {};
 }
 
+std::optional<uint32_t> panima::expression::ExprFuncChannel::FindChannelIndex(const Animation &anim, const std::string_view &path)
+{
+	auto &channels = anim.GetChannels();
+	auto it = std::find_if(m_resolvedChannels.begin(), m_resolvedChannels.end(), [&path](const ResolvedChannel &resolved) { return resolved.path == path; });
+	// Layout revisions are unique across animations, so a matching revision also rules out a different animation at the same address.
+	// A resolved index is only used if it still refers to a channel with the same path, in case the path has been changed directly.
+	if(it != m_resolvedChannels.end() && it->animation == &anim && it->channelLayoutRevision == anim.GetChannelLayoutRevision()) {
+		if(!it->channelIndex)
+			return {}; // Unresolved references evaluate to 0
+		if(*it->channelIndex < channels.size() && channels[*it->channelIndex]->targetPath.GetId() == it->pathId)
+			return it->channelIndex;
+	}
+	if(it == m_resolvedChannels.end()) {
+		m_resolvedChannels.push_back({std::string {path}});
+		it = m_resolvedChannels.end() - 1;
+	}
+	it->animation = &anim;
+	it->channelLayoutRevision = anim.GetChannelLayoutRevision();
+	it->pathId = ChannelPathRegistry::Get().Find(it->path);
+	it->channelIndex = anim.FindChannelIndex(it->pathId);
+	return it->channelIndex;
+}
+
+panima::expression::ExprScalar panima::expression::ExprFuncChannel::operator()(exprtk::igeneric_function<ExprScalar>::parameter_list_t parameters)
+{
+	using generic_type = exprtk::igeneric_function<ExprScalar>::generic_type;
+	assert(m_valueExpression && m_time);
+	if(parameters.size() == 0 || parameters[0].type != generic_type::e_string)
+		return {};
+	typename generic_type::string_view pathView {parameters[0]};
+	std::string_view path {pathView.begin(), pathView.size()};
+	std::shared_ptr<const Channel> channelRef;
+	const Channel *channelPtr = nullptr;
+	const udm::Property *sliceValue = nullptr;
+	auto *anim = m_context ? m_context->GetAnimation() : nullptr;
+	if(anim) {
+		auto idx = FindChannelIndex(*anim, path);
+		if(!idx)
+			return {};
+		channelPtr = anim->GetChannels()[*idx].get();
+		auto *slice = m_context->GetSlice();
+		if(slice && *idx < slice->channelValues.size()) {
+			auto &prop = slice->channelValues[*idx];
+			if(prop && prop->type == channelPtr->GetValueType())
+				sliceValue = prop.get();
+		}
+	}
+	else {
+		auto *ref = m_valueExpression->FindChannelReference(path);
+		if(ref)
+			channelRef = ref->channel.lock();
+		if(!channelRef)
+			return {};
+		channelPtr = channelRef.get();
+	}
+	auto &channel = *channelPtr;
+	std::array<ExprScalar, 16> values {};
+	uint32_t numValues = 0;
+	udm::visit_ng(channel.GetValueType(), [&channel, sliceValue, &values, &numValues, this](auto tag) {
+		using T = typename decltype(tag)::type;
+		if constexpr(is_supported_expression_type_v<T> && is_animatable_type(udm::type_to_enum<T>())) {
+			// If the channel has already been evaluated this tick, we'll use its result, otherwise we fall back to sampling its
+			// animation data (without its own expression).
+			auto value = sliceValue ? const_cast<udm::Property *>(sliceValue)->GetValue<T>() : channel.GetInterpolatedValue<T>(*m_time);
+			if constexpr(std::is_same_v<T, bool>) {
+				values[0] = value ? ExprScalar {1} : ExprScalar {0};
+				numValues = 1;
+			}
+			else {
+				constexpr auto n = udm::get_numeric_component_count(udm::type_to_enum<T>());
+				static_assert(n <= std::tuple_size_v<std::remove_reference_t<decltype(values)>>);
+				for(auto c = decltype(n) {0u}; c < n; ++c)
+					values[c] = udm::get_numeric_component(value, c);
+				numValues = n;
+			}
+		}
+	});
+	if(parameters.size() > 1 && parameters[1].type == generic_type::e_vector) {
+		typename generic_type::vector_view out {parameters[1]};
+		auto n = umath::min(static_cast<size_t>(numValues), out.size());
+		for(auto i = decltype(n) {0u}; i < n; ++i)
+			out[i] = values[i];
+	}
+	return values[0];
+}
+
+panima::expression::ExprScalar panima::expression::ExprFuncAggregate::Evaluate(float tStart, float tEnd, uint32_t component) const
+{
+	auto &channel = m_valueExpression->channel;
+	switch(m_type) {
+	case Type::Average:
+		return static_cast<ExprScalar>(channel.GetAverage(tStart, tEnd, component).value_or(0.0));
+	case Type::Minimum:
+		return channel.GetMinimum(tStart, tEnd, component).value_or(0.f);
+	case Type::Maximum:
+		return channel.GetMaximum(tStart, tEnd, component).value_or(0.f);
+	case Type::Integral:
+		return static_cast<ExprScalar>(channel.GetIntegral(tStart, tEnd, component).value_or(0.0));
+	}
+	return {};
+}
+
+panima::expression::ExprScalar panima::expression::ExprFuncAggregate::operator()(exprtk::igeneric_function<ExprScalar>::parameter_list_t parameters)
+{
+	using generic_type = exprtk::igeneric_function<ExprScalar>::generic_type;
+	assert(m_valueExpression && m_time);
+	size_t numScalars = (m_type == Type::Integral) ? 2 : 1;
+	if(parameters.size() < numScalars)
+		return {};
+	std::array<ExprScalar, 2> args {};
+	for(size_t i = 0; i < numScalars; ++i) {
+		if(parameters[i].type != generic_type::e_scalar)
+			return {};
+		typename generic_type::scalar_view sv {parameters[i]};
+		args[i] = sv();
+	}
+	float tStart, tEnd;
+	if(m_type == Type::Integral) {
+		tStart = args[0];
+		tEnd = args[1];
+	}
+	else {
+		auto halfWindow = args[0] * 0.5f;
+		tStart = *m_time - halfWindow;
+		tEnd = *m_time + halfWindow;
+	}
+	if(parameters.size() > numScalars && parameters[numScalars].type == generic_type::e_vector) {
+		typename generic_type::vector_view out {parameters[numScalars]};
+		for(size_t i = 0; i < out.size(); ++i)
+			out[i] = Evaluate(tStart, tEnd, i);
+		return (out.size() > 0) ? out[0] : ExprScalar {};
+	}
+	return Evaluate(tStart, tEnd, 0);
+}
+
 static panima::expression::ExprScalar ramp(const panima::expression::ExprScalar &x, const panima::expression::ExprScalar &a, const panima::expression::ExprScalar &b)
 {
 	if(a == b)
@@ -86,15 +230,11 @@ namespace panima::expression {
 		return ExprScalar {};
 	}
 
-	extern exprtk::symbol_table<ExprScalar> &get_quaternion_symbol_table();
-	static exprtk::symbol_table<ExprScalar> &get_base_symbol_table()
+	extern void add_quaternion_functions(exprtk::symbol_table<ExprScalar> &symTable);
+	// Note: exprtk symbol tables are reference counted without synchronization, so they must not be shared
+	// between expressions that may be compiled or evaluated on different threads.
+	static void add_base_functions(exprtk::symbol_table<ExprScalar> &symTable)
 	{
-		static exprtk::symbol_table<panima::expression::ExprScalar> symTable;
-		static auto initialized = false;
-		if(initialized)
-			return symTable;
-		initialized = true;
-
 		static ExprFuncGeneric1Param<ExprScalar, sqr> f_sqr {};
 		static ExprFuncGeneric3Param<ExprScalar, ramp> f_ramp {};
 		static ExprFuncGeneric3Param<ExprScalar, cramp> f_cramp {};
@@ -122,73 +262,277 @@ namespace panima::expression {
 		symTable.add_function("print", f_print);
 
 		symTable.add_constants();
-		return symTable;
 	}
 };
 
-bool panima::expression::ValueExpression::Initialize(udm::Type type, std::string &outErr)
+static std::atomic<uint64_t> g_nextExpressionId = 1;
+
+// Ids of all expressions that are still alive, so that evaluation contexts can release the states of destroyed expressions.
+// Intentionally leaked, since expressions may still be destroyed during static destruction.
+struct LiveExpressionRegistry {
+	std::mutex mutex;
+	std::unordered_set<uint64_t> ids;
+	std::atomic<uint64_t> numReleased = 0;
+};
+static LiveExpressionRegistry &get_live_expressions()
+{
+	static auto *registry = new LiveExpressionRegistry {};
+	return *registry;
+}
+static uint64_t register_expression()
+{
+	auto id = g_nextExpressionId++;
+	auto &live = get_live_expressions();
+	std::scoped_lock lock {live.mutex};
+	live.ids.insert(id);
+	return id;
+}
+
+panima::expression::ValueExpression::ValueExpression(Channel &channel) : channel {channel}, expr {static_cast<uint32_t>(umath::random(std::numeric_limits<int>::lowest(), std::numeric_limits<int>::max()))}, m_id {register_expression()} {}
+
+bool panima::expression::ValueExpression::InitializeState(State &state, exprtk::parser<ExprScalar> &parser, std::string &outErr) const
 {
-	auto success = udm::visit_ng(type, [this](auto tag) {
+	trace::Zone zone {"panima::ValueExpression::Compile"};
+	auto success = udm::visit_ng(m_type, [this, &state](auto tag) {
 		using T = typename decltype(tag)::type;
 		if constexpr(!is_supported_expression_type_v<T>)
 			return false;
 		else {
 			using TExpr = TExprType<T>;
 			if constexpr(std::is_same_v<TExpr, Single>) {
-				expr.value = Single {0};
-				auto &v = std::get<Single>(expr.value);
-				expr.symbolTable.add_variable("value", v[0]);
+				state.value = Single {0};
+				auto &v = std::get<Single>(state.value);
+				state.symbolTable.add_variable("value", v[0]);
 
 				auto valueAt = std::make_unique<ExprFuncValueAtArithmetic<T>>();
-				expr.symbolTable.add_function("value_at", *valueAt);
-				expr.f_valueAt = std::move(valueAt);
+				state.symbolTable.add_function("value_at", *valueAt);
+				state.f_valueAt = std::move(valueAt);
 			}
 			else {
-				expr.value = TExpr {};
-				auto &v = std::get<TExpr>(expr.value);
-				expr.symbolTable.add_vector("value", v.data(), v.size());
+				state.value = TExpr {};
+				auto &v = std::get<TExpr>(state.value);
+				state.symbolTable.add_vector("value", v.data(), v.size());
 
 				auto valueAt = std::make_unique<ExprFuncValueAtVector<T>>();
-				expr.symbolTable.add_function("value_at", *valueAt);
-				expr.f_valueAt = std::move(valueAt);
+				state.symbolTable.add_function("value_at", *valueAt);
+				state.f_valueAt = std::move(valueAt);
 			}
 			return true;
 		}
 	});
 	if(!success) {
-		outErr = "Unsupported type '" + std::string {magic_enum::enum_name(type)} + "'!";
+		outErr = "Unsupported type '" + std::string {magic_enum::enum_name(m_type)} + "'!";
 		return false;
 	}
-	m_type = type;
 
-	expr.symbolTable.add_variable("time", expr.time);
-	expr.symbolTable.add_variable("timeIndex", expr.timeIndex);
+	state.symbolTable.add_variable("time", state.time);
+	state.symbolTable.add_variable("timeIndex", state.timeIndex);
 
-	expr.symbolTable.add_variable("startOffset", expr.startOffset);
-	expr.symbolTable.add_variable("timeScale", expr.timeScale);
-	expr.symbolTable.add_variable("duration", expr.duration);
+	state.symbolTable.add_variable("startOffset", state.startOffset);
+	state.symbolTable.add_variable("timeScale", state.timeScale);
+	state.symbolTable.add_variable("duration", state.duration);
 
-	assert(expr.f_valueAt != nullptr);
-	expr.f_valueAt->SetValueExpression(*this);
+	assert(state.f_valueAt != nullptr);
+	state.f_valueAt->SetValueExpression(const_cast<ValueExpression &>(*this), state.timeIndex);
 
-	expr.symbolTable.add_function("noise", expr.f_perlinNoise);
+	state.symbolTable.add_function("noise", state.f_perlinNoise);
 
-	expr.expression.register_symbol_table(get_base_symbol_table());
-	expr.expression.register_symbol_table(get_quaternion_symbol_table());
-	expr.expression.register_symbol_table(expr.symbolTable);
-	if(expr.parser.compile(expression, expr.expression) == false) {
-		outErr = expr.parser.error();
+	state.f_channel.SetValueExpression(const_cast<ValueExpression &>(*this), state.time, state.context);
+	state.symbolTable.add_function("channel", state.f_channel);
+
+	for(auto *f : {&state.f_windowAvg, &state.f_windowMin, &state.f_windowMax, &state.f_integral})
+		f->SetValueExpression(const_cast<ValueExpression &>(*this), state.time);
+	state.symbolTable.add_function("window_avg", state.f_windowAvg);
+	state.symbolTable.add_function("window_min", state.f_windowMin);
+	state.symbolTable.add_function("window_max", state.f_windowMax);
+	state.symbolTable.add_function("integral", state.f_integral);
+
+	add_base_functions(state.symbolTable);
+	add_quaternion_functions(state.symbolTable);
+	state.expression.register_symbol_table(state.symbolTable);
+	if(parser.compile(expression, state.expression) == false) {
+		outErr = parser.error();
 		return false;
 	}
 	return true;
 }
 
-panima::expression::ValueExpression::ValueExpression(const ValueExpression &other) : ValueExpression {other.channel}
+bool panima::expression::ValueExpression::Initialize(udm::Type type, std::string &outErr)
+{
+	InitializeDeferred(type);
+	std::string err;
+	auto res = Compile(&err);
+	if(!res)
+		outErr = std::move(err);
+	return res;
+}
+
+void panima::expression::ValueExpression::InitializeDeferred(udm::Type type)
 {
-	expression = other.expression;
-	m_type = other.m_type;
+	m_type = type;
+	m_compileState = CompileState::Pending;
+}
+
+static std::mutex g_compileErrorHandlerMutex;
+static panima::expression::CompileErrorHandler g_compileErrorHandler;
+void panima::expression::set_compile_error_handler(CompileErrorHandler handler)
+{
+	std::scoped_lock lock {g_compileErrorHandlerMutex};
+	g_compileErrorHandler = std::move(handler);
+}
+static void report_compile_error(const panima::expression::ValueExpression &expr, const std::string &err)
+{
+	panima::expression::CompileErrorHandler handler;
+	{
+		std::scoped_lock lock {g_compileErrorHandlerMutex};
+		handler = g_compileErrorHandler;
+	}
+	if(handler)
+		handler(expr, err);
+}
+
+bool panima::expression::ValueExpression::Compile(std::string *optOutErr)
+{
+	auto state = GetCompileState();
+	if(state == CompileState::Pending) {
+		std::scoped_lock lock {m_compileMutex};
+		state = GetCompileState();
+		if(state == CompileState::Pending) {
+			std::string err;
+			state = InitializeState(expr, parser, err) ? CompileState::Compiled : CompileState::Failed;
+			if(state == CompileState::Failed)
+				m_compileError = std::move(err);
+			m_compileState.store(state, std::memory_order_release);
+			if(state == CompileState::Failed)
+				report_compile_error(*this, m_compileError);
+		}
+	}
+	if(state == CompileState::Failed && optOutErr)
+		*optOutErr = m_compileError;
+	return state == CompileState::Compiled;
+}
+
+panima::expression::EvaluationContext &panima::expression::EvaluationContext::GetThreadContext()
+{
+	static thread_local EvaluationContext context;
+	return context;
+}
+
+void panima::expression::EvaluationContext::ReleaseStaleStates()
+{
+	auto &live = get_live_expressions();
+	auto numReleased = live.numReleased.load(std::memory_order_acquire);
+	if(numReleased == m_numReleasedExpressions)
+		return;
+	m_numReleasedExpressions = numReleased;
+	std::scoped_lock lock {live.mutex};
+	std::erase_if(m_states, [&live](const auto &pair) { return !live.ids.contains(pair.first); });
+}
+
+panima::expression::ValueExpression::State *panima::expression::ValueExpression::GetState(EvaluationContext &context) const
+{
+	auto it = context.m_states.find(m_id);
+	if(it != context.m_states.end())
+		return it->second.get();
+	if(!IsCompiled())
+		return nullptr;
+	// Every new expression passes through here, so releasing the states of destroyed ones here keeps the context bounded
+	context.ReleaseStaleStates();
+	// First evaluation with this context, the expression has to be compiled for it
+	auto state = std::make_unique<State>(expr.noiseSeed);
+	state->context = &context;
+	exprtk::parser<ExprScalar> localParser;
 	std::string err;
-	Initialize(other.m_type, err);
+	if(!InitializeState(*state, localParser, err))
+		state = nullptr;
+	return context.m_states.emplace(m_id, std::move(state)).first->second.get();
 }
 
-panima::expression::ValueExpression::~ValueExpression() { expr.f_valueAt = nullptr; }
+size_t panima::expression::ValueExpression::GetStateMemoryUsage(const State &state)
+{
+	// Rough estimate of a symbol table entry (name and variable or function node)
+	constexpr size_t SYMBOL_SIZE_ESTIMATE = 64;
+	size_t size = state.f_channel.GetMemoryUsage();
+	auto &symbolTable = state.symbolTable;
+	if(symbolTable.valid())
+		size += (symbolTable.variable_count() + symbolTable.function_count() + symbolTable.vector_count()) * SYMBOL_SIZE_ESTIMATE;
+	return size;
+}
+
+size_t panima::expression::ValueExpression::GetMemoryUsage() const
+{
+	// The own state is part of the object itself
+	auto size = sizeof(*this) + expression.capacity() + m_compileError.capacity() + m_channelReferences.capacity() * sizeof(ChannelReference);
+	for(auto &ref : m_channelReferences)
+		size += ref.path.capacity();
+	size += GetStateMemoryUsage(expr);
+	return size;
+}
+
+size_t panima::expression::EvaluationContext::GetMemoryUsage() const
+{
+	auto size = sizeof(*this) + m_states.bucket_count() * sizeof(void *) + m_states.size() * sizeof(decltype(m_states)::value_type);
+	for(auto &[id, state] : m_states) {
+		if(state)
+			size += sizeof(ValueExpression::State) + ValueExpression::GetStateMemoryUsage(*state);
+	}
+	return size;
+}
+
+std::vector<std::string> panima::expression::ValueExpression::FindChannelReferencePaths() const
+{
+	constexpr std::string_view identifier = "channel";
+	std::vector<std::string> paths;
+	auto isIdentifierChar = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+	auto skipWhitespace = [this](size_t pos) {
+		while(pos < expression.size() && std::isspace(static_cast<unsigned char>(expression[pos])))
+			++pos;
+		return pos;
+	};
+	size_t pos = 0;
+	while((pos = expression.find(identifier, pos)) != std::string::npos) {
+		auto start = pos;
+		pos += identifier.size();
+		if((start > 0 && isIdentifierChar(expression[start - 1])) || (pos < expression.size() && isIdentifierChar(expression[pos])))
+			continue;
+		pos = skipWhitespace(pos);
+		if(pos >= expression.size() || expression[pos] != '(')
+			continue;
+		pos = skipWhitespace(pos + 1);
+		if(pos >= expression.size() || expression[pos] != '\'')
+			continue;
+		auto end = expression.find('\'', pos + 1);
+		if(end == std::string::npos)
+			break;
+		paths.push_back(expression.substr(pos + 1, end - (pos + 1)));
+		pos = end + 1;
+	}
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+	return paths;
+}
+
+const panima::expression::ValueExpression::ChannelReference *panima::expression::ValueExpression::FindChannelReference(const std::string_view &path) const
+{
+	auto it = std::find_if(m_channelReferences.begin(), m_channelReferences.end(), [&path](const ChannelReference &ref) { return ref.path == path; });
+	return (it != m_channelReferences.end()) ? &*it : nullptr;
+}
+
+panima::expression::ValueExpression::ValueExpression(const ValueExpression &other) : channel {other.channel}, expr {other.expr.noiseSeed}, m_id {register_expression()}
+{
+	expression = other.expression;
+	m_channelReferences = other.m_channelReferences;
+	InitializeDeferred(other.m_type);
+	if(other.GetCompileState() != CompileState::Pending)
+		Compile();
+}
+
+panima::expression::ValueExpression::~ValueExpression()
+{
+	expr.f_valueAt = nullptr;
+	// The states in the evaluation contexts are released lazily by the threads owning them (see EvaluationContext::ReleaseStaleStates)
+	auto &live = get_live_expressions();
+	std::scoped_lock lock {live.mutex};
+	live.ids.erase(m_id);
+	live.numReleased.fetch_add(1, std::memory_order_release);
+}
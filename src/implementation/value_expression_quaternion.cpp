@@ -228,14 +228,8 @@ namespace panima::expression {
 		return uquat::length(q);
 	}
 
-	exprtk::symbol_table<ExprScalar> &get_quaternion_symbol_table()
+	void add_quaternion_functions(exprtk::symbol_table<ExprScalar> &symTable)
 	{
-		static exprtk::symbol_table<panima::expression::ExprScalar> symTable;
-		static auto initialized = false;
-		if(initialized)
-			return symTable;
-		initialized = true;
-
 		static_assert(std::is_same_v<ExprScalar, Quat::value_type> && std::is_same_v<ExprScalar, ::Vector3::value_type>);
 		static ExprFuncGeneric<ExprScalar, q_from_axis_angle> f_q_from_axis_angle {};
 		static ExprFuncGeneric<ExprScalar, q_from_euler_angles> f_q_from_euler_angles {};
@@ -262,6 +256,5 @@ namespace panima::expression {
 		symTable.add_function("q_mul", f_q_mul);
 		symTable.add_function("q_inverse", f_q_inverse);
 		symTable.add_function("q_length", f_q_length);
-		return symTable;
 	}
 };
@@ -7,32 +7,107 @@ module;
 #include <memory>
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <optional>
+#include <functional>
+#include <atomic>
 #include <mathutil/umath.h>
 #include <udm.hpp>
 
 export module panima:animation;
 
 import :channel;
+import :slice;
+import :stats;
+import :types;
 
 export namespace panima {
+	class AnimationSnapshot;
 	class Animation : public std::enable_shared_from_this<Animation> {
 	  public:
 		enum class Flags : uint32_t { None = 0u, LoopBit = 1u };
 		Animation() = default;
 		void AddChannel(Channel &channel);
 		Channel *AddChannel(std::string path, udm::Type valueType);
+		Channel *AddChannel(const ChannelPath &path, udm::Type valueType);
 		void RemoveChannel(std::string path);
 		void RemoveChannel(const Channel &channel);
 		const std::vector<std::shared_ptr<Channel>> &GetChannels() const { return const_cast<Animation *>(this)->GetChannels(); }
+		// InvalidateChannelIndex has to be called if channels are added, removed or replaced through this vector directly, or renamed without Channel::SetTargetPath
 		std::vector<std::shared_ptr<Channel>> &GetChannels() { return m_channels; }
+		void InvalidateChannelIndex();
+		// Changes whenever channels are added, removed, replaced or renamed (see Channel::SetTargetPath). Revisions are unique across all animations.
+		uint32_t GetChannelLayoutRevision() const { return m_revisions->channelLayoutRevision.load(std::memory_order_relaxed); }
+		// Changes whenever the channel layout or the duration changes, or any of the channels is modified (see Channel::IncrementRevision)
+		uint64_t GetRevision() const { return m_revisions->revision.load(std::memory_order_relaxed); }
 		uint32_t GetChannelCount() const { return m_channels.size(); }
 		void Merge(const Animation &other);
 
 		bool Save(udm::LinkedPropertyWrapper &prop) const;
 		bool Load(udm::LinkedPropertyWrapper &prop);
 
-		Channel *FindChannel(std::string path);
-		const Channel *FindChannel(std::string path) const { return const_cast<Animation *>(this)->FindChannel(std::move(path)); }
+		// Called on the saving thread after the key arrays of each channel have been compressed (in channel order)
+		using SaveProgressCallback = std::function<void(uint32_t numChannelsCompressed, uint32_t numChannels)>;
+		// Same as above, but the key arrays of all channels are compressed concurrently in tasks of the executor first, which is where
+		// most of the time is spent. The udm data is then assembled in channel order on the calling thread, so the result is identical to
+		// the serial version. The channels must not be modified until the function has returned.
+		bool Save(udm::LinkedPropertyWrapper &prop, const TaskExecutor &executor, const SaveProgressCallback &progressCallback = nullptr) const;
+
+		// Incremental saving: SaveChanges only writes the channels that have been added or modified since the baseline snapshot was taken
+		// (usually right after the last save or load, see CreateSnapshot), unchanged channels are stored as a reference to their index in the baseline.
+		// ApplyChanges applies such an entry to the state the baseline was taken of, so a full save followed by every subsequent entry
+		// (in order, each against a snapshot taken after applying the previous one) restores the current state (see AnimationJournal).
+		// A channel counts as modified if its revision (see Channel::GetRevision), interpolation, target path or value expression has changed.
+		// None of these functions modify the baseline, the caller decides when to take a new snapshot.
+		AnimationSnapshot CreateSnapshot() const;
+		bool SaveChanges(udm::LinkedPropertyWrapper &prop, const AnimationSnapshot &baseline) const;
+		// All written channels are loaded into new channel objects before any of them replace the channels of the animation, so the
+		// animation remains unchanged if the entry can't be applied, and channels that are also referenced elsewhere are never modified.
+		bool ApplyChanges(udm::LinkedPropertyWrapper &prop, const AnimationSnapshot &baseline);
+		bool HasUnsavedChanges(const AnimationSnapshot &baseline) const;
+		// Number of channels SaveChanges would write
+		uint32_t GetModifiedChannelCount(const AnimationSnapshot &baseline) const;
+
+		// Compiles all value expressions that are still pending. If an executor is specified, each expression is compiled
+		// in a separate task, otherwise they are compiled immediately. Returns the number of expressions that were scheduled.
+		uint32_t PrecompileExpressions(const TaskExecutor &executor = nullptr);
+		// Prefetches all channels (see Channel::Prefetch) and resolves the expression graph, so that the first evaluation
+		// doesn't have to do any additional work. The animation must not be modified or evaluated while this is running.
+		void Prefetch();
+		bool IsReady() const;
+
+		// Resolves the channel('path') references of all value expressions and determines the order in which the
+		// expression channels have to be evaluated, so that every channel is evaluated before the channels referencing it.
+		// Load and ApplyChanges call this automatically. Functions that add, remove or replace individual channels (including InvalidateChannelIndex)
+		// don't, so that building an animation channel by channel stays linear; the graph is rebuilt by Prefetch (see IsReady) or by calling this directly.
+		// Evaluate never rebuilds it: expressions that aren't part of the current graph (because their channel has been added, moved or
+		// had its expression set or replaced since) are still applied, but after all other expressions, in channel order.
+		// Channels that are part of a dependency cycle are evaluated last and are returned in optOutCyclicChannels,
+		// the function returns false if there are any.
+		bool UpdateExpressionGraph(std::vector<uint32_t> *optOutCyclicChannels = nullptr);
+		const std::vector<uint32_t> &GetExpressionEvaluationOrder() const { return m_expressionEvaluationOrder; }
+		// True if channels have been added, removed or moved, or the value expression of any channel has been set, replaced or cleared,
+		// since the last UpdateExpressionGraph
+		bool IsExpressionGraphDirty() const;
+		// Samples all channels at the specified time into the slice and applies the value expressions in dependency order.
+		// Each channel is evaluated exactly once, expressions referencing other channels read their results from the slice.
+		// If a channel mask is specified, channels with a mask value of 0 are skipped and keep their previous value in the slice.
+		// If optOutChangedChannels is specified, the indices of all channels whose value has changed are appended to it (unsorted).
+		// In that case channels are only re-sampled once the time leaves the span of constant keys they were last sampled in
+		// (see Channel::IsInConstantSpan), and channels with value expressions are always considered changed.
+		void Evaluate(double t, Slice &inOutSlice, std::vector<uint32_t> &inOutPivotTimeIndices, expression::EvaluationContext &context, const std::vector<uint8_t> *optChannelMask = nullptr,
+		  std::vector<uint32_t> *optOutChangedChannels = nullptr) const;
+
+		// Lookups are thread-safe, as long as the animation isn't modified at the same time. Paths that aren't part of the animation are
+		// rejected in constant time, unless a channel has been renamed since the last modification of the animation, in which case
+		// lookups fall back to a linear search until the index has been rebuilt by the next function that adds or removes channels.
+		Channel *FindChannel(const std::string &path) { return FindChannel(ChannelPathRegistry::Get().Find(path)); }
+		const Channel *FindChannel(const std::string &path) const { return const_cast<Animation *>(this)->FindChannel(path); }
+		Channel *FindChannel(const ChannelPath &path) { return FindChannel(path.GetId()); }
+		const Channel *FindChannel(const ChannelPath &path) const { return FindChannel(path.GetId()); }
+		Channel *FindChannel(ChannelPathId pathId);
+		const Channel *FindChannel(ChannelPathId pathId) const { return const_cast<Animation *>(this)->FindChannel(pathId); }
+		std::optional<uint32_t> FindChannelIndex(ChannelPathId pathId) const;
 
 		float GetAnimationSpeedFactor() const { return m_speedFactor; }
 		void SetAnimationSpeedFactor(float f) { m_speedFactor = f; }
@@ -44,18 +119,61 @@ export namespace panima {
 		bool HasFlags(Flags flags) const { return umath::is_flag_set(m_flags, flags); }
 
 		float GetDuration() const { return m_duration; }
-		void SetDuration(float duration) { m_duration = duration; }
+		void SetDuration(float duration)
+		{
+			m_duration = duration;
+			IncrementRevision();
+		}
+
+		// Includes the memory of all channels. Channels that are also referenced outside of this animation are counted as shared.
+		MemoryUsage GetMemoryUsage() const;
 
 		bool operator==(const Animation &other) const { return this == &other; }
 		bool operator!=(const Animation &other) const { return !operator==(other); }
 	  private:
-		std::vector<std::shared_ptr<Channel>>::iterator FindChannelIt(std::string path);
+		void UpdateChannelIndex();
+		bool IsChannelIndexUpToDate() const;
+		void EnsureChannelIndex();
+		void IncrementRevision() { m_revisions->revision.fetch_add(1, std::memory_order_relaxed); }
+		void IncrementChannelLayoutRevision();
 		std::vector<std::shared_ptr<Channel>> m_channels;
+		// Channel path id to channel index, up to date if the layout revision hasn't changed since it was last updated
+		std::unordered_map<ChannelPathId, uint32_t> m_channelIndex;
+		uint32_t m_indexedChannelLayoutRevision = 0;
+		// Shared with the channels, which increment them whenever they're modified or renamed
+		std::shared_ptr<Channel::AnimationRevisions> m_revisions = std::make_shared<Channel::AnimationRevisions>();
+		std::vector<uint32_t> m_expressionEvaluationOrder;
+		// Id of the value expression of every channel at the time of the last UpdateExpressionGraph (0 if there was none)
+		std::vector<uint64_t> m_graphExpressionIds;
 		std::string m_name;
 		float m_speedFactor = 1.f;
 		float m_duration = 0.f;
 		Flags m_flags = Flags::None;
 	};
+
+	// State of an animation at a specific point in time, which incremental saves are relative to (see Animation::SaveChanges).
+	// Only the channel objects and their revisions are referenced, no key data is copied.
+	class AnimationSnapshot {
+	  public:
+		AnimationSnapshot() = default;
+		uint32_t GetChannelCount() const { return static_cast<uint32_t>(m_channels.size()); }
+	  private:
+		friend Animation;
+		struct ChannelState {
+			std::weak_ptr<Channel> channel;
+			uint32_t revision = 0;
+			ChannelInterpolation interpolation = ChannelInterpolation::Linear;
+			ChannelPathId targetPathId = INVALID_CHANNEL_PATH_ID;
+			std::optional<std::string> expression;
+			bool IsModified(const Channel &channel) const;
+		};
+		// Channel to its index in the snapshot, for all channels that are still alive
+		std::unordered_map<const Channel *, uint32_t> GetChannelIndices() const;
+		std::vector<ChannelState> m_channels;
+		float m_speedFactor = 1.f;
+		float m_duration = 0.f;
+		Animation::Flags m_flags = Animation::Flags::None;
+	};
 };
 
 export
@@ -0,0 +1,71 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <limits>
+#include <optional>
+
+export module panima:animation_binding;
+
+import :animation;
+import :channel;
+
+export namespace panima {
+	class AnimationTargetSchema;
+	// Maps the channels of an animation to the slots of a target schema. Bindings are immutable, and
+	// are shared between all players that play the same animation on the same schema (see AnimationTargetSchema::GetBinding).
+	class AnimationBinding {
+	  public:
+		static constexpr auto INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+		static std::shared_ptr<AnimationBinding> Create(const Animation &animation, const AnimationTargetSchema &schema);
+
+		// Returns INVALID_INDEX if the channel isn't bound to a slot
+		uint32_t GetSlot(uint32_t channelIndex) const { return (channelIndex < m_channelToSlot.size()) ? m_channelToSlot[channelIndex] : INVALID_INDEX; }
+		// Returns INVALID_INDEX if the animation has no channel for the slot
+		uint32_t GetChannel(uint32_t slot) const { return (slot < m_slotToChannel.size()) ? m_slotToChannel[slot] : INVALID_INDEX; }
+		const std::vector<uint32_t> &GetChannelToSlot() const { return m_channelToSlot; }
+		const std::vector<uint32_t> &GetSlotToChannel() const { return m_slotToChannel; }
+		// 1 for every channel that has to be evaluated for the bound slots, including channels referenced by value expressions
+		const std::vector<uint8_t> &GetChannelMask() const { return m_channelMask; }
+		// False if the channel layout of the animation has changed since the binding was created
+		bool IsValid(const Animation &animation) const { return &animation == m_animation && animation.GetChannelLayoutRevision() == m_animationRevision; }
+	  private:
+		friend AnimationTargetSchema;
+		AnimationBinding() = default;
+		const Animation *m_animation = nullptr;
+		// Only set if the animation is owned by a shared pointer
+		std::weak_ptr<const Animation> m_animationRef;
+		bool m_hasAnimationRef = false;
+		uint32_t m_animationRevision = 0;
+		std::vector<uint32_t> m_channelToSlot;
+		std::vector<uint32_t> m_slotToChannel;
+		std::vector<uint8_t> m_channelMask;
+	};
+
+	// A fixed set of target paths (e.g. the animatable properties of an entity type), each of which is assigned a dense slot index.
+	class AnimationTargetSchema : public std::enable_shared_from_this<AnimationTargetSchema> {
+	  public:
+		static std::shared_ptr<AnimationTargetSchema> Create(const std::vector<std::string> &targetPaths);
+		uint32_t GetSlotCount() const { return static_cast<uint32_t>(m_slotPaths.size()); }
+		ChannelPathId GetSlotPathId(uint32_t slot) const { return (slot < m_slotPaths.size()) ? m_slotPaths[slot] : INVALID_CHANNEL_PATH_ID; }
+		std::optional<uint32_t> FindSlot(ChannelPathId pathId) const;
+
+		// Returns the binding of the animation to this schema. Bindings are cached, so the channels of an animation are
+		// only resolved the first time, or after its channel layout has changed.
+		std::shared_ptr<const AnimationBinding> GetBinding(const Animation &animation) const;
+		void ClearBindingCache();
+	  private:
+		AnimationTargetSchema() = default;
+		std::vector<ChannelPathId> m_slotPaths;
+		std::unordered_map<ChannelPathId, uint32_t> m_pathToSlot;
+
+		mutable std::mutex m_bindingMutex;
+		mutable std::unordered_map<const Animation *, std::shared_ptr<const AnimationBinding>> m_bindings;
+	};
+};
@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <cinttypes>
+#include <string>
+
+export module panima:animation_journal;
+
+import :animation;
+
+export namespace panima {
+	// Stores an animation as a full save (the base file) followed by a sequence of journal files, each of which only contains the channels
+	// that have changed since the previous save (see Animation::SaveChanges). Journal files are named after the base file ("<name>_journal<n>.udm").
+	// Once the journal has grown too large, it is compacted into a new base file.
+	// The journal keeps a snapshot of the animation as of its last save or load (see Animation::CreateSnapshot), which every entry is relative to.
+	// Saving or loading the animation through other means doesn't affect the journal, but each journal should only be used with a single animation.
+	class AnimationJournal {
+	  public:
+		static constexpr uint32_t DEFAULT_MAX_ENTRY_COUNT = 32;
+		static constexpr float DEFAULT_MAX_SIZE_RATIO = 1.f;
+		AnimationJournal(std::string fileName);
+
+		// Appends a journal entry if the animation has unsaved changes. Writes a new base file instead if there is none yet,
+		// or if the journal has reached its maximum entry count or size.
+		bool Save(const Animation &anim, std::string &outErr);
+		// Writes a new base file and removes all journal entries
+		bool Compact(const Animation &anim, std::string &outErr);
+		// Loads the base file into the (empty) animation and replays the journal. Entries that were left behind
+		// by an interrupted compaction are ignored.
+		bool Load(Animation &anim, std::string &outErr);
+
+		void SetMaxEntryCount(uint32_t count) { m_maxEntryCount = count; }
+		uint32_t GetMaxEntryCount() const { return m_maxEntryCount; }
+		// The journal is also compacted once its total size exceeds the size of the base file multiplied by this ratio
+		void SetMaxSizeRatio(float ratio) { m_maxSizeRatio = ratio; }
+		float GetMaxSizeRatio() const { return m_maxSizeRatio; }
+
+		const std::string &GetFileName() const { return m_fileName; }
+		std::string GetEntryFileName(uint32_t sequence) const;
+		uint32_t GetEntryCount() const { return m_entryCount; }
+		uint64_t GetJournalSize() const { return m_journalSize; }
+	  private:
+		void RemoveEntries(uint32_t firstSequence);
+		std::string m_fileName;
+		uint32_t m_maxEntryCount = DEFAULT_MAX_ENTRY_COUNT;
+		float m_maxSizeRatio = DEFAULT_MAX_SIZE_RATIO;
+
+		// Identifies the base file the journal entries belong to
+		uint64_t m_generation = 0;
+		bool m_hasBase = false;
+		// State of the animation the base file and all entries add up to
+		AnimationSnapshot m_baseline;
+		// Set if writing the base file or reading the journal has failed, in which case the entries no longer match the base file
+		bool m_compactionRequired = false;
+		uint32_t m_entryCount = 0;
+		uint64_t m_baseSize = 0;
+		uint64_t m_journalSize = 0;
+	};
+};
@@ -7,12 +7,17 @@ module;
 #include <udm.hpp>
 #include <vector>
 #include <memory>
+#include <unordered_map>
+#include <future>
 
 export module panima:animation_manager;
 
 import :animation_set;
 import :slice;
 import :player;
+import :animation;
+import :channel_binding;
+import :stats;
 
 export namespace panima {
 	struct AnimationPlayerCallbackInterface {
@@ -20,6 +25,19 @@ export namespace panima {
 		std::function<void()> onStopAnimation = nullptr;
 		std::function<void(const panima::AnimationSet &, panima::AnimationId &, PlaybackFlags &)> translateAnimation = nullptr;
 	};
+	struct AnimationLayer {
+		enum class BlendMode : uint8_t {
+			// Blends the layer pose over the layers below it
+			Override = 0,
+			// Adds the difference between the layer pose and the first frame of its animation to the layers below it
+			Additive,
+		};
+		PPlayer player = nullptr;
+		float weight = 1.f;
+		BlendMode blendMode = BlendMode::Override;
+		// Target path prefixes of the channels affected by this layer. If empty, the layer affects all channels.
+		std::vector<std::string> mask;
+	};
 	class AnimationManager : public std::enable_shared_from_this<AnimationManager> {
 	  public:
 		using AnimationSetIndex = uint32_t;
@@ -39,6 +57,37 @@ export namespace panima {
 		void PlayAnimation(const std::string &animation, PlaybackFlags flags = PlaybackFlags::Default);
 		void StopAnimation();
 
+		// Advances the player and all layers, applies the crossfade from the previous animation, if one is active,
+		// and composes the layers into the output slice.
+		// Calling Advance on the player directly bypasses the crossfade and the layers.
+		bool Advance(float dt, bool force = false);
+
+		// The player of the manager acts as the base layer, additional layers are evaluated on top of it in the order they were added.
+		// Returns the index of the new layer. If the layer has no player, a new one is created.
+		uint32_t AddLayer(const AnimationLayer &layer = {});
+		void RemoveLayer(uint32_t layerIdx);
+		void ClearLayers();
+		uint32_t GetLayerCount() const { return static_cast<uint32_t>(m_layers.size()); }
+		const AnimationLayer *GetLayer(uint32_t layerIdx) const;
+		panima::Player *GetLayerPlayer(uint32_t layerIdx);
+		void SetLayerWeight(uint32_t layerIdx, float weight);
+		void SetLayerBlendMode(uint32_t layerIdx, AnimationLayer::BlendMode blendMode);
+		void SetLayerMask(uint32_t layerIdx, std::vector<std::string> mask);
+		// Applies the LOD settings to the player and all current layers (see Player::SetUpdateRateDivisor and Player::SetChannelMask)
+		void SetUpdateRateDivisor(uint32_t divisor, uint32_t frameOffset = 0);
+		void SetChannelMask(const std::vector<std::string> &pathPrefixes);
+		// Final pose after all layers have been applied. If there are no layers, this is the slice of the player.
+		// Channels of the base animation map to the same indices in the output slice, channels that only exist in other layers follow after.
+		const panima::Slice &GetOutputSlice() const;
+		// Target path for each channel of the output slice
+		const std::vector<std::string> &GetOutputChannelPaths() const { return m_outputChannelPaths; }
+
+		// Duration (in seconds) of the crossfade from the previous pose when switching to another animation. A duration of 0 disables crossfading.
+		void SetFadeDuration(float duration) { m_fadeDuration = duration; }
+		float GetFadeDuration() const { return m_fadeDuration; }
+		bool IsFading() const { return m_fadeSourceAnimation != nullptr; }
+		void StopFade();
+
 		panima::Slice &GetPreviousSlice() { return m_prevAnimSlice; }
 		const panima::Slice &GetPreviousSlice() const { return const_cast<AnimationManager *>(this)->GetPreviousSlice(); }
 
@@ -56,6 +105,22 @@ export namespace panima {
 
 		std::vector<ChannelValueSubmitter> &GetChannelValueSubmitters() { return m_channelValueSubmitters; }
 		const std::vector<ChannelValueSubmitter> &GetChannelValueSubmitters() const { return const_cast<AnimationManager *>(this)->GetChannelValueSubmitters(); }
+		// Channels of the output slice that are written directly to external memory at the end of Advance.
+		// If the player has a target schema (see Player::SetTargetSchema), the bindings are keyed by the slots of the schema and are
+		// resolved to the channels of whichever animation is playing. Otherwise they are keyed by channel index and have to be
+		// rebound when switching to an animation with a different channel layout.
+		// Bindings are not copied along with the manager, since they usually refer to memory of the owner.
+		ChannelBindingTable &GetChannelBindings() { return m_channelBindings; }
+		const ChannelBindingTable &GetChannelBindings() const { return m_channelBindings; }
+
+		// Executor used for asynchronous prefetches (see PrefetchAnimation and PlaybackFlags::PrefetchBit).
+		// If no executor is set, prefetches are performed immediately.
+		void SetPrefetchExecutor(const TaskExecutor &executor) { m_prefetchExecutor = executor; }
+		// Starts prefetching the animation, so that playing it later doesn't cause a hitch. Returns false if the animation doesn't exist.
+		bool PrefetchAnimation(const std::string &animation);
+		bool IsAnimationReady(const std::string &animation) const;
+		// True if playback is on hold until the prefetch of the current animation has completed
+		bool IsWaitingForPrefetch() const { return m_pendingPrefetch.valid(); }
 
 		void AddAnimationSet(std::string name, panima::AnimationSet &animSet);
 		const std::vector<panima::PAnimationSet> &GetAnimationSets() const { return m_animationSets; }
@@ -70,6 +135,10 @@ export namespace panima {
 
 		int32_t GetPriority() const { return m_priority; }
 
+		// Includes the animation sets, slices and blend plans of the manager. Animation sets that are also referenced
+		// outside of this manager are counted as shared.
+		MemoryUsage GetMemoryUsage() const;
+
 		bool operator==(const AnimationManager &other) const { return this == &other; }
 		bool operator!=(const AnimationManager &other) const { return !operator==(other); }
 	  private:
@@ -79,11 +148,30 @@ export namespace panima {
 		AnimationReference FindAnimation(const std::string &setName, panima::AnimationId animation, PlaybackFlags flags) const;
 		AnimationReference FindAnimation(const std::string &setName, const std::string &animation, PlaybackFlags flags) const;
 		AnimationReference FindAnimation(const std::string &animation, PlaybackFlags flags) const;
+		// Looks up the animation in the name index, without applying AnimationPlayerCallbackInterface::translateAnimation
+		AnimationReference FindAnimationByName(const std::string &animation) const;
 		void PlayAnimation(AnimationSetIndex animSetIndex, panima::AnimationId animIdx, PlaybackFlags flags = PlaybackFlags::Default);
 		AnimationManager(const AnimationManager &other);
 		AnimationManager(AnimationManager &&other);
 		AnimationManager();
 		static void ApplySliceInterpolation(const panima::Slice &src, panima::Slice &dst, float f);
+		void UpdateFadeBlendPlan(const panima::Animation &anim);
+		struct LayerData {
+			AnimationLayer layer;
+			const panima::Animation *animation = nullptr;
+			// Animation pose at the first frame, which additive layers are relative to
+			panima::Slice referencePose;
+			// Initializes output channels that don't exist in the base layer
+			panima::SliceBlendPlan initPlan;
+			panima::SliceBlendPlan blendPlan;
+		};
+		bool IsLayerLayoutDirty() const;
+		void UpdateLayerLayout();
+		void ComposeLayers();
+		void ApplyChannelBindings(const panima::Slice &slice, const std::vector<uint32_t> *optChangedChannels) const;
+		void CopyLayers(const AnimationManager &other);
+		void UpdateAnimationNameIndex() const;
+		void UpdateAnimationNameIndexEntry(const std::string &name) const;
 		panima::PPlayer m_player = nullptr;
 
 		int32_t m_priority = 0;
@@ -96,8 +184,30 @@ export namespace panima {
 
 		PlaybackFlags m_currentFlags = PlaybackFlags::None;
 		std::vector<ChannelValueSubmitter> m_channelValueSubmitters {};
+		ChannelBindingTable m_channelBindings {};
 
 		panima::Slice m_prevAnimSlice;
+		float m_fadeDuration = 0.f;
+		float m_fadeTime = 0.f;
+		// Animation the previous slice was sampled from, determines the channel layout of m_prevAnimSlice
+		std::shared_ptr<const panima::Animation> m_fadeSourceAnimation = nullptr;
+		const panima::Animation *m_fadeTargetAnimation = nullptr;
+		panima::SliceBlendPlan m_fadeBlendPlan;
+		bool m_fadeBlendPlanDirty = false;
+		bool m_layerLayoutDirty = false;
+		mutable bool m_animationNameIndexDirty = true;
+
+		std::vector<LayerData> m_layers;
+		panima::Slice m_outputSlice;
+		std::vector<std::string> m_outputChannelPaths;
+		panima::SliceBlendPlan m_outputBasePlan;
+		const panima::Animation *m_layerBaseAnimation = nullptr;
+		// Animation name to the index of the first animation set containing it. Adding or removing sets updates the entries of their animations
+		// (and the indices of the sets that follow a removed one), changes within a set are applied on the next lookup (see AnimationSet::GetChangedNames).
+		mutable util::StringMap<AnimationSetIndex> m_animationNameIndex;
+		mutable std::vector<uint32_t> m_animationNameIndexRevisions;
+		TaskExecutor m_prefetchExecutor = nullptr;
+		std::shared_future<void> m_pendingPrefetch;
 		mutable AnimationPlayerCallbackInterface m_callbackInterface {};
 	};
 	using PAnimationManager = std::shared_ptr<AnimationManager>;
@@ -9,16 +9,25 @@ module;
 #include <optional>
 #include <string_view>
 #include <unordered_map>
+#include <deque>
+#include <future>
+#include <mutex>
 #include <sharedutils/util_string_hash.hpp>
 
 export module panima:animation_set;
 
 import :animation;
+import :stats;
 import :types;
 
 export namespace panima {
+	// Animation ids are generational handles: they remain valid until the animation is removed, and ids of removed
+	// animations are never resolved to animations that are added later (unless the generation wraps around).
 	class AnimationSet : public std::enable_shared_from_this<AnimationSet> {
 	  public:
+		static constexpr uint32_t ID_INDEX_BITS = 24;
+		static constexpr uint32_t ID_INDEX_MASK = (1u << ID_INDEX_BITS) - 1;
+		static constexpr uint32_t MAX_NAME_HISTORY = 256;
 		static std::shared_ptr<AnimationSet> Create();
 		void Clear();
 		void AddAnimation(Animation &anim);
@@ -26,24 +35,73 @@ export namespace panima {
 		void RemoveAnimation(const Animation &anim);
 		void RemoveAnimation(AnimationId id);
 		std::optional<AnimationId> LookupAnimation(const std::string_view &animName) const;
+		const util::StringMap<AnimationId> &GetNameToIdMap() const { return m_nameToId; }
 		Animation *GetAnimation(AnimationId id);
 		const Animation *GetAnimation(AnimationId id) const { return const_cast<AnimationSet *>(this)->GetAnimation(id); }
 
+		// All animations of the set in no particular order (removing an animation moves the last one into its place).
+		// Use GetAnimationId to get the id of an animation in this list.
 		std::vector<std::shared_ptr<Animation>> &GetAnimations() { return m_animations; }
 		const std::vector<std::shared_ptr<Animation>> &GetAnimations() const { return const_cast<AnimationSet *>(this)->GetAnimations(); }
+		AnimationId GetAnimationId(uint32_t animationIndex) const { return (animationIndex < m_indexToId.size()) ? m_indexToId[animationIndex] : INVALID_ANIMATION; }
 
 		Animation *FindAnimation(const std::string_view &animName);
 		const Animation *FindAnimation(const std::string_view &animName) const { return const_cast<AnimationSet *>(this)->FindAnimation(animName); }
 
+		// Compiles the pending value expressions of all animations in this set, see Animation::PrecompileExpressions
+		uint32_t PrecompileExpressions(const TaskExecutor &executor = nullptr);
+
+		// Prefetches the animation (see Animation::Prefetch) in a task of the executor, or immediately if no executor is specified.
+		// If a prefetch of the animation is already in progress, its future is returned instead.
+		std::shared_future<void> Prefetch(AnimationId id, const TaskExecutor &executor = nullptr);
+		// Returns an invalid future if no prefetch of the animation is in progress
+		std::shared_future<void> GetPendingPrefetch(AnimationId id) const;
+		// True if the animation can be evaluated without any deferred work, and no prefetch is in progress
+		bool IsAnimationReady(AnimationId id) const;
+
 		void Reserve(uint32_t count);
 		uint32_t GetSize() const;
+		// Changes whenever animations are added or removed
+		uint32_t GetRevision() const { return m_revision; }
+		// Appends the names of all animations that have been added or removed since the specified revision, which allows name
+		// indices spanning multiple sets to be updated incrementally (see AnimationManager). Only the last MAX_NAME_HISTORY
+		// changes are kept, returns false if the revision is older than that (or the set has been cleared since).
+		bool GetChangedNames(uint32_t sinceRevision, std::vector<std::string> &outNames) const;
+
+		// Animations that are also referenced outside of this set (e.g. by a player) are counted as shared
+		MemoryUsage GetMemoryUsage() const;
+		struct AnimationMemoryUsage {
+			AnimationId id;
+			MemoryUsage usage;
+		};
+		// Memory usage of each animation in the set, sorted by total size in descending order
+		std::vector<AnimationMemoryUsage> GetMemoryBreakdown() const;
 
 		bool operator==(const AnimationSet &other) const { return this == &other; }
 		bool operator!=(const AnimationSet &other) const { return !operator==(other); }
 	  private:
+		struct Slot {
+			static constexpr auto UNUSED = std::numeric_limits<uint32_t>::max();
+			uint32_t animationIndex = UNUSED;
+			uint8_t generation = 0;
+		};
 		AnimationSet();
+		static AnimationId GetId(uint32_t slot, uint8_t generation) { return (static_cast<AnimationId>(generation) << ID_INDEX_BITS) | slot; }
+		const Slot *FindSlot(AnimationId id) const;
+		void FreeSlot(uint32_t slot);
+		void OnNameChanged(std::string name);
 		std::vector<std::shared_ptr<Animation>> m_animations;
-		std::unordered_map<size_t, size_t> m_nameToId;
+		std::vector<AnimationId> m_indexToId;
+		std::vector<Slot> m_slots;
+		// Free slots are reused in FIFO order to delay generation wrap-arounds
+		std::deque<uint32_t> m_freeSlots;
+		util::StringMap<AnimationId> m_nameToId;
+		uint32_t m_revision = 0;
+		// Name of the animation added or removed with each of the last revisions
+		std::deque<std::string> m_nameHistory;
+
+		mutable std::mutex m_prefetchMutex;
+		mutable std::unordered_map<AnimationId, std::shared_future<void>> m_prefetches;
 	};
 	using PAnimationSet = std::shared_ptr<AnimationSet>;
 };
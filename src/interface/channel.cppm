@@ -11,10 +11,16 @@ module;
 #include <udm_basic_types.hpp>
 #include <udm_trivial_types.hpp>
 #include <udm_types.hpp>
+#include <shared_mutex>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <deque>
 
 export module panima:channel;
 
 import :types;
+import :stats;
 
 export namespace panima {
 	template<typename T>
@@ -25,8 +31,10 @@ export namespace panima {
 	constexpr std::string_view ANIMATION_CHANNEL_PATH_SCALE = "scale";
 
 	// Example URI: panima:ec/color/color?components=red,blue
+	using ChannelPathId = uint32_t;
+	constexpr auto INVALID_CHANNEL_PATH_ID = std::numeric_limits<ChannelPathId>::max();
 	struct ChannelPath {
-		ChannelPath() = default;
+		ChannelPath();
 		ChannelPath(const std::string &path);
 		ChannelPath(const ChannelPath &other);
 
@@ -40,13 +48,66 @@ export namespace panima {
 
 		operator std::string() const { return ToUri(); }
 		std::string ToUri(bool includeScheme = true) const;
+
+		// Interned id of the path (see ChannelPathRegistry), equal paths always have the same id.
+		// UpdateId has to be called if the path or components have been modified directly.
+		ChannelPathId GetId() const { return m_id; }
+		void UpdateId();
 	  private:
+		friend class ChannelPathRegistry;
+		struct NoIntern {};
+		// Parses the path without interning it, the id remains invalid
+		ChannelPath(const std::string &path, NoIntern);
+		void Parse(const std::string &path);
 		std::unique_ptr<std::vector<std::string>> m_components = nullptr;
+		ChannelPathId m_id = INVALID_CHANNEL_PATH_ID;
+	};
+
+	// Maps channel paths to compact integer ids. Ids are never released, so they remain valid for the lifetime of the program.
+	class ChannelPathRegistry {
+	  public:
+		static ChannelPathRegistry &Get();
+		ChannelPathId Intern(const ChannelPath &path);
+		// Different spellings of the same path are cached, so that the string only has to be parsed the first time
+		ChannelPathId Intern(const std::string &path);
+		// Returns the id of the path if it has been interned before, otherwise INVALID_CHANNEL_PATH_ID. Nothing is added to
+		// the registry for paths that are unknown, so this should be used for lookups. Spellings of known paths are cached like by Intern.
+		ChannelPathId Find(const std::string &path) const;
+		size_t GetHash(ChannelPathId id) const;
+		size_t GetCount() const;
+	  private:
+		struct Entry {
+			std::string key;
+			size_t hash = 0;
+		};
+		ChannelPathRegistry() = default;
+		static std::string GetKey(const ChannelPath &path);
+		mutable std::shared_mutex m_mutex;
+		// Only contains spellings of paths that have been interned
+		std::unordered_map<std::string, ChannelPathId> m_keyToId;
+		// Also updated by Find
+		mutable std::unordered_map<std::string, ChannelPathId> m_aliasToId;
+		std::deque<Entry> m_entries;
 	};
 
 	namespace expression {
 		struct ValueExpression;
+		struct EvaluationContext;
 	};
+	// Acceleration structures for the windowed aggregate queries of a channel (see Channel::GetIntegral),
+	// built lazily on first use and rebuilt whenever the channel revision changes.
+	struct ChannelAggregates {
+		struct Component {
+			// Integral of the component from the first key up to each key
+			std::vector<double> prefixIntegrals;
+			// Bottom-up segment trees over the key values
+			std::vector<float> minTree;
+			std::vector<float> maxTree;
+		};
+		uint32_t revision = 0;
+		std::vector<Component> components;
+	};
+	class Animation;
 	struct Channel : public std::enable_shared_from_this<Channel> {
 		template<typename T>
 		class Iterator {
@@ -97,7 +158,10 @@ export namespace panima {
 		Channel &operator=(Channel &other);
 		~Channel();
 		ChannelInterpolation interpolation = ChannelInterpolation::Linear;
+		// If the target path of a channel that belongs to an animation is assigned directly, Animation::InvalidateChannelIndex
+		// has to be called, SetTargetPath takes care of this automatically.
 		ChannelPath targetPath;
+		void SetTargetPath(const ChannelPath &path);
 
 		template<typename T>
 		uint32_t AddValue(float t, const T &value);
@@ -122,6 +186,38 @@ export namespace panima {
 		bool ClearRange(float startTime, float endTime, bool addCaps = true);
 		void ClearAnimationData();
 		void MergeValues(const Channel &other);
+		struct KeyRange {
+			const Channel *channel = nullptr;
+			uint32_t first = 0;
+			uint32_t count = 0;
+		};
+		// Replaces all keys with the concatenation of the specified key ranges. The ranges have to be in chronological order
+		// without overlaps, and the channels have to have the same value type as this channel.
+		void AssignKeys(const std::vector<KeyRange> &ranges);
+		// Keeps keepCount keys starting at keepFirst, and replaces the keys before and after them with the concatenation of the prepended
+		// and appended key ranges, respectively. Only the kept keys are moved, so this is cheaper than AssignKeys if most keys are kept.
+		void SpliceKeys(uint32_t keepFirst, uint32_t keepCount, const std::vector<KeyRange> &prepend, const std::vector<KeyRange> &append);
+		// Replaces all keys with n keys from contiguous buffers in a single bulk copy, without the range clearing and key merging of InsertValues.
+		// valueType becomes the value type of the channel. The keys are validated first (see ValidateKeys), if they are invalid the channel is left unchanged.
+		bool SetKeys(uint32_t n, const float *times, const void *values, udm::Type valueType, std::string *optOutErr = nullptr);
+		template<typename T>
+		    requires(!std::is_same_v<T, bool>) // Boolean values are stored as uint8_t, use the untyped version instead
+		bool SetKeys(const std::vector<float> &times, const std::vector<T> &values, std::string *optOutErr = nullptr)
+		{
+			if(times.size() != values.size()) {
+				if(optOutErr)
+					*optOutErr = "Number of times does not match number of values!";
+				return false;
+			}
+			return SetKeys(static_cast<uint32_t>(times.size()), times.data(), values.data(), udm::type_to_enum<T>(), optOutErr);
+		}
+		// Creates a channel that uses the specified array properties as its storage without copying them, e.g. arrays a decoder has written into
+		// directly or arrays of a loaded udm file. The properties remain shared with the caller. Returns nullptr if the keys are invalid.
+		static std::shared_ptr<Channel> Create(const udm::PProperty &times, const udm::PProperty &values, std::string *optOutErr = nullptr);
+		// Checks that the value type is animatable and that the times are finite and in strictly ascending order
+		static bool ValidateKeys(uint32_t n, const float *times, udm::Type valueType, std::string *optOutErr = nullptr);
+		// Same as above for the keys of this channel, and also checks that there is exactly one value per time
+		bool ValidateKeys(std::string *optOutErr = nullptr) const;
 
 		bool Save(udm::LinkedPropertyWrapper &prop) const;
 		bool Load(udm::LinkedPropertyWrapper &prop);
@@ -175,6 +271,32 @@ export namespace panima {
 
 		void ResolveDuplicates(float t);
 
+		// Windowed aggregates of a numeric component of the (linearly interpolated) animation data. Times are in the same space as
+		// for GetInterpolatedValue and values are held constant outside of the time range of the channel. After the acceleration structures
+		// have been built (lazily, on first use), each query costs O(log n) regardless of the window size.
+		std::optional<double> GetIntegral(float tStart, float tEnd, uint32_t component = 0) const;
+		std::optional<double> GetAverage(float tStart, float tEnd, uint32_t component = 0) const;
+		std::optional<float> GetMinimum(float tStart, float tEnd, uint32_t component = 0) const;
+		std::optional<float> GetMaximum(float tStart, float tEnd, uint32_t component = 0) const;
+
+		// The revision is incremented whenever the animation data changes. If the data is modified directly (e.g. through GetValue),
+		// IncrementRevision has to be called to invalidate any data derived from it. This also increments the revision
+		// of every animation the channel belongs to (see Animation::GetRevision).
+		uint32_t GetRevision() const { return m_revision; }
+		void IncrementRevision();
+
+		// Detects spans of keys with the same value. This is done automatically by Load and Optimize, and the information
+		// is discarded as soon as the channel is modified (i.e. the revision changes).
+		void UpdateConstantSpans();
+		bool HasConstantSpanInfo() const { return m_constantSpansRevision == m_revision; }
+		// True if the channel has no value expression and all keys have the same value. Requires constant span info.
+		bool IsConstant() const;
+		// True if the value doesn't change between the keys idx0 and idx1 (inclusive). Requires constant span info.
+		bool IsConstantBetween(uint32_t idx0, uint32_t idx1) const;
+		// True if sampling at time t yields the same value as the last sample that returned the specified pivot index
+		// (see GetInterpolatedValue), because both lie within the same span of constant keys. Requires constant span info.
+		bool IsInConstantSpan(float t, uint32_t pivotTimeIndex) const;
+
 		void TransformGlobal(const umath::ScaledTransform &transform);
 
 		// Note: It is the caller's responsibility to ensure that the type matches the channel type
@@ -184,12 +306,54 @@ export namespace panima {
 		{
 			return DoApplyValueExpression<T>(time, timeIndex, inOutVal);
 		}
+		// Same as above, but evaluates the expression with the state stored in the specified context instead of the
+		// channel's own state. This allows the same channel to be evaluated concurrently, as long as each thread uses its own context.
+		template<typename T>
+		    requires(is_supported_expression_type_v<T>)
+		bool ApplyValueExpression(expression::EvaluationContext &context, double time, uint32_t timeIndex, T &inOutVal) const
+		{
+			return DoApplyValueExpression<T>(context, time, timeIndex, inOutVal);
+		}
 		void ClearValueExpression();
-		bool SetValueExpression(std::string expression, std::string &outErr);
+		// Evaluates the value expression across the time range of the channel (or its time frame duration, whichever is larger) with the specified
+		// sample rate, replaces the channel's animation data with the results and clears the expression. If maxError is greater than 0, the
+		// resulting keys are decimated with the specified error tolerance. A pending expression is compiled first; if that fails,
+		// the channel is left unchanged and the compile error is returned in optOutErr.
+		bool BakeValueExpression(float sampleRate, float maxError = 0.03f, std::string *optOutErr = nullptr);
+		// If deferCompilation is true, the expression is only compiled on first use (or when calling CompileValueExpression) and
+		// compilation errors will not be reported here.
+		// Animations containing the channel apply the new expression right away, but only evaluate it in dependency order with the
+		// other expressions after their next Animation::UpdateExpressionGraph (or Animation::Prefetch).
+		bool SetValueExpression(std::string expression, std::string &outErr, bool deferCompilation = false);
+		bool CompileValueExpression(std::string *optOutErr = nullptr);
+		bool HasPendingValueExpression() const;
+		// Returns the compilation error if the value expression has failed to compile, otherwise nullptr
+		const std::string *GetValueExpressionError() const;
+		// Performs all work that would otherwise be deferred to the first evaluation (compilation of the value expression,
+		// detection of constant spans). Compressed key arrays are not affected, they're decompressed as soon as the channel
+		// is loaded (see Load), so loading should happen on a worker thread as well if that is a concern.
+		// May be called from a worker thread, as long as the channel isn't modified at the same time.
+		void Prefetch();
+		bool IsReady() const { return !HasPendingValueExpression(); }
+
+		// Only available if panima was built with PANIMA_ENABLE_STATS (see ENABLE_SAMPLING_STATS), otherwise the stats are always empty
+		SamplingStats GetSamplingStats() const { return m_samplingCounters.Snapshot(); }
+		void ResetSamplingStats() { m_samplingCounters.Reset(); }
+		// Key arrays are counted as shared if their properties are also referenced outside of this channel. The compressed size of
+		// the key arrays is only known if they haven't been modified since the channel was last saved (see MemoryUsage::unknownCompressedArrays).
+		MemoryUsage GetMemoryUsage() const;
 		bool TestValueExpression(std::string expression, std::string &outErr);
 		const std::string *GetValueExpression() const;
+		expression::ValueExpression *GetValueExpressionObject() { return m_valueExpression.get(); }
+		const expression::ValueExpression *GetValueExpressionObject() const { return const_cast<Channel *>(this)->GetValueExpressionObject(); }
 
 		void SetTimeFrame(TimeFrame timeFrame) { m_timeFrame = std::move(timeFrame); }
+		// Converts a time in the space of GetInterpolatedValue to the time space of the keys
+		float GetLocalTime(float t) const
+		{
+			TimeToLocalTimeFrame(t);
+			return t;
+		}
 		TimeFrame &GetTimeFrame() { return m_timeFrame; }
 		const TimeFrame &GetTimeFrame() const { return const_cast<Channel *>(this)->GetTimeFrame(); }
 
@@ -216,9 +380,14 @@ export namespace panima {
 	  private:
 		static void MergeDataArrays(uint32_t n0, const float *times0, const uint8_t *values0, uint32_t n1, const float *times1, const uint8_t *values1, std::vector<float> &outTimes, const std::function<uint8_t *(size_t)> &fAllocateValueData, size_t valueStride);
 		std::pair<std::optional<uint32_t>, std::optional<uint32_t>> GetBoundaryIndices(float tStart, float tEnd, bool retainBoundaries = true);
+		std::shared_ptr<const ChannelAggregates> GetAggregates() const;
+		std::optional<float> GetWindowExtremum(float tStart, float tEnd, uint32_t component, bool max) const;
+		double GetPrefixIntegral(const ChannelAggregates::Component &component, float t) const;
 		void TimeToLocalTimeFrame(float &inOutT) const;
 		template<typename T>
 		bool DoApplyValueExpression(double time, uint32_t timeIndex, T &inOutVal) const;
+		template<typename T>
+		bool DoApplyValueExpression(expression::EvaluationContext &context, double time, uint32_t timeIndex, T &inOutVal) const;
 		uint32_t AddValue(float t, const void *value);
 		uint32_t InsertValues(uint32_t n, const float *times, const void *values, size_t valueStride, float offset, InsertFlags flags = InsertFlags::ClearExistingDataInRange);
 		std::pair<uint32_t, uint32_t> FindInterpolationIndices(float t, float &outInterpFactor, uint32_t pivotIndex, uint32_t recursionDepth) const;
@@ -228,6 +397,42 @@ export namespace panima {
 		std::unique_ptr<expression::ValueExpression> m_valueExpression; //default constructor is sufficient
 		TimeFrame m_timeFrame {};
 		TimeFrame m_effectiveTimeFrame {};
+		uint32_t m_revision = 0;
+		// Accessed through std::atomic_load/std::atomic_store, std::atomic<std::shared_ptr> would make the channel non-movable
+		mutable std::shared_ptr<const ChannelAggregates> m_aggregates = nullptr;
+		// Compressed sizes of the key arrays, recorded by Save (which has to compress them anyway) and valid as long as the revision matches.
+		// Accessed through std::atomic_load/std::atomic_store as well.
+		struct CompressedSizes {
+			uint32_t revision = 0;
+			size_t timesBytes = 0;
+			size_t valuesBytes = 0;
+		};
+		mutable std::shared_ptr<const CompressedSizes> m_compressedSizes = nullptr;
+		void UpdateCompressedSizes() const;
+		friend Animation;
+		// Revision counters of an animation, shared with all of its channels
+		struct AnimationRevisions {
+			// Layout revisions are unique across all animations, so that a revision can't be mistaken for the revision of a different
+			// animation that has been allocated at the same address
+			static uint32_t NextChannelLayoutRevision();
+			std::atomic<uint64_t> revision = 0;
+			std::atomic<uint32_t> channelLayoutRevision = 0;
+		};
+		void AddAnimationRevisions(const std::shared_ptr<AnimationRevisions> &revisions);
+		void RemoveAnimationRevisions(const std::shared_ptr<AnimationRevisions> &revisions);
+		// Revision counters of the animations the channel has been added to, expired once the animation has been destroyed
+		std::vector<std::weak_ptr<AnimationRevisions>> m_animationRevisions;
+		void CountSamplingEvent(SamplingCounter counter) const
+		{
+			if constexpr(ENABLE_SAMPLING_STATS) {
+				m_samplingCounters.Increment(counter);
+				get_global_sampling_counters().Increment(counter);
+			}
+		}
+		[[no_unique_address]] mutable SamplingCountersType m_samplingCounters {};
+		// Index of the last key of the constant span each key belongs to
+		std::vector<uint32_t> m_constantSpanEnds;
+		uint32_t m_constantSpansRevision = std::numeric_limits<uint32_t>::max();
 
 		// Cached variables for faster lookup
 		void UpdateLookupCache();
@@ -450,6 +655,7 @@ T panima::Channel::GetInterpolatedValue(float t, uint32_t &inOutPivotTimeIndex,
 			return {};
 		}
 	}
+	CountSamplingEvent(SamplingCounter::Samples);
 	float factor;
 	auto indices = FindInterpolationIndices(t, factor, inOutPivotTimeIndex);
 	inOutPivotTimeIndex = indices.first;
@@ -468,6 +674,7 @@ T panima::Channel::GetInterpolatedValue(float t, uint32_t &inOutPivotTimeIndex,
 		if(udm::type_to_enum<T>() != GetValueType() || times.IsEmpty())
 			return {};
 	}
+	CountSamplingEvent(SamplingCounter::Samples);
 	float factor;
 	auto indices = FindInterpolationIndices(t, factor, inOutPivotTimeIndex);
 	inOutPivotTimeIndex = indices.first;
@@ -507,6 +714,7 @@ T panima::Channel::GetInterpolatedValue(float t, T (*interpFunc)(const T &, cons
 			return {};
 		}
 	}
+	CountSamplingEvent(SamplingCounter::Samples);
 	float factor;
 	auto indices = FindInterpolationIndices(t, factor);
 	auto &v0 = GetValue<T>(indices.first);
@@ -524,6 +732,7 @@ T panima::Channel::GetInterpolatedValue(float t, void (*interpFunc)(const void *
 		if(udm::type_to_enum<T>() != GetValueType() || times.IsEmpty())
 			return {};
 	}
+	CountSamplingEvent(SamplingCounter::Samples);
 	float factor;
 	auto indices = FindInterpolationIndices(t, factor);
 	auto &v0 = GetValue<T>(indices.first);
@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <udm_types.hpp>
+#include <vector>
+#include <cinttypes>
+#include <limits>
+
+export module panima:channel_binding;
+
+import :slice;
+import :animation_binding;
+
+export namespace panima {
+	// Binds channels of a slice directly to external memory, as an alternative to ChannelValueSubmitter.
+	// Apply copies the values of all bound channels to their destinations, grouped by type, without any
+	// indirect calls. The destinations must remain valid for as long as they're bound.
+	// Bindings are keyed by channel index, or by the slots of a target schema if a binding for the animation is passed to Apply,
+	// in which case they remain valid across animations with different channel layouts (see AnimationTargetSchema).
+	class ChannelBindingTable {
+	  public:
+		// The destination type has to match the value type of the channel in the slice, channels with a different
+		// type are skipped by Apply. Only animatable types can be bound.
+		bool Bind(uint32_t channelIndex, void *destination, udm::Type type);
+		// Binds count consecutive channels to destination, destination + stride, destination + stride * 2, ...
+		bool Bind(uint32_t firstChannelIndex, uint32_t count, void *destination, size_t stride, udm::Type type);
+		void Unbind(uint32_t channelIndex);
+		bool IsBound(uint32_t channelIndex) const;
+		void Clear();
+		bool IsEmpty() const { return m_numBindings == 0; }
+		uint32_t GetBindingCount() const { return m_numBindings; }
+
+		// If optBinding is specified, the bound indices are slots, which are resolved to the channels of the slice through the binding
+		void Apply(const Slice &slice, const AnimationBinding *optBinding = nullptr) const;
+		// Only writes the specified channels (e.g. Player::GetChangedChannels)
+		void Apply(const Slice &slice, const std::vector<uint32_t> &channelIndices, const AnimationBinding *optBinding = nullptr) const;
+	  private:
+		static constexpr auto INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+		struct Group {
+			udm::Type type = udm::Type::Invalid;
+			uint32_t size = 0;
+			std::vector<uint32_t> channels;
+			std::vector<uint8_t *> destinations;
+		};
+		struct Location {
+			uint32_t group = INVALID_INDEX;
+			uint32_t entry = INVALID_INDEX;
+		};
+		Group &GetGroup(udm::Type type, uint32_t &outGroupIndex);
+		std::vector<Group> m_groups;
+		// Indexed by channel
+		std::vector<Location> m_locations;
+		uint32_t m_numBindings = 0;
+	};
+};
@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <cinttypes>
+#include <memory>
+#include <string>
+#include <vector>
+#include <optional>
+#include <future>
+#include <unordered_map>
+#include <udm_types.hpp>
+
+export module panima:chunked_channel;
+
+import :channel;
+import :types;
+
+export namespace panima {
+	struct ChunkInfo {
+		// Time range of the keys of the chunk, in the time space of the keys
+		float startTime = 0.f;
+		float endTime = 0.f;
+		uint32_t keyCount = 0;
+	};
+
+	// Provides the chunks of a chunked channel. LoadChunk is called from the threads of the task executor, so it has to be thread-safe.
+	class ChunkSource {
+	  public:
+		virtual ~ChunkSource() = default;
+		virtual udm::Type GetValueType() const = 0;
+		// Sorted by time, without overlaps
+		virtual const std::vector<ChunkInfo> &GetChunks() const = 0;
+		// Returns a channel containing only the keys of the chunk, or nullptr if the chunk could not be loaded
+		virtual std::shared_ptr<Channel> LoadChunk(uint32_t chunkIndex) const = 0;
+		// Metadata of the channel (target path, interpolation, value expression)
+		virtual void InitializeChannel(Channel &channel) const {}
+	};
+
+	// Reads the chunks written by ChunkedChannel::Save. Each chunk is stored in its own (compressed) udm file next to the manifest.
+	class FileChunkSource : public ChunkSource {
+	  public:
+		static std::shared_ptr<FileChunkSource> Open(const std::string &manifestFileName, std::string &outErr);
+		virtual udm::Type GetValueType() const override { return m_valueType; }
+		virtual const std::vector<ChunkInfo> &GetChunks() const override { return m_chunks; }
+		virtual std::shared_ptr<Channel> LoadChunk(uint32_t chunkIndex) const override;
+		virtual void InitializeChannel(Channel &channel) const override;
+	  private:
+		FileChunkSource() = default;
+		udm::Type m_valueType = udm::Type::Invalid;
+		ChannelInterpolation m_interpolation = ChannelInterpolation::Linear;
+		std::string m_targetPath;
+		std::optional<std::string> m_expression;
+		std::vector<ChunkInfo> m_chunks;
+		std::vector<std::string> m_chunkFileNames;
+	};
+
+	// Channel whose keys are split into chunks by time, of which only a sliding window around the playhead is kept in memory.
+	// The resident keys are held by a regular channel (see GetChannel), so it can be sampled (or added to an animation) like any other channel.
+	// The window is not moved by sampling the channel: Update has to be called with the playhead time before sampling, and the channel must
+	// not be sampled concurrently with Update. A player does this automatically for the chunked channels registered with it (see
+	// Player::AddChunkedChannel). Everything else that samples the channel directly (PlayerPool, PoseCache, Animation::Evaluate) only sees
+	// the resident keys, and times outside of the window are clamped to its first or last key (see IsResident).
+	class ChunkedChannel {
+	  public:
+		static constexpr float DEFAULT_CHUNK_DURATION = 10.f;
+		// Splits the keys of the channel into chunks of the specified duration (in the time space of the keys) and writes them
+		// along with a manifest. The chunk files are named after the manifest.
+		static bool Save(const Channel &channel, const std::string &manifestFileName, std::string &outErr, float chunkDuration = DEFAULT_CHUNK_DURATION);
+		// Chunks are loaded in tasks of the executor, or immediately if no executor is specified
+		static std::shared_ptr<ChunkedChannel> Create(const std::shared_ptr<ChunkSource> &source, const TaskExecutor &executor = nullptr);
+
+		const std::shared_ptr<Channel> &GetChannel() const { return m_channel; }
+		const ChunkSource &GetSource() const { return *m_source; }
+		// Number of chunks kept resident on either side of the chunk containing the playhead
+		void SetResidentRadius(uint32_t radius) { m_residentRadius = radius; }
+		uint32_t GetResidentRadius() const { return m_residentRadius; }
+
+		// Moves the resident window to the specified time (in the time space of GetInterpolatedValue). Chunks within the window that
+		// aren't loaded yet are requested from the source, chunks that have left the window are released.
+		// If wait is false, the resident keys are only updated once the chunk containing the playhead has been loaded,
+		// otherwise Update blocks until it has been loaded. Neighbouring chunks are added as soon as they become available.
+		// Chunks that remain resident are kept in place, only the keys of chunks entering or leaving the window are copied or removed.
+		// Returns false if the chunk containing the playhead is not resident yet (or could not be loaded), in which case sampling at t
+		// yields a clamped value.
+		bool Update(float t, bool wait = true);
+		// True if the chunk containing the specified time (in the time space of GetInterpolatedValue) is resident
+		bool IsResident(float t) const;
+		// Range of chunks (inclusive) whose keys are currently held by the channel
+		std::optional<std::pair<uint32_t, uint32_t>> GetResidentChunkRange() const { return m_residentRange; }
+		bool IsChunkLoaded(uint32_t chunkIndex) const;
+		uint32_t FindChunk(float tLocal) const;
+	  private:
+		ChunkedChannel(const std::shared_ptr<ChunkSource> &source, const TaskExecutor &executor);
+		void RequestChunk(uint32_t chunkIndex);
+		// Keys the chunk contributes to the channel, 0 if it could not be loaded
+		uint32_t GetResidentKeyCount(uint32_t chunkIndex);
+		std::shared_ptr<ChunkSource> m_source;
+		TaskExecutor m_executor;
+		std::shared_ptr<Channel> m_channel;
+		std::unordered_map<uint32_t, std::shared_future<std::shared_ptr<Channel>>> m_chunks;
+		uint32_t m_residentRadius = 1;
+		std::optional<std::pair<uint32_t, uint32_t>> m_residentRange;
+		// Number of keys of each chunk in the resident range, in chunk order
+		std::vector<uint32_t> m_residentKeyCounts;
+	};
+};
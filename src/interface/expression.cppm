@@ -4,6 +4,14 @@
 module;
 
 #include <sharedutils/util.h>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <atomic>
+#include <mutex>
+#include <functional>
 #include <sharedutils/magic_enum.hpp>
 #include <mathutil/perlin_noise.hpp>
 #include <udm_types.hpp>
@@ -14,9 +22,11 @@ module;
 export module panima:expression;
 
 import :channel;
+import :slice;
 
 export namespace panima {
 	struct TimeFrame;
+	class Animation;
 	namespace expression {
 		struct ValueExpression;
 
@@ -81,19 +91,25 @@ export namespace panima {
 		struct ExprFuncPerlinNoise : public exprtk::ifunction<ExprScalar> {
 			using exprtk::ifunction<ExprScalar>::operator();
 
-			ExprFuncPerlinNoise() : exprtk::ifunction<ExprScalar>(3) {}
+			ExprFuncPerlinNoise(uint32_t seed) : exprtk::ifunction<ExprScalar>(3), m_noise {seed} {}
 
 			ExprScalar operator()(const ExprScalar &v1, const ExprScalar &v2, const ExprScalar &v3) override;
 		  private:
-			umath::PerlinNoise m_noise {static_cast<uint32_t>(umath::random(std::numeric_limits<int>::lowest(), std::numeric_limits<int>::max()))};
+			umath::PerlinNoise m_noise;
 		};
 		struct BaseExprFuncValueAt {
 			BaseExprFuncValueAt() = default;
 			~BaseExprFuncValueAt() {}
 
-			void SetValueExpression(ValueExpression &expr) { m_valueExpression = &expr; }
+			void SetValueExpression(ValueExpression &expr, const ExprScalar &timeIndex)
+			{
+				m_valueExpression = &expr;
+				m_timeIndex = &timeIndex;
+			}
 		  protected:
 			ValueExpression *m_valueExpression = nullptr;
+			// Points to the time index of the evaluation state this function belongs to
+			const ExprScalar *m_timeIndex = nullptr;
 		};
 		template<typename T>
 		struct ExprFuncValueAtArithmetic : public BaseExprFuncValueAt, public exprtk::ifunction<ExprScalar> {
@@ -114,6 +130,67 @@ export namespace panima {
 			ExprScalar operator()(exprtk::igeneric_function<ExprScalar>::parameter_list_t parameters) override;
 		};
 
+		struct EvaluationContext;
+		// channel('path') returns the first component of the value of the referenced channel at the current time,
+		// channel('path', out) writes all components into the vector 'out'.
+		struct ExprFuncChannel : public exprtk::igeneric_function<ExprScalar> {
+			using exprtk::igeneric_function<ExprScalar>::operator();
+
+			ExprFuncChannel() : exprtk::igeneric_function<ExprScalar> {} {}
+
+			void SetValueExpression(ValueExpression &expr, const ExprScalar &time, const EvaluationContext *context)
+			{
+				m_valueExpression = &expr;
+				m_time = &time;
+				m_context = context;
+			}
+			ExprScalar operator()(exprtk::igeneric_function<ExprScalar>::parameter_list_t parameters) override;
+			size_t GetMemoryUsage() const
+			{
+				auto size = m_resolvedChannels.capacity() * sizeof(ResolvedChannel);
+				for(auto &resolved : m_resolvedChannels)
+					size += resolved.path.capacity();
+				return size;
+			}
+		  private:
+			// Channel index of a referenced path in the animation that was last evaluated with this state. Paths that couldn't be
+			// resolved are cached as well (without a channel index), until the channel layout of the animation changes.
+			struct ResolvedChannel {
+				std::string path;
+				const Animation *animation = nullptr;
+				uint32_t channelLayoutRevision = 0;
+				ChannelPathId pathId = INVALID_CHANNEL_PATH_ID;
+				std::optional<uint32_t> channelIndex {};
+			};
+			std::optional<uint32_t> FindChannelIndex(const Animation &anim, const std::string_view &path);
+			ValueExpression *m_valueExpression = nullptr;
+			const ExprScalar *m_time = nullptr;
+			const EvaluationContext *m_context = nullptr;
+			std::vector<ResolvedChannel> m_resolvedChannels;
+		};
+
+		// window_avg(w), window_min(w) and window_max(w) aggregate the channel's value over a window of width w centered on the current time,
+		// integral(t0, t1) integrates it over [t0, t1]. If a vector is passed as last argument, it receives the result for every component.
+		// (avg, min and max are reserved by exprtk.)
+		struct ExprFuncAggregate : public exprtk::igeneric_function<ExprScalar> {
+			using exprtk::igeneric_function<ExprScalar>::operator();
+			enum class Type : uint8_t { Average = 0, Minimum, Maximum, Integral };
+
+			ExprFuncAggregate(Type type) : exprtk::igeneric_function<ExprScalar> {}, m_type {type} {}
+
+			void SetValueExpression(ValueExpression &expr, const ExprScalar &time)
+			{
+				m_valueExpression = &expr;
+				m_time = &time;
+			}
+			ExprScalar operator()(exprtk::igeneric_function<ExprScalar>::parameter_list_t parameters) override;
+		  private:
+			ExprScalar Evaluate(float tStart, float tEnd, uint32_t component) const;
+			Type m_type;
+			ValueExpression *m_valueExpression = nullptr;
+			const ExprScalar *m_time = nullptr;
+		};
+
 		template<typename T, T (*TEval)(typename exprtk::igeneric_function<T>::parameter_list_t)>
 		struct ExprFuncGeneric : public exprtk::igeneric_function<T> {
 			using exprtk::igeneric_function<T>::operator();
@@ -176,17 +253,25 @@ export namespace panima {
 		};
 
 		struct ValueExpression {
-			ValueExpression(Channel &channel) : channel {channel} {}
-			ValueExpression(const ValueExpression &other);
-			~ValueExpression();
-			Channel &channel;
-			std::string expression;
-			struct {
+			// Everything that is written to during an evaluation. Each thread evaluating the expression
+			// concurrently needs its own state, see EvaluationContext.
+			struct State {
+				State(uint32_t noiseSeed) : noiseSeed {noiseSeed}, f_perlinNoise {noiseSeed} {}
+				State(const State &) = delete;
+				State &operator=(const State &) = delete;
+				// All states of an expression share the same seed, so noise() yields the same result on every thread
+				const uint32_t noiseSeed;
 				exprtk::symbol_table<ExprScalar> symbolTable;
 				exprtk::expression<ExprScalar> expression;
-				exprtk::parser<ExprScalar> parser;
-				ExprFuncPerlinNoise f_perlinNoise {};
+				ExprFuncPerlinNoise f_perlinNoise;
+				ExprFuncChannel f_channel {};
+				ExprFuncAggregate f_windowAvg {ExprFuncAggregate::Type::Average};
+				ExprFuncAggregate f_windowMin {ExprFuncAggregate::Type::Minimum};
+				ExprFuncAggregate f_windowMax {ExprFuncAggregate::Type::Maximum};
+				ExprFuncAggregate f_integral {ExprFuncAggregate::Type::Integral};
 				std::shared_ptr<BaseExprFuncValueAt> f_valueAt = nullptr;
+				// The context this state belongs to, or nullptr for the expression's own state
+				EvaluationContext *context = nullptr;
 
 				std::variant<Single, Vector2, Vector3, Vector4, Mat3x4, Mat4> value;
 				ExprScalar time {0.0};
@@ -195,25 +280,116 @@ export namespace panima {
 				ExprScalar startOffset {0.0};
 				ExprScalar timeScale {1.0};
 				ExprScalar duration {0.0};
-			} expr;
+			};
+			ValueExpression(Channel &channel);
+			ValueExpression(const ValueExpression &other);
+			~ValueExpression();
+			Channel &channel;
+			std::string expression;
+			State expr;
+			exprtk::parser<ExprScalar> parser;
 
+			enum class CompileState : uint8_t { Pending = 0, Compiled, Failed };
+			// Compiles the expression immediately
 			bool Initialize(udm::Type type, std::string &outErr);
+			// Defers compilation until the first call to Compile
+			void InitializeDeferred(udm::Type type);
+			// Compiles the expression if it is still pending. Thread-safe, concurrent callers will wait for the compilation to complete.
+			bool Compile(std::string *optOutErr = nullptr);
+			CompileState GetCompileState() const { return m_compileState.load(std::memory_order_acquire); }
+			bool IsCompiled() const { return GetCompileState() == CompileState::Compiled; }
+			// Only valid if the compile state is CompileState::Failed
+			const std::string &GetCompileError() const { return m_compileError; }
+			uint64_t GetId() const { return m_id; }
+			// Approximate number of bytes held by the expression and its own evaluation state. The exprtk expression tree is
+			// opaque, so only the symbols registered with the symbol table are accounted for. The states compiled into
+			// evaluation contexts are not included, see EvaluationContext::GetMemoryUsage.
+			size_t GetMemoryUsage() const;
+			static size_t GetStateMemoryUsage(const State &state);
+
+			// A channel referenced via channel('path'). The references are resolved by the animation the channel belongs to
+			// (see Animation::UpdateExpressionGraph) and are only used if the expression is evaluated outside of Animation::Evaluate,
+			// which looks up the referenced channels in the evaluated animation instead.
+			struct ChannelReference {
+				std::string path;
+				std::weak_ptr<const Channel> channel;
+			};
+			// Returns the (unique) paths of all channels referenced by the expression
+			std::vector<std::string> FindChannelReferencePaths() const;
+			void SetChannelReferences(std::vector<ChannelReference> references) { m_channelReferences = std::move(references); }
+			const std::vector<ChannelReference> &GetChannelReferences() const { return m_channelReferences; }
+			const ChannelReference *FindChannelReference(const std::string_view &path) const;
 			template<typename T>
 			    requires(is_supported_expression_type_v<T>)
 			void Apply(double time, uint32_t timeIndex, const TimeFrame &timeFrame, T &inOutValue)
 			{
-				DoApply<T>(time, timeIndex, timeFrame, inOutValue);
+				DoApply<T>(expr, time, timeIndex, timeFrame, inOutValue);
+			}
+			// Thread-safe as long as no two threads share the same context
+			template<typename T>
+			    requires(is_supported_expression_type_v<T>)
+			bool Apply(EvaluationContext &context, double time, uint32_t timeIndex, const TimeFrame &timeFrame, T &inOutValue) const
+			{
+				auto *state = GetState(context);
+				if(!state)
+					return false;
+				DoApply<T>(*state, time, timeIndex, timeFrame, inOutValue);
+				return true;
 			}
 		  private:
 			template<typename T>
-			void DoApply(double time, uint32_t timeIndex, const TimeFrame &timeFrame, T &inOutValue);
+			static void DoApply(State &state, double time, uint32_t timeIndex, const TimeFrame &timeFrame, T &inOutValue);
+			State *GetState(EvaluationContext &context) const;
+			bool InitializeState(State &state, exprtk::parser<ExprScalar> &parser, std::string &outErr) const;
 			udm::Type m_type = udm::Type::Invalid;
+			uint64_t m_id = 0;
+			std::atomic<CompileState> m_compileState = CompileState::Pending;
+			std::mutex m_compileMutex;
+			std::string m_compileError;
+			std::vector<ChannelReference> m_channelReferences;
+		};
+
+		// Called whenever the compilation of an expression fails, including deferred compilations (e.g. of expressions loaded
+		// with Channel::Load), which would otherwise only show up as the expression not being applied. May be called from any thread
+		// that compiles expressions, so the handler has to be thread-safe.
+		using CompileErrorHandler = std::function<void(const ValueExpression &expression, const std::string &err)>;
+		void set_compile_error_handler(CompileErrorHandler handler);
+
+		// Holds per-thread evaluation states for value expressions. Expressions are compiled into the
+		// context on first use, so the first evaluation of an expression with a new context is expensive.
+		struct EvaluationContext {
+			EvaluationContext() = default;
+			EvaluationContext(const EvaluationContext &) = delete;
+			EvaluationContext &operator=(const EvaluationContext &) = delete;
+			// Context of the calling thread, shared by everything that evaluates animations on that thread
+			static EvaluationContext &GetThreadContext();
+			void Clear() { m_states.clear(); }
+			size_t GetStateCount() const { return m_states.size(); }
+			// Approximate number of bytes held by the expression states of this context
+			size_t GetMemoryUsage() const;
+			// Releases the states of all expressions that have been destroyed (or replaced) since. This happens automatically
+			// whenever the context creates a new state, so it only has to be called to free the memory sooner.
+			void ReleaseStaleStates();
+
+			// If set, channel('path') reads the value of the referenced channel from this slice instead of sampling it.
+			// Used by Animation::Evaluate, so every channel is only evaluated once per tick.
+			void SetSlice(const Slice *slice) { m_slice = slice; }
+			const Slice *GetSlice() const { return m_slice; }
+			// The animation the slice belongs to, channel('path') references are resolved through it
+			void SetAnimation(const Animation *anim) { m_animation = anim; }
+			const Animation *GetAnimation() const { return m_animation; }
+		  private:
+			friend ValueExpression;
+			std::unordered_map<uint64_t, std::unique_ptr<ValueExpression::State>> m_states;
+			uint64_t m_numReleasedExpressions = 0;
+			const Slice *m_slice = nullptr;
+			const Animation *m_animation = nullptr;
 		};
 	};
 };
 
 template<typename T>
-void panima::expression::ValueExpression::DoApply(double time, uint32_t timeIndex, const TimeFrame &timeFrame, T &inOutValue)
+void panima::expression::ValueExpression::DoApply(State &expr, double time, uint32_t timeIndex, const TimeFrame &timeFrame, T &inOutValue)
 {
 	expr.time = time;
 	expr.timeIndex = static_cast<double>(timeIndex);
@@ -286,51 +462,51 @@ void panima::expression::ValueExpression::DoApply(double time, uint32_t timeInde
 export
 {
 	//Fixed bug: value_expression.cpp defines all of these for common use, but no one used them, making instead their own versions.
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Int8 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::UInt8 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Int16 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::UInt16 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Int32 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::UInt32 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Int64 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::UInt64 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Float &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Double &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Boolean &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Vector2 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Vector3 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Vector4 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Quaternion &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::EulerAngles &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Srgba &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::HdrColor &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Mat4 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Mat3x4 &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Vector2i &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Vector3i &);
-	extern template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Vector4i &);
-
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Int8 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::UInt8 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Int16 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::UInt16 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Int32 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::UInt32 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Int64 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::UInt64 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Float &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Double &);
-	template void panima::expression::ValueExpression::DoApply<bool>(double, uint32_t, const TimeFrame &, bool &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Vector2 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Vector3 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Vector4 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Quaternion &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::EulerAngles &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Srgba &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::HdrColor &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Mat4 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Mat3x4 &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Vector2i &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Vector3i &);
-	template void panima::expression::ValueExpression::DoApply(double, uint32_t, const TimeFrame &, udm::Vector4i &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Int8 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::UInt8 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Int16 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::UInt16 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Int32 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::UInt32 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Int64 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::UInt64 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Float &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Double &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Boolean &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Vector2 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Vector3 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Vector4 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Quaternion &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::EulerAngles &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Srgba &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::HdrColor &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Mat4 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Mat3x4 &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Vector2i &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Vector3i &);
+	extern template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Vector4i &);
+
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Int8 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::UInt8 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Int16 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::UInt16 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Int32 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::UInt32 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Int64 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::UInt64 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Float &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Double &);
+	template void panima::expression::ValueExpression::DoApply<bool>(State &, double, uint32_t, const TimeFrame &, bool &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Vector2 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Vector3 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Vector4 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Quaternion &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::EulerAngles &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Srgba &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::HdrColor &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Mat4 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Mat3x4 &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Vector2i &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Vector3i &);
+	template void panima::expression::ValueExpression::DoApply(State &, double, uint32_t, const TimeFrame &, udm::Vector4i &);
 };
@@ -7,6 +7,8 @@ module;
 #include <udm_types.hpp>
 #include <vector>
 #include <memory>
+#include <string>
+#include <array>
 
 #undef GetCurrentTime
 // #define PRAGMA_ENABLE_ANIMATION_SYSTEM_2
@@ -16,11 +18,31 @@ export module panima:player;
 import :slice;
 import :types;
 import :animation;
+import :pose_cache;
+import :animation_binding;
+import :chunked_channel;
 
 export namespace panima {
+	// Level-of-detail state of a player, only allocated if any of the LOD settings are used
+	struct PlayerLod {
+		uint32_t updateRateDivisor = 1;
+		uint32_t frameCounter = 0;
+		// Target path prefixes of the channels that should be evaluated, all channels are evaluated if empty
+		std::vector<std::string> channelMask;
+
+		// Per-channel mask values derived from channelMask for maskAnimation
+		std::vector<uint8_t> channelEnabled;
+		const Animation *maskAnimation = nullptr;
+		// Poses of the last evaluation and the predicted pose of the next evaluation, which the player interpolates between
+		Slice prevSlice;
+		Slice nextSlice;
+		SliceBlendPlan prevPlan;
+		SliceBlendPlan nextPlan;
+		bool interpolationValid = false;
+	};
 	class Player : public std::enable_shared_from_this<Player> {
 	  public:
-		enum class StateFlags : uint32_t { None = 0u, Looping = 1u, AnimationDirty = Looping << 1u };
+		enum class StateFlags : uint32_t { None = 0u, Looping = 1u, AnimationDirty = Looping << 1u, TrackChanges = AnimationDirty << 1u };
 		static std::shared_ptr<Player> Create();
 		static std::shared_ptr<Player> Create(const Player &other);
 		static std::shared_ptr<Player> Create(Player &&other);
@@ -46,6 +68,45 @@ export namespace panima {
 		void Reset();
 
 		const Animation *GetAnimation() const { return m_animation.get(); }
+
+		// If a pose cache is set, the animation is sampled from a shared pre-sampled pose table instead of the channels
+		void SetPoseCache(const std::shared_ptr<PoseCache> &poseCache);
+		PoseCache *GetPoseCache() const { return m_poseCache.get(); }
+
+		// If a target schema is set, the binding of each animation to the schema is looked up once in SetAnimation (bindings are cached
+		// by the schema), and channels that don't affect any slot of the schema are not evaluated.
+		void SetTargetSchema(const std::shared_ptr<const AnimationTargetSchema> &schema);
+		const AnimationTargetSchema *GetTargetSchema() const { return m_targetSchema.get(); }
+		const AnimationBinding *GetBinding() const { return m_binding.get(); }
+		// Current value of the channel bound to the slot of the target schema, or nullptr if the animation doesn't affect the slot
+		udm::Property *GetSlotValue(uint32_t slot);
+		const udm::Property *GetSlotValue(uint32_t slot) const { return const_cast<Player *>(this)->GetSlotValue(slot); }
+
+		// Only evaluates the animation on every n-th call to Advance and interpolates towards the predicted pose of the next evaluation in between.
+		// frameOffset shifts the calls on which evaluations happen (see LodScheduler).
+		void SetUpdateRateDivisor(uint32_t divisor, uint32_t frameOffset = 0);
+		uint32_t GetUpdateRateDivisor() const { return m_lod ? m_lod->updateRateDivisor : 1; }
+		// Only channels whose target path (without scheme) starts with one of the prefixes are evaluated, the values of all other channels
+		// remain unchanged. An empty mask evaluates all channels.
+		void SetChannelMask(std::vector<std::string> pathPrefixes);
+		const std::vector<std::string> *GetChannelMask() const { return m_lod ? &m_lod->channelMask : nullptr; }
+		void ClearLod() { m_lod = nullptr; }
+
+		// If enabled, the indices of all channels whose values have changed during the last Advance are collected, and channels
+		// are only re-sampled once the time leaves the span of constant keys they were last sampled in. Values written into the
+		// slice by other means are not detected, use MarkAllChannelsChanged in that case.
+		void SetChangeTrackingEnabled(bool enabled);
+		bool IsChangeTrackingEnabled() const { return umath::is_flag_set(m_stateFlags, StateFlags::TrackChanges); }
+		const std::vector<uint32_t> &GetChangedChannels() const { return m_changedChannels; }
+		void MarkAllChannelsChanged();
+
+		// Chunked channels whose channel (see ChunkedChannel::GetChannel) is part of the animation. Their resident window is moved to the
+		// playhead before every evaluation, blocking until the chunk containing the playhead has been loaded (see ChunkedChannel::Update).
+		// A chunked channel only has a single window, so sharing one between players (including copies of this player) is supported,
+		// but reloads chunks whenever the players are in different chunks. The window is not moved if the player samples a pose cache.
+		void AddChunkedChannel(const std::shared_ptr<ChunkedChannel> &channel);
+		void RemoveChunkedChannel(const ChunkedChannel &channel);
+		const std::vector<std::shared_ptr<ChunkedChannel>> &GetChunkedChannels() const { return m_chunkedChannels; }
 		uint32_t &GetLastChannelTimestampIndex(AnimationChannelId channelId) { return m_lastChannelTimestampIndices[channelId]; }
 
 		Player &operator=(const Player &other);
@@ -58,6 +119,11 @@ export namespace panima {
 		Player(const Player &other);
 		Player(Player &&other);
 		static void ApplySliceInterpolation(const Slice &src, Slice &dst, float f);
+		void SampleAnimation(float t, Slice &inOutSlice, const std::vector<uint8_t> *optChannelMask = nullptr, std::vector<uint32_t> *optOutChangedChannels = nullptr);
+		void AdvanceLod(float dt, bool discontinuous);
+		void UpdateLodChannelMask();
+		void UpdateBinding();
+		PlayerLod &InitializeLod();
 		std::shared_ptr<const Animation> m_animation = nullptr;
 		Slice m_currentSlice;
 		float m_playbackRate = 1.f;
@@ -65,8 +131,37 @@ export namespace panima {
 		StateFlags m_stateFlags = StateFlags::None;
 
 		std::vector<uint32_t> m_lastChannelTimestampIndices;
+		std::shared_ptr<PoseCache> m_poseCache = nullptr;
+		std::shared_ptr<const PoseTable> m_poseTable = nullptr;
+		std::unique_ptr<PlayerLod> m_lod = nullptr;
+		std::vector<uint32_t> m_changedChannels;
+		std::shared_ptr<const AnimationTargetSchema> m_targetSchema = nullptr;
+		std::shared_ptr<const AnimationBinding> m_binding = nullptr;
+		// Combination of the channel mask of the binding and the one passed to SampleAnimation
+		std::vector<uint8_t> m_combinedChannelMask;
+		std::vector<std::shared_ptr<ChunkedChannel>> m_chunkedChannels;
 	};
 	using PPlayer = std::shared_ptr<Player>;
+
+	// Distributes the evaluations of players with reduced update rates evenly across frames, to avoid spikes
+	// caused by many players evaluating on the same frame. Tick has to be called once per frame.
+	// Load is tracked over a window of HORIZON frames, so divisors should be divisors of HORIZON.
+	class LodScheduler {
+	  public:
+		static constexpr uint32_t HORIZON = 120;
+		// Assigns the player to the update phase with the lowest load for the divisor and returns the phase
+		uint32_t Schedule(Player &player, uint32_t updateRateDivisor);
+		void Unschedule(uint32_t updateRateDivisor, uint32_t phase);
+		void Tick() { ++m_frameIndex; }
+		uint64_t GetFrameIndex() const { return m_frameIndex; }
+		// Number of scheduled evaluations on the specified frame
+		uint32_t GetLoad(uint64_t frameIndex) const { return m_load[frameIndex % HORIZON]; }
+		void Clear();
+	  private:
+		void AddLoad(uint32_t divisor, uint32_t phase, int32_t amount);
+		std::array<uint32_t, HORIZON> m_load {};
+		uint64_t m_frameIndex = 0;
+	};
 };
 
 export
@@ -0,0 +1,140 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <mathutil/umath.h>
+#include <vector>
+#include <memory>
+#include <limits>
+
+#undef GetCurrentTime
+
+export module panima:player_pool;
+
+import :slice;
+import :types;
+import :animation;
+import :player;
+import :pose_cache;
+
+export namespace panima {
+	struct PlayerHandle {
+		static constexpr auto INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+		uint32_t index = INVALID_INDEX;
+		uint32_t generation = 0;
+		bool operator==(const PlayerHandle &other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(const PlayerHandle &other) const { return !operator==(other); }
+	};
+
+	// Owns the state of a large number of players in flat arrays and advances them in bulk.
+	// Players are referenced by handles, which remain valid until the player is destroyed (handles of destroyed players are detected as invalid).
+	// Unlike Player::Advance, finished non-looping players are removed from the active list and their time stops advancing,
+	// until they are re-activated by changing their animation, time, playback rate or looping state.
+	class PlayerPool {
+	  public:
+		static constexpr uint32_t ADVANCE_CHUNK_SIZE = 64;
+		PlayerPool() = default;
+		PlayerPool(const PlayerPool &) = delete;
+		PlayerPool &operator=(const PlayerPool &) = delete;
+
+		PlayerHandle Create();
+		PlayerHandle Create(const Player &player);
+		void Destroy(PlayerHandle handle);
+		bool IsValid(PlayerHandle handle) const { return handle.index < m_generations.size() && m_generations[handle.index] == handle.generation && m_alive[handle.index]; }
+		void Clear();
+		uint32_t GetCount() const { return static_cast<uint32_t>(m_generations.size() - m_freeIndices.size()); }
+		uint32_t GetActiveCount() const { return static_cast<uint32_t>(m_activeList.size()); }
+
+		// Advances all active players. If an executor is specified, the work is distributed over multiple tasks which claim chunks
+		// of ADVANCE_CHUNK_SIZE players at a time until all players have been processed. The calling thread participates as well,
+		// and the function only returns once all tasks have completed. If maxTasks is 0, the number of hardware threads is used.
+		// Animations that aren't ready (see Animation::IsReady) are prefetched on the calling thread before any tasks are dispatched,
+		// so the tasks only ever read from them. The animations must not be modified while this is running.
+		void Advance(float dt, const TaskExecutor &executor = nullptr, uint32_t maxTasks = 0);
+		bool Advance(PlayerHandle handle, float dt, bool force = false);
+		// Returns true if the player was updated during the last call to Advance
+		bool WasUpdated(PlayerHandle handle) const;
+
+		// If set, all players of the pool sample their animations from the pose cache (see Player::SetPoseCache)
+		void SetPoseCache(const std::shared_ptr<PoseCache> &poseCache);
+		PoseCache *GetPoseCache() const { return m_poseCache.get(); }
+
+		void SetAnimation(PlayerHandle handle, const Animation &animation);
+		const Animation *GetAnimation(PlayerHandle handle) const;
+		void Reset(PlayerHandle handle);
+		float GetDuration(PlayerHandle handle) const;
+		float GetCurrentTime(PlayerHandle handle) const;
+		void SetCurrentTime(PlayerHandle handle, float t, bool updateAnimation = false);
+		float GetPlaybackRate(PlayerHandle handle) const;
+		void SetPlaybackRate(PlayerHandle handle, float playbackRate);
+		void SetLooping(PlayerHandle handle, bool looping);
+		bool IsLooping(PlayerHandle handle) const;
+		void SetAnimationDirty(PlayerHandle handle);
+		Slice *GetCurrentSlice(PlayerHandle handle);
+		const Slice *GetCurrentSlice(PlayerHandle handle) const { return const_cast<PlayerPool *>(this)->GetCurrentSlice(handle); }
+	  private:
+		static constexpr auto INVALID_ACTIVE_INDEX = std::numeric_limits<uint32_t>::max();
+		bool AdvancePlayer(uint32_t idx, float dt, bool force);
+		void PrepareAnimations();
+		bool IsFinished(uint32_t idx) const;
+		void Activate(uint32_t idx);
+		void Deactivate(uint32_t idx);
+
+		std::vector<std::shared_ptr<const Animation>> m_animations;
+		std::vector<float> m_currentTimes;
+		std::vector<float> m_playbackRates;
+		std::vector<Player::StateFlags> m_stateFlags;
+		std::vector<uint8_t> m_updated;
+		std::vector<Slice> m_slices;
+		std::vector<std::vector<uint32_t>> m_lastChannelTimestampIndices;
+		std::vector<std::shared_ptr<const PoseTable>> m_poseTables;
+		std::shared_ptr<PoseCache> m_poseCache = nullptr;
+
+		std::vector<uint32_t> m_generations;
+		std::vector<uint8_t> m_alive;
+		std::vector<uint32_t> m_freeIndices;
+		// Indices of all players that have to be advanced
+		std::vector<uint32_t> m_activeList;
+		// Position of each player in m_activeList
+		std::vector<uint32_t> m_activeListIndices;
+		// Scratch list of the distinct animations of all active players, see PrepareAnimations
+		std::vector<const Animation *> m_activeAnimations;
+	};
+
+	// Player-like interface for a player in a pool
+	class PooledPlayer {
+	  public:
+		PooledPlayer(PlayerPool &pool, PlayerHandle handle) : m_pool {&pool}, m_handle {handle} {}
+		PlayerHandle GetHandle() const { return m_handle; }
+		bool IsValid() const { return m_pool->IsValid(m_handle); }
+
+		bool Advance(float dt, bool force = false) { return m_pool->Advance(m_handle, dt, force); }
+		float GetDuration() const { return m_pool->GetDuration(m_handle); }
+		float GetRemainingAnimationDuration() const { return GetDuration() - GetCurrentTime(); }
+		float GetCurrentTimeFraction() const
+		{
+			auto dur = GetDuration();
+			return (dur > 0.f) ? (GetCurrentTime() / dur) : 0.f;
+		}
+		float GetCurrentTime() const { return m_pool->GetCurrentTime(m_handle); }
+		void SetCurrentTimeFraction(float t, bool updateAnimation = false) { SetCurrentTime(t * GetDuration(), updateAnimation); }
+		float GetPlaybackRate() const { return m_pool->GetPlaybackRate(m_handle); }
+		void SetPlaybackRate(float playbackRate) { m_pool->SetPlaybackRate(m_handle, playbackRate); }
+		void SetCurrentTime(float t, bool updateAnimation = false) { m_pool->SetCurrentTime(m_handle, t, updateAnimation); }
+
+		Slice *GetCurrentSlice() { return m_pool->GetCurrentSlice(m_handle); }
+		const Slice *GetCurrentSlice() const { return m_pool->GetCurrentSlice(m_handle); }
+
+		void SetLooping(bool looping) { m_pool->SetLooping(m_handle, looping); }
+		bool IsLooping() const { return m_pool->IsLooping(m_handle); }
+
+		void SetAnimationDirty() { m_pool->SetAnimationDirty(m_handle); }
+		void SetAnimation(const Animation &animation) { m_pool->SetAnimation(m_handle, animation); }
+		void Reset() { m_pool->Reset(m_handle); }
+		const Animation *GetAnimation() const { return m_pool->GetAnimation(m_handle); }
+	  private:
+		PlayerPool *m_pool;
+		PlayerHandle m_handle;
+	};
+};
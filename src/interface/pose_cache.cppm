@@ -0,0 +1,100 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <udm_types.hpp>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+
+export module panima:pose_cache;
+
+import :slice;
+import :animation;
+
+export namespace panima {
+	class PoseCache;
+	// Animation sampled at a fixed rate, with the values of all frames stored in contiguous tables.
+	// Sampling interpolates between the two nearest frames (nlerp for quaternions), values of non-float types
+	// (integers, booleans, doubles) are taken from the previous frame.
+	class PoseTable {
+	  public:
+		static std::shared_ptr<PoseTable> Create(const Animation &animation, float sampleRate);
+
+		// Channels with a mask value of 0 are skipped
+		void Sample(float t, Slice &inOutSlice, const std::vector<uint8_t> *optChannelMask = nullptr) const;
+		bool IsUpToDate(const Animation &animation) const { return &animation == m_animation && animation.GetRevision() == m_revision; }
+		float GetSampleRate() const { return m_sampleRate; }
+		uint32_t GetFrameCount() const { return m_frameCount; }
+		size_t GetMemoryUsage() const;
+	  private:
+		enum class ValueKind : uint8_t { Float = 0, Quaternion, Raw };
+		struct ChannelLayout {
+			udm::Type type = udm::Type::Invalid;
+			ValueKind kind = ValueKind::Float;
+			uint32_t numComponents = 0;
+			// Offset into the float table (in floats), or into the raw table (in bytes)
+			uint32_t offset = 0;
+			uint32_t size = 0;
+		};
+		friend PoseCache;
+		PoseTable() = default;
+		const Animation *m_animation = nullptr;
+		uint64_t m_revision = 0;
+		float m_sampleRate = 0.f;
+		float m_duration = 0.f;
+		uint32_t m_frameCount = 0;
+		uint32_t m_floatsPerFrame = 0;
+		uint32_t m_rawBytesPerFrame = 0;
+		std::vector<ChannelLayout> m_channels;
+		std::vector<float> m_floatData;
+		std::vector<uint8_t> m_rawData;
+	};
+
+	// Shares pre-sampled pose tables between all players that play the same animation (see Player::SetPoseCache).
+	// Tables are evicted in least-recently-used order once the memory limit is exceeded. Players that still hold an
+	// evicted table keep using it until their animation changes.
+	class PoseCache {
+	  public:
+		struct Stats {
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t evictions = 0;
+			size_t memoryUsage = 0;
+			uint32_t tableCount = 0;
+		};
+		static constexpr size_t DEFAULT_MAX_MEMORY = 64 * 1024 * 1024;
+		static constexpr float DEFAULT_SAMPLE_RATE = 30.f;
+		static std::shared_ptr<PoseCache> Create(size_t maxMemory = DEFAULT_MAX_MEMORY, float sampleRate = DEFAULT_SAMPLE_RATE);
+
+		// Returns the table for the animation, and builds it if it doesn't exist or is out of date
+		std::shared_ptr<const PoseTable> Get(const Animation &animation);
+		void Clear();
+
+		void SetMaxMemory(size_t maxMemory);
+		size_t GetMaxMemory() const { return m_maxMemory; }
+		// Changing the sample rate clears the cache
+		void SetSampleRate(float sampleRate);
+		float GetSampleRate() const { return m_sampleRate; }
+
+		Stats GetStats() const;
+		void ResetStats();
+	  private:
+		PoseCache(size_t maxMemory, float sampleRate);
+		struct Entry {
+			std::weak_ptr<const Animation> animation;
+			std::shared_ptr<const PoseTable> table;
+		};
+		void EvictToLimit();
+		mutable std::mutex m_mutex;
+		size_t m_maxMemory;
+		float m_sampleRate;
+		// Most recently used entries first
+		std::list<Entry> m_entries;
+		std::unordered_map<const Animation *, std::list<Entry>::iterator> m_entryMap;
+		Stats m_stats;
+	};
+};
@@ -5,6 +5,8 @@ module;
 
 #include <vector>
 #include <iostream>
+#include <limits>
+#include <mathutil/uquat.h>
 #include <udm_types.hpp>
 
 export module panima:slice;
@@ -16,6 +18,54 @@ export namespace panima {
 		Slice(Slice &&other) = default;
 		Slice &operator=(const Slice &) = default;
 		Slice &operator=(Slice &&) = default;
+		// Copies the values of src into dst. Unlike the copy assignment, this does not share the
+		// properties between the slices, and properties of dst are re-used where the types match.
+		static void CopyValues(const Slice &src, Slice &dst);
+		// Approximate number of bytes held by the slice and its properties
+		size_t GetMemoryUsage() const;
 		std::vector<udm::PProperty> channelValues;
 	};
+
+	// Blends the values of two slices with type-specialized batch kernels (lerp for scalars, vectors and matrices, nlerp for quaternions).
+	// The value pointers are resolved once in Build, so Apply does not have to dispatch on the type of each property.
+	class SliceBlendPlan {
+	  public:
+		static constexpr auto INVALID_CHANNEL = std::numeric_limits<uint32_t>::max();
+		// If dstToSrc is specified, it maps each channel of dst to the corresponding channel in src, or INVALID_CHANNEL if there is none.
+		// Channels without a counterpart, or with mismatching value types, are left untouched by Apply.
+		// The reference slice is only required for ApplyAdditive and has to have the same layout as src.
+		void Build(const Slice &src, Slice &dst, const std::vector<uint32_t> *dstToSrc = nullptr, const Slice *reference = nullptr);
+		// dst = lerp(src, dst, f), i.e. a factor of 0 yields the source values and a factor of 1 leaves the destination untouched.
+		// Non-interpolatable values (integers, booleans) switch over at a factor of 0.5.
+		void Apply(float f) const;
+		// Adds the difference between src and the reference slice to dst, scaled by the weight.
+		// Quaternions are combined by rotation (dst * (inverse(reference) * src)), non-interpolatable values are left untouched.
+		void ApplyAdditive(float weight) const;
+		void Clear();
+		bool IsEmpty() const { return m_properties.empty(); }
+		// Number of bytes held by the plan, excluding the referenced slices
+		size_t GetMemoryUsage() const;
+	  private:
+		struct FloatGroup {
+			uint32_t numComponents = 0;
+			std::vector<float *> dst;
+			std::vector<const float *> src;
+			std::vector<const float *> reference;
+		};
+		struct StepValue {
+			void *dst = nullptr;
+			const void *src = nullptr;
+			size_t size = 0;
+		};
+		std::vector<FloatGroup> m_floatGroups;
+		std::vector<Quat *> m_quatDst;
+		std::vector<const Quat *> m_quatSrc;
+		std::vector<const Quat *> m_quatReference;
+		std::vector<double *> m_doubleDst;
+		std::vector<const double *> m_doubleSrc;
+		std::vector<const double *> m_doubleReference;
+		std::vector<StepValue> m_stepValues;
+		// Keeps the referenced properties alive
+		std::vector<udm::PProperty> m_properties;
+	};
 };
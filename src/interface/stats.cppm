@@ -0,0 +1,99 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <array>
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+#include <type_traits>
+
+export module panima:stats;
+
+export namespace panima {
+	// Sampling statistics are only collected if panima was built with PANIMA_ENABLE_STATS, otherwise all counters compile to nothing
+#ifdef PANIMA_ENABLE_STATS
+	constexpr bool ENABLE_SAMPLING_STATS = true;
+#else
+	constexpr bool ENABLE_SAMPLING_STATS = false;
+#endif
+
+	enum class SamplingCounter : uint8_t {
+		// Calls to Channel::GetInterpolatedValue
+		Samples = 0,
+		// Interpolation indices found in the vicinity of the pivot index
+		PivotHits,
+		// Pivot searches that had to fall back to a binary search
+		PivotMisses,
+		BinarySearches,
+		ExpressionEvaluations,
+		// Compressed key arrays whose uncompressed buffer had to be created by udm when panima accessed them
+		Decompressions,
+		LookupCacheUpdates,
+
+		Count
+	};
+
+	struct SamplingStats {
+		std::array<uint64_t, static_cast<size_t>(SamplingCounter::Count)> counters {};
+		uint64_t Get(SamplingCounter counter) const { return counters[static_cast<size_t>(counter)]; }
+		SamplingStats &operator+=(const SamplingStats &other);
+	};
+
+	class SamplingCounters {
+	  public:
+		SamplingCounters() = default;
+		// Counters aren't copied along with their owner
+		SamplingCounters(const SamplingCounters &) {}
+		SamplingCounters &operator=(const SamplingCounters &) { return *this; }
+		void Increment(SamplingCounter counter, uint64_t n = 1) { m_counters[static_cast<size_t>(counter)].fetch_add(n, std::memory_order_relaxed); }
+		SamplingStats Snapshot() const;
+		void Reset();
+	  private:
+		std::array<std::atomic<uint64_t>, static_cast<size_t>(SamplingCounter::Count)> m_counters {};
+	};
+
+	struct NullSamplingCounters {
+		void Increment(SamplingCounter counter, uint64_t n = 1) {}
+		SamplingStats Snapshot() const { return {}; }
+		void Reset() {}
+	};
+
+	using SamplingCountersType = std::conditional_t<ENABLE_SAMPLING_STATS, SamplingCounters, NullSamplingCounters>;
+	// Accumulated over all channels
+	SamplingCountersType &get_global_sampling_counters();
+	SamplingStats get_global_sampling_stats();
+	void reset_global_sampling_stats();
+
+	// Approximate heap and object memory held by a channel, animation, animation set or animation manager.
+	// The categories are disjoint and add up to GetTotal(). sharedBytes is the part of the total that is
+	// also referenced by other owners (e.g. key arrays or animations held elsewhere), so it would not
+	// necessarily be freed together with the queried object.
+	struct MemoryUsage {
+		// Compressed key data (persistent compressed buffers of ArrayLz4 arrays), as of the last time the arrays were compressed
+		size_t compressedBytes = 0;
+		// Uncompressed key data, including the decompressed buffers of ArrayLz4 arrays
+		size_t uncompressedBytes = 0;
+		// Value expressions, including the exprtk parser and symbol tables. Only the expression's own evaluation state is included;
+		// the states compiled into evaluation contexts belong to the (usually per-thread) context and are reported by
+		// expression::EvaluationContext::GetMemoryUsage instead.
+		size_t expressionBytes = 0;
+		// Channel paths and names
+		size_t stringBytes = 0;
+		// Structures derived from the key data (aggregates, constant spans, lookup indices)
+		size_t derivedBytes = 0;
+		// The objects themselves, their containers and slices
+		size_t objectBytes = 0;
+		size_t sharedBytes = 0;
+		// Number of ArrayLz4 arrays whose compressed size is unknown, because they haven't been compressed since they were last
+		// modified (or loaded). Querying the memory usage never compresses them, so they're not included in compressedBytes.
+		uint32_t unknownCompressedArrays = 0;
+
+		size_t GetTotal() const { return compressedBytes + uncompressedBytes + expressionBytes + stringBytes + derivedBytes + objectBytes; }
+		size_t GetUniqueBytes() const { return GetTotal() - sharedBytes; }
+		// Moves the entire usage into sharedBytes
+		void MarkShared() { sharedBytes = GetTotal(); }
+		MemoryUsage &operator+=(const MemoryUsage &other);
+	};
+};
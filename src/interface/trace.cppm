@@ -0,0 +1,92 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+
+export module panima:trace;
+
+export namespace panima::trace {
+	// Trace zones are only emitted if panima was built with PANIMA_ENABLE_TRACING, otherwise they compile to nothing
+#ifdef PANIMA_ENABLE_TRACING
+	constexpr bool ENABLE_TRACING = true;
+#else
+	constexpr bool ENABLE_TRACING = false;
+#endif
+
+	using Clock = std::chrono::steady_clock;
+	// Receives the zones of all threads, so implementations have to be thread-safe.
+	// Zone names are string literals and remain valid for the lifetime of the program.
+	class TraceSink {
+	  public:
+		virtual ~TraceSink() = default;
+		virtual void BeginZone(const char *name) {}
+		virtual void EndZone(const char *name, Clock::time_point start, Clock::time_point end) = 0;
+	};
+
+	// Writes the zones as complete events in the Chrome trace event format (chrome://tracing, Perfetto).
+	// Timestamps are in microseconds of the steady clock, so they can be merged with other traces based on the same clock.
+	class ChromeTraceSink : public TraceSink {
+	  public:
+		// Returns nullptr if the file could not be opened
+		static std::shared_ptr<ChromeTraceSink> Create(const std::string &fileName);
+		virtual ~ChromeTraceSink() override;
+		virtual void EndZone(const char *name, Clock::time_point start, Clock::time_point end) override;
+		// Writes the buffered events to the file. The file only becomes valid JSON once the sink is destroyed.
+		void Flush();
+	  private:
+		ChromeTraceSink(std::FILE *file);
+		void FlushUnlocked();
+		std::mutex m_mutex;
+		std::FILE *m_file = nullptr;
+		std::string m_buffer;
+		bool m_firstEvent = true;
+	};
+
+	// The sink must not be replaced or destroyed while zones are active on other threads
+	void set_sink(const std::shared_ptr<TraceSink> &sink);
+	const std::shared_ptr<TraceSink> &get_sink();
+
+	namespace detail {
+		std::atomic<TraceSink *> &get_active_sink();
+	};
+
+	class EnabledZone {
+	  public:
+		EnabledZone(const char *name) : m_name {name}, m_sink {detail::get_active_sink().load(std::memory_order_acquire)}
+		{
+			if(!m_sink)
+				return;
+			m_sink->BeginZone(name);
+			m_start = Clock::now();
+		}
+		~EnabledZone()
+		{
+			if(m_sink)
+				m_sink->EndZone(m_name, m_start, Clock::now());
+		}
+		EnabledZone(const EnabledZone &) = delete;
+		EnabledZone &operator=(const EnabledZone &) = delete;
+	  private:
+		const char *m_name;
+		TraceSink *m_sink;
+		Clock::time_point m_start {};
+	};
+
+	class DisabledZone {
+	  public:
+		constexpr DisabledZone(const char *name) {}
+		DisabledZone(const DisabledZone &) = delete;
+		DisabledZone &operator=(const DisabledZone &) = delete;
+	};
+
+	// Scoped zone, reported to the active sink (if any) when it goes out of scope
+	using Zone = std::conditional_t<ENABLE_TRACING, EnabledZone, DisabledZone>;
+};
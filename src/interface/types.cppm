@@ -18,6 +18,8 @@ export namespace panima {
 		None = 0u,
 		ResetBit = 1u,
 		LoopBit = ResetBit << 1u,
+		// If the animation isn't ready yet, it's prefetched asynchronously and the pose is held until the prefetch has completed
+		PrefetchBit = LoopBit << 1u,
 
 		Default = None
 	};
@@ -30,6 +32,9 @@ export namespace panima {
 		float duration = -1.f;
 	};
 
+	// Used to hand work off to a job system provided by the caller. Tasks may be executed on any thread and in any order.
+	using TaskExecutor = std::function<void(std::function<void()>)>;
+
 	using AnimationId = uint32_t;
 	constexpr auto INVALID_ANIMATION = std::numeric_limits<AnimationId>::max();
 	using AnimationChannelId = uint16_t;
@@ -7,10 +7,18 @@ module;
 
 export module panima;
 export import :animation;
+export import :animation_binding;
+export import :animation_journal;
 export import :animation_manager;
 export import :animation_set;
 export import :channel;
+export import :channel_binding;
+export import :chunked_channel;
 export import :player;
+export import :player_pool;
+export import :pose_cache;
 export import :slice;
+export import :stats;
+export import :trace;
 export import :types;
 export import :expression;
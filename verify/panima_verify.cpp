@@ -0,0 +1,600 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+// Differential checks of the optimized channel code paths (pivot searches, constant spans, windowed aggregates) against
+// straightforward scalar reference implementations of the same semantics, as well as invariants of the editing functions.
+// Everything is driven by explicit seeds and does not depend on the random distributions of the standard library,
+// so a reported mismatch can be reproduced on any platform by running the tool with the same seed.
+// Mismatches are written to stdout, the exit code is 1 if any check has failed.
+// Usage: panima_verify [--seed <n>] [--channels-per-type <n>] [--max-keys <n>]
+
+#include <udm.hpp>
+#include <mathutil/umath.h>
+#include <mathutil/uquat.h>
+#include <sharedutils/magic_enum.hpp>
+#include <random>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <limits>
+
+import panima;
+
+namespace {
+	struct Mismatch {
+		// Name of the check, e.g. "FindInterpolationIndices/pivot_sequential"
+		std::string check;
+		udm::Type type = udm::Type::Invalid;
+		// Seed of the channel the mismatch was found in
+		uint32_t seed = 0;
+		float time = 0.f;
+		std::string details;
+	};
+
+	struct Report {
+		uint32_t numChannels = 0;
+		uint64_t numChecks = 0;
+		uint64_t numMismatches = 0;
+		// The first Settings::maxMismatches mismatches
+		std::vector<Mismatch> mismatches;
+		bool IsSuccessful() const { return numMismatches == 0; }
+	};
+
+	struct Settings {
+		// Fixed by default, so that every run performs the same checks
+		uint32_t seed = 0x70616e69;
+		// Number of sample times per channel, in addition to the times at (and right next to) each key
+		uint32_t numSamples = 256;
+		// Number of random edits applied to copies of each channel
+		uint32_t numEdits = 8;
+		// Relative tolerance for sampled values
+		double tolerance = 0.0001;
+		// Relative tolerance for windowed aggregates (integrals accumulate rounding errors over the entire channel)
+		double aggregateTolerance = 0.001;
+		// Further mismatches are counted, but not recorded
+		uint32_t maxMismatches = 64;
+	};
+
+	struct ChannelGeneratorSettings {
+		uint32_t maxKeys = 256;
+		// Some keys are spaced just above Channel::TIME_EPSILON and below Channel::VALUE_EPSILON
+		bool nearDuplicateTimes = true;
+		// Runs of identical values, for the constant span detection
+		bool constantRuns = true;
+		// Assigns a random time frame (offset, scale, duration) to half of the channels
+		bool randomTimeFrame = true;
+	};
+
+	// std::mt19937 produces the same sequence on every platform, unlike the distributions of the standard library
+	class Random {
+	  public:
+		Random(uint32_t seed) : m_engine {seed} {}
+		float Uniform(float min, float max) { return min + (max - min) * (static_cast<float>(m_engine() >> 8) / 16777216.f); }
+		// Uniform integer in [0,count)
+		uint32_t Index(uint32_t count) { return static_cast<uint32_t>((static_cast<uint64_t>(m_engine()) * count) >> 32); }
+		bool Chance(float p) { return Uniform(0.f, 1.f) < p; }
+	  private:
+		std::mt19937 m_engine;
+	};
+
+	uint32_t mix_seed(uint32_t a, uint32_t b)
+	{
+		auto h = a ^ (b + 0x9e3779b9u + (a << 6) + (a >> 2));
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	class Recorder {
+	  public:
+		Recorder(Report &report, const Settings &settings, udm::Type type, uint32_t seed) : m_report {report}, m_settings {settings}, m_type {type}, m_seed {seed} {}
+		const Settings &GetSettings() const { return m_settings; }
+		// The details are only generated for failed checks
+		template<typename TDetails>
+		void Check(bool success, const char *check, float time, const TDetails &getDetails)
+		{
+			++m_report.numChecks;
+			if(success)
+				return;
+			++m_report.numMismatches;
+			if(m_report.mismatches.size() < m_settings.maxMismatches)
+				m_report.mismatches.push_back({check, m_type, m_seed, time, getDetails()});
+		}
+	  private:
+		Report &m_report;
+		const Settings &m_settings;
+		udm::Type m_type;
+		uint32_t m_seed;
+	};
+
+	bool is_scalar_equal(double a, double b, double tolerance) { return umath::abs(a - b) <= tolerance * umath::max(1.0, umath::max(umath::abs(a), umath::abs(b))); }
+
+	template<typename T>
+	bool is_value_equal(const T &a, const T &b, double tolerance)
+	{
+		if constexpr(std::is_same_v<T, bool>)
+			return a == b;
+		else {
+			constexpr auto numComp = udm::get_numeric_component_count(udm::type_to_enum<T>());
+			for(auto c = decltype(numComp) {0u}; c < numComp; ++c) {
+				if(!is_scalar_equal(static_cast<double>(udm::get_numeric_component(a, c)), static_cast<double>(udm::get_numeric_component(b, c)), tolerance))
+					return false;
+			}
+			return true;
+		}
+	}
+
+	template<typename T>
+	std::string to_string(const T &value)
+	{
+		if constexpr(std::is_same_v<T, bool>)
+			return value ? "true" : "false";
+		else {
+			constexpr auto numComp = udm::get_numeric_component_count(udm::type_to_enum<T>());
+			std::string str = "(";
+			for(auto c = decltype(numComp) {0u}; c < numComp; ++c) {
+				if(c > 0)
+					str += ",";
+				str += std::to_string(static_cast<double>(udm::get_numeric_component(value, c)));
+			}
+			return str + ")";
+		}
+	}
+	std::string to_string(const std::pair<uint32_t, uint32_t> &indices, float factor) { return "(" + std::to_string(indices.first) + "," + std::to_string(indices.second) + ") factor " + std::to_string(factor); }
+
+	template<typename T>
+	T generate_value(Random &rng)
+	{
+		auto value = panima::make_value<T>();
+		constexpr auto numComp = udm::get_numeric_component_count(udm::type_to_enum<T>());
+		auto min = std::is_unsigned_v<T> ? 0.f : -100.f;
+		for(auto c = decltype(numComp) {0u}; c < numComp; ++c)
+			udm::set_numeric_component(value, c, rng.Uniform(min, 100.f));
+		if constexpr(std::is_same_v<T, Quat>)
+			uquat::normalize(value);
+		return value;
+	}
+
+	// Reference implementations
+
+	// Same as Channel::TimeToLocalTimeFrame
+	float to_local_time(const panima::Channel &channel, float t)
+	{
+		auto &timeFrame = channel.GetTimeFrame();
+		t -= timeFrame.startOffset;
+		if(timeFrame.duration >= 0.f)
+			t = umath::min(t, timeFrame.duration);
+		return t * timeFrame.scale;
+	}
+	float to_global_time(const panima::Channel &channel, float tLocal)
+	{
+		auto &timeFrame = channel.GetTimeFrame();
+		if(timeFrame.scale == 0.f)
+			return timeFrame.startOffset;
+		return tLocal / timeFrame.scale + timeFrame.startOffset;
+	}
+
+	// Linear search over all keys
+	std::pair<uint32_t, uint32_t> find_interpolation_indices(const panima::Channel &channel, float t, float &outFactor)
+	{
+		auto &times = channel.GetTimesArray();
+		auto n = static_cast<uint32_t>(times.GetSize());
+		outFactor = 0.f;
+		if(n == 0)
+			return {std::numeric_limits<uint32_t>::max(), std::numeric_limits<uint32_t>::max()};
+		auto tLocal = to_local_time(channel, t);
+		uint32_t numKeysBefore = 0;
+		while(numKeysBefore < n && times.GetValue<float>(numKeysBefore) <= tLocal)
+			++numKeysBefore;
+		if(numKeysBefore == n)
+			return {n - 1, n - 1};
+		if(numKeysBefore == 0)
+			return {0u, 0u};
+		auto t0 = times.GetValue<float>(numKeysBefore - 1);
+		auto t1 = times.GetValue<float>(numKeysBefore);
+		outFactor = (tLocal - t0) / (t1 - t0);
+		return {numKeysBefore - 1, numKeysBefore};
+	}
+
+	// Linearly interpolated value of a component, held constant outside of the time range of the channel
+	template<typename T>
+	float get_component_value(const panima::Channel &channel, float tLocal, uint32_t component)
+	{
+		auto &times = channel.GetTimesArray();
+		auto n = static_cast<uint32_t>(times.GetSize());
+		auto getKeyValue = [&channel, component](uint32_t idx) { return static_cast<float>(udm::get_numeric_component(channel.GetValue<T>(idx), component)); };
+		if(tLocal <= times.GetValue<float>(0))
+			return getKeyValue(0);
+		if(tLocal >= times.GetValue<float>(n - 1))
+			return getKeyValue(n - 1);
+		uint32_t idx1 = 1;
+		while(times.GetValue<float>(idx1) <= tLocal)
+			++idx1;
+		auto idx0 = idx1 - 1;
+		auto t0 = times.GetValue<float>(idx0);
+		auto t1 = times.GetValue<float>(idx1);
+		return umath::lerp(getKeyValue(idx0), getKeyValue(idx1), (tLocal - t0) / (t1 - t0));
+	}
+
+	// Checks
+
+	std::vector<float> get_sample_times(const panima::Channel &channel, Random &rng, uint32_t numRandomSamples)
+	{
+		std::vector<float> sampleTimes;
+		auto n = channel.GetTimeCount();
+		if(n == 0) {
+			for(uint32_t i = 0; i < numRandomSamples; ++i)
+				sampleTimes.push_back(rng.Uniform(-1.f, 1.f));
+			return sampleTimes;
+		}
+		auto &timeFrame = channel.GetTimeFrame();
+		auto epsilon = (timeFrame.scale != 0.f) ? panima::Channel::TIME_EPSILON / umath::abs(timeFrame.scale) : panima::Channel::TIME_EPSILON;
+		sampleTimes.reserve(n * 4 + numRandomSamples);
+		for(uint32_t i = 0; i < n; ++i) {
+			auto t = to_global_time(channel, *channel.GetTime(i));
+			sampleTimes.push_back(t);
+			sampleTimes.push_back(t - epsilon);
+			sampleTimes.push_back(t + epsilon);
+			if(i + 1 < n)
+				sampleTimes.push_back((t + to_global_time(channel, *channel.GetTime(i + 1))) * 0.5f);
+		}
+		auto tMin = to_global_time(channel, *channel.GetTime(0));
+		auto tMax = to_global_time(channel, *channel.GetTime(n - 1));
+		for(uint32_t i = 0; i < numRandomSamples; ++i)
+			sampleTimes.push_back(rng.Uniform(umath::min(tMin, tMax) - 0.5f, umath::max(tMin, tMax) + 0.5f));
+		return sampleTimes;
+	}
+
+	void verify_interpolation_indices(const panima::Channel &channel, const std::vector<float> &sampleTimes, const std::vector<float> &sortedSampleTimes, Random &rng, Recorder &recorder)
+	{
+		auto n = channel.GetTimeCount();
+		auto tolerance = recorder.GetSettings().tolerance;
+		auto verify = [&channel, &recorder, tolerance](const char *check, float t, const std::pair<uint32_t, uint32_t> &indices, float factor) {
+			float refFactor;
+			auto refIndices = find_interpolation_indices(channel, t, refFactor);
+			recorder.Check(indices == refIndices && is_scalar_equal(factor, refFactor, tolerance), check, t, [&]() { return to_string(indices, factor) + ", expected " + to_string(refIndices, refFactor); });
+		};
+		for(auto t : sampleTimes) {
+			float factor;
+			auto indices = channel.FindInterpolationIndices(t, factor);
+			verify("FindInterpolationIndices/binary", t, indices, factor);
+
+			// Pivots of n and above are out of range and have to be ignored
+			auto pivot = rng.Index(n + 2);
+			indices = channel.FindInterpolationIndices(t, factor, pivot);
+			verify("FindInterpolationIndices/pivot_random", t, indices, factor);
+		}
+		// The pivot of the previous sample is used, as during playback
+		uint32_t pivot = 0;
+		for(auto t : sortedSampleTimes) {
+			float factor;
+			auto indices = channel.FindInterpolationIndices(t, factor, pivot);
+			verify("FindInterpolationIndices/pivot_sequential", t, indices, factor);
+			pivot = indices.first;
+		}
+	}
+
+	template<typename T>
+	void verify_interpolated_values(const panima::Channel &channel, const std::vector<float> &sortedSampleTimes, Recorder &recorder)
+	{
+		if(channel.GetTimeCount() == 0)
+			return;
+		auto tolerance = recorder.GetSettings().tolerance;
+		auto interpolate = channel.GetInterpolationFunction<T>();
+		uint32_t pivot = 0;
+		for(auto t : sortedSampleTimes) {
+			float factor;
+			auto indices = find_interpolation_indices(channel, t, factor);
+			auto refValue = interpolate(channel.GetValue<T>(indices.first), channel.GetValue<T>(indices.second), factor);
+
+			auto value = channel.GetInterpolatedValue<T>(t, pivot);
+			recorder.Check(is_value_equal(value, refValue, tolerance), "GetInterpolatedValue/pivot", t, [&]() { return to_string(value) + ", expected " + to_string(refValue); });
+
+			value = channel.GetInterpolatedValue<T>(t);
+			recorder.Check(is_value_equal(value, refValue, tolerance), "GetInterpolatedValue/binary", t, [&]() { return to_string(value) + ", expected " + to_string(refValue); });
+		}
+	}
+
+	template<typename T>
+	void verify_constant_spans(const panima::Channel &channel, Random &rng, uint32_t numSamples, Recorder &recorder)
+	{
+		auto n = channel.GetValueCount();
+		if(n == 0 || !channel.HasConstantSpanInfo())
+			return;
+		auto isConstantBetween = [&channel](uint32_t idx0, uint32_t idx1) {
+			for(auto i = idx0 + 1; i <= idx1; ++i) {
+				if(std::memcmp(&channel.GetValue<T>(idx0), &channel.GetValue<T>(i), sizeof(T)) != 0)
+					return false;
+			}
+			return true;
+		};
+		for(uint32_t i = 0; i < numSamples; ++i) {
+			auto idx0 = rng.Index(n);
+			// Mostly short spans, since long spans are rarely constant
+			auto idx1 = umath::min(idx0 + (rng.Chance(0.75f) ? rng.Index(4) : rng.Index(n)), n - 1);
+			auto expected = isConstantBetween(idx0, idx1);
+			recorder.Check(channel.IsConstantBetween(idx0, idx1) == expected, "IsConstantBetween", *channel.GetTime(idx0),
+			  [&]() { return "keys " + std::to_string(idx0) + " to " + std::to_string(idx1) + ", expected " + (expected ? "constant" : "not constant"); });
+		}
+		if(!channel.GetValueExpression()) {
+			auto expected = isConstantBetween(0, n - 1);
+			recorder.Check(channel.IsConstant() == expected, "IsConstant", 0.f, [&]() { return std::string {"expected "} + (expected ? "constant" : "not constant"); });
+		}
+	}
+
+	template<typename T>
+	void verify_aggregates(const panima::Channel &channel, Random &rng, uint32_t numSamples, Recorder &recorder)
+	{
+		auto n = channel.GetTimeCount();
+		if(n == 0)
+			return;
+		auto tolerance = recorder.GetSettings().aggregateTolerance;
+		auto &times = channel.GetTimesArray();
+		auto &timeFrame = channel.GetTimeFrame();
+		auto tMin = to_global_time(channel, times.GetValue<float>(0));
+		auto tMax = to_global_time(channel, times.GetValue<float>(n - 1));
+		if(tMax < tMin)
+			std::swap(tMin, tMax);
+		constexpr auto numComp = udm::get_numeric_component_count(udm::type_to_enum<T>());
+		for(uint32_t i = 0; i < numSamples; ++i) {
+			auto component = rng.Index(numComp);
+			auto tStart = rng.Uniform(tMin - 0.5f, tMax + 0.5f);
+			auto tEnd = rng.Chance(0.1f) ? tStart : rng.Uniform(tStart, tMax + 0.5f);
+
+			auto tLocalStart = to_local_time(channel, tStart);
+			auto tLocalEnd = to_local_time(channel, tEnd);
+			auto tLo = umath::min(tLocalStart, tLocalEnd);
+			auto tHi = umath::max(tLocalStart, tLocalEnd);
+			// The extrema of a piecewise linear function are at the window boundaries or at the keys within the window,
+			// and the trapezoidal rule over the same points is exact.
+			auto vPrev = get_component_value<T>(channel, tLo, component);
+			auto tPrev = tLo;
+			auto refMin = vPrev;
+			auto refMax = vPrev;
+			double refIntegral = 0.0;
+			double magnitude = 1.0;
+			auto addPoint = [&](float t, float v) {
+				refMin = umath::min(refMin, v);
+				refMax = umath::max(refMax, v);
+				refIntegral += (t - tPrev) * (static_cast<double>(v) + vPrev) * 0.5;
+				tPrev = t;
+				vPrev = v;
+			};
+			for(uint32_t k = 0; k < n; ++k) {
+				auto v = static_cast<float>(udm::get_numeric_component(channel.GetValue<T>(k), component));
+				// The aggregates accumulate over the entire channel, so the rounding error depends on the magnitude of all values
+				magnitude = umath::max(magnitude, umath::abs(static_cast<double>(v)) * umath::max(1.0, static_cast<double>(times.GetValue<float>(n - 1) - times.GetValue<float>(0))));
+				auto t = times.GetValue<float>(k);
+				if(t > tLo && t < tHi)
+					addPoint(t, v);
+			}
+			addPoint(tHi, get_component_value<T>(channel, tHi, component));
+			if(tLocalEnd < tLocalStart)
+				refIntegral = -refIntegral;
+			if(timeFrame.scale != 0.f)
+				refIntegral /= timeFrame.scale;
+
+			auto min = channel.GetMinimum(tStart, tEnd, component);
+			recorder.Check(min.has_value() && is_scalar_equal(*min, refMin, tolerance), "GetMinimum", tStart, [&]() { return (min ? std::to_string(*min) : std::string {"none"}) + ", expected " + std::to_string(refMin); });
+			auto max = channel.GetMaximum(tStart, tEnd, component);
+			recorder.Check(max.has_value() && is_scalar_equal(*max, refMax, tolerance), "GetMaximum", tStart, [&]() { return (max ? std::to_string(*max) : std::string {"none"}) + ", expected " + std::to_string(refMax); });
+			auto integral = channel.GetIntegral(tStart, tEnd, component);
+			recorder.Check(integral.has_value() && umath::abs(*integral - refIntegral) <= tolerance * magnitude, "GetIntegral", tStart,
+			  [&]() { return (integral ? std::to_string(*integral) : std::string {"none"}) + ", expected " + std::to_string(refIntegral); });
+		}
+	}
+
+	struct EditChecks {
+		const char *order;
+		const char *preservedKeys;
+		const char *clearedRange;
+	};
+	constexpr EditChecks CLEAR_RANGE_CHECKS {"ClearRange/order", "ClearRange/preserved_keys", "ClearRange/cleared_range"};
+	constexpr EditChecks SCALE_TIME_CHECKS {"ScaleTimeInRange/order", "ScaleTimeInRange/preserved_keys", nullptr};
+
+	// Generates a channel with random keys of the specified type. Channels with 0, 1 or 2 keys are generated regularly, to cover the edge cases.
+	std::shared_ptr<panima::Channel> generate_channel(udm::Type type, uint32_t seed, const ChannelGeneratorSettings &settings)
+	{
+		Random rng {seed};
+		auto channel = std::make_shared<panima::Channel>();
+		channel->SetValueType(type);
+		uint32_t numKeys;
+		switch(rng.Index(8)) {
+		case 0:
+			numKeys = 0;
+			break;
+		case 1:
+			numKeys = 1;
+			break;
+		case 2:
+			numKeys = 2;
+			break;
+		default:
+			numKeys = 3 + rng.Index(umath::max(settings.maxKeys, 3u) - 2);
+			break;
+		}
+		std::vector<float> times(numKeys);
+		auto t = rng.Uniform(-1.f, 1.f);
+		for(auto &time : times) {
+			time = t;
+			if(settings.nearDuplicateTimes && rng.Chance(0.1f))
+				t += rng.Uniform(panima::Channel::TIME_EPSILON * 1.5f, panima::Channel::VALUE_EPSILON);
+			else
+				t += rng.Uniform(0.01f, 0.2f);
+		}
+		udm::visit_ng(type, [&](auto tag) {
+			using T = typename decltype(tag)::type;
+			using TValue = std::conditional_t<std::is_same_v<T, bool>, uint8_t, T>;
+			if constexpr(panima::is_animatable_type(udm::type_to_enum<T>())) {
+				std::vector<TValue> values(numKeys, panima::make_value<TValue>());
+				for(uint32_t i = 0; i < numKeys; ++i) {
+					if(i > 0 && settings.constantRuns && rng.Chance(0.3f))
+						values[i] = values[i - 1];
+					else if constexpr(std::is_same_v<T, bool>)
+						values[i] = static_cast<uint8_t>(rng.Index(2));
+					else
+						values[i] = generate_value<TValue>(rng);
+				}
+				if(numKeys > 0)
+					channel->InsertValues<TValue>(numKeys, times.data(), values.data(), 0.f, panima::Channel::InsertFlags::None);
+			}
+		});
+		if(settings.randomTimeFrame && rng.Chance(0.5f)) {
+			panima::TimeFrame timeFrame {};
+			timeFrame.startOffset = rng.Uniform(-1.f, 1.f);
+			timeFrame.scale = rng.Uniform(0.5f, 2.f);
+			if(rng.Chance(0.5f))
+				timeFrame.duration = rng.Uniform(0.f, umath::max(t, 0.f) + 1.f);
+			channel->SetTimeFrame(timeFrame);
+		}
+		return channel;
+	}
+
+	// Compares FindInterpolationIndices (with and without pivot), GetInterpolatedValue, IsConstantBetween (if the channel
+	// has constant span info) and the windowed aggregates against the reference implementations.
+	void verify_sampling(const panima::Channel &channel, uint32_t channelSeed, const Settings &settings, Report &report)
+	{
+		Recorder recorder {report, settings, channel.GetValueType(), channelSeed};
+		Random rng {mix_seed(settings.seed, channelSeed)};
+		auto sampleTimes = get_sample_times(channel, rng, settings.numSamples);
+		auto sortedSampleTimes = sampleTimes;
+		std::sort(sortedSampleTimes.begin(), sortedSampleTimes.end());
+		verify_interpolation_indices(channel, sampleTimes, sortedSampleTimes, rng, recorder);
+		udm::visit_ng(channel.GetValueType(), [&](auto tag) {
+			using T = typename decltype(tag)::type;
+			using TValue = std::conditional_t<std::is_same_v<T, bool>, uint8_t, T>;
+			if constexpr(panima::is_animatable_type(udm::type_to_enum<T>())) {
+				verify_interpolated_values<T>(channel, sortedSampleTimes, recorder);
+				verify_constant_spans<TValue>(channel, rng, settings.numSamples, recorder);
+				verify_aggregates<TValue>(channel, rng, settings.numSamples, recorder);
+			}
+		});
+	}
+
+	// Applies random ClearRange and ScaleTimeInRange edits to copies of the channel (with the default time frame) and checks that
+	// the keys remain ordered, that keys outside of the edited range are left untouched and that no keys remain within a cleared range.
+	void verify_editing(const panima::Channel &channel, uint32_t channelSeed, const Settings &settings, Report &report)
+	{
+		auto n = channel.GetTimeCount();
+		if(n < 2)
+			return;
+		Recorder recorder {report, settings, channel.GetValueType(), channelSeed};
+		// Separate stream from verify_sampling, so that the edits don't depend on the number of sampling checks
+		Random rng {mix_seed(mix_seed(settings.seed, channelSeed), 1)};
+		auto &values = const_cast<udm::Array &>(channel.GetValueArray());
+		auto valueSize = values.GetValueSize();
+		auto tFirst = *channel.GetTime(0);
+		auto tLast = *channel.GetTime(n - 1);
+		// Keys closer than this to an edited range may be merged with keys that are added at its boundaries (see panima::Channel::AddValue)
+		constexpr auto margin = panima::Channel::VALUE_EPSILON * 2.f;
+		for(uint32_t i = 0; i < settings.numEdits; ++i) {
+			auto copy = std::make_shared<panima::Channel>(const_cast<panima::Channel &>(channel));
+			copy->SetTimeFrame({});
+			auto tStart = rng.Uniform(tFirst - 0.25f, tLast + 0.25f);
+			auto tEnd = rng.Uniform(tStart, tLast + 0.25f);
+			// Keys within this range may be modified by the edit
+			float tAffectedStart;
+			float tAffectedEnd;
+			const EditChecks *checks;
+			if(rng.Chance(0.5f)) {
+				checks = &CLEAR_RANGE_CHECKS;
+				auto addCaps = rng.Chance(0.5f);
+				if(!copy->ClearRange(tStart, tEnd, addCaps))
+					continue;
+				tAffectedStart = umath::clamp(tStart, tFirst, tLast);
+				tAffectedEnd = umath::clamp(tEnd, tFirst, tLast);
+				for(uint32_t j = 0; j < copy->GetTimeCount(); ++j) {
+					auto t = *copy->GetTime(j);
+					recorder.Check(t <= tAffectedStart + margin || t >= tAffectedEnd - margin, checks->clearedRange, t,
+					  [&]() { return "key " + std::to_string(j) + " remains within cleared range [" + std::to_string(tAffectedStart) + "," + std::to_string(tAffectedEnd) + "]"; });
+				}
+			}
+			else {
+				checks = &SCALE_TIME_CHECKS;
+				auto tPivot = rng.Uniform(tStart, tEnd);
+				auto scale = rng.Uniform(0.25f, 4.f);
+				copy->ScaleTimeInRange(tStart, tEnd, tPivot, scale, rng.Chance(0.5f));
+				// The range is extended to the surrounding keys
+				auto itStart = std::upper_bound(begin(channel.GetTimesArray()), end(channel.GetTimesArray()), tStart);
+				auto tRangeStart = (itStart != begin(channel.GetTimesArray())) ? *(itStart - 1) : tFirst;
+				auto itEnd = std::lower_bound(begin(channel.GetTimesArray()), end(channel.GetTimesArray()), tEnd);
+				auto tRangeEnd = (itEnd != end(channel.GetTimesArray())) ? *itEnd : tLast;
+				auto rescale = [tPivot, scale](float t) { return (t - tPivot) * scale + tPivot; };
+				tAffectedStart = umath::min(tRangeStart, rescale(tRangeStart));
+				tAffectedEnd = umath::max(tRangeEnd, rescale(tRangeEnd));
+			}
+
+			auto m = copy->GetTimeCount();
+			for(uint32_t j = 1; j < m; ++j) {
+				auto t0 = *copy->GetTime(j - 1);
+				auto t1 = *copy->GetTime(j);
+				recorder.Check(t0 < t1, checks->order, t1, [&]() { return "key " + std::to_string(j) + " at " + std::to_string(t1) + " follows key at " + std::to_string(t0); });
+			}
+
+			auto &copyValues = copy->GetValueArray();
+			uint32_t j = 0;
+			for(uint32_t k = 0; k < n; ++k) {
+				auto t = *channel.GetTime(k);
+				if(t >= tAffectedStart - margin && t <= tAffectedEnd + margin)
+					continue;
+				while(j < m && *copy->GetTime(j) < t)
+					++j;
+				auto preserved = j < m && *copy->GetTime(j) == t && std::memcmp(values.GetValuePtr(k), copyValues.GetValuePtr(j), valueSize) == 0;
+				recorder.Check(preserved, checks->preservedKeys, t, [&]() { return "key " + std::to_string(k) + " outside of the edited range was modified or removed"; });
+			}
+		}
+	}
+
+	// Generates channelsPerType channels of every animatable type and runs all checks on them
+	Report verify_all(const Settings &settings, uint32_t channelsPerType, const ChannelGeneratorSettings &generatorSettings)
+	{
+		Report report {};
+		for(uint32_t i = 0; i < umath::to_integral(udm::Type::Count); ++i) {
+			auto type = static_cast<udm::Type>(i);
+			if(!panima::is_animatable_type(type))
+				continue;
+			for(uint32_t j = 0; j < channelsPerType; ++j) {
+				auto seed = mix_seed(settings.seed, i * channelsPerType + j);
+				auto channel = generate_channel(type, seed, generatorSettings);
+				channel->UpdateConstantSpans();
+				++report.numChannels;
+				verify_sampling(*channel, seed, settings, report);
+				verify_editing(*channel, seed, settings, report);
+			}
+		}
+		return report;
+	}
+
+	void parse_args(int argc, char *argv[], Settings &settings, ChannelGeneratorSettings &generatorSettings, uint32_t &channelsPerType)
+	{
+		for(int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			auto hasValue = (i + 1 < argc);
+			if(arg == "--seed" && hasValue)
+				settings.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+			else if(arg == "--channels-per-type" && hasValue)
+				channelsPerType = static_cast<uint32_t>(std::stoul(argv[++i]));
+			else if(arg == "--max-keys" && hasValue)
+				generatorSettings.maxKeys = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	Settings settings {};
+	ChannelGeneratorSettings generatorSettings {};
+	uint32_t channelsPerType = 16;
+	parse_args(argc, argv, settings, generatorSettings, channelsPerType);
+	auto report = verify_all(settings, channelsPerType, generatorSettings);
+	for(auto &mismatch : report.mismatches)
+		std::printf("%s: type %s, channel seed %u, t=%f: %s\n", mismatch.check.c_str(), std::string {magic_enum::enum_name(mismatch.type)}.c_str(), mismatch.seed, mismatch.time, mismatch.details.c_str());
+	std::printf("seed %u: %u channels, %llu checks, %llu mismatches\n", settings.seed, report.numChannels, static_cast<unsigned long long>(report.numChecks), static_cast<unsigned long long>(report.numMismatches));
+	return report.IsSuccessful() ? 0 : 1;
+}